@@ -27,9 +27,9 @@
  */
 
 #include <stddef.h>
-#include <cstdio>
 
 #include "abstract/pagetable.hpp"
+#include "util/writer.hpp"
 #include "abstract/vcpu.hpp"
 #include "coreinfo.hpp"
 
@@ -77,36 +77,36 @@ namespace Abstract
          * - Memory info.
          * - Register state.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state(FILE * stream) const = 0;
+        virtual int print_state(Writer & stream) const = 0;
 
         /**
          * Dump Xen structures for this domain.  Includes Xen's struct domain
          * and each struct vcpu.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int dump_structures(FILE * stream) const = 0;
+        virtual int dump_structures(Writer & stream) const = 0;
 
         /**
          * Print the console ring.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param info CoreInfo object containing dom0 vmcoreinfo data.
          * @return Number of bytes written to stream.
          */
-        virtual int print_console(FILE * stream, CoreInfo& info) const = 0;
+        virtual int print_console(Writer & stream, CoreInfo& info) const = 0;
 
         /**
          * Print the command line.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_cmdline(FILE * stream) const = 0;
+        virtual int print_cmdline(Writer & stream) const = 0;
 
         /**
          * Read vmcoreinfo data by resolving the vmcoreinfo_note
@@ -119,11 +119,11 @@ namespace Abstract
         /**
          * Print vmcoreinfo data
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param info CoreInfo object containing dom0 vmcoreinfo data.
          * @return Number of bytes written to stream
          */
-        virtual int print_vmcoreinfo(FILE * stream, CoreInfo & info) const = 0;
+        virtual int print_vmcoreinfo(Writer & stream, CoreInfo & info) const = 0;
 
         /**
          * Get a usable set of Domain pagetables.
@@ -104,7 +104,8 @@ namespace Abstract
         /// Program Headers.
         ElfProgHdr * phdrs;
 
-        /// Contents of the note program header.
+        /// Contents of the note program header.  Points into notemap if the
+        /// notes could be mapped, or to a heap copy otherwise.
         char * notedata;
         /// Number of notes.
         int nr_notes;
@@ -127,6 +128,11 @@ namespace Abstract
         /// File descriptor
         int fd;
 
+        /// Page aligned mapping of the note program header, or NULL.
+        char * notemap;
+        /// Length of notemap.
+        size_t notemap_size;
+
     private:
         // @cond EXCLUDE
         Elf(const Elf &);
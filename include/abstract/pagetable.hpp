@@ -28,6 +28,7 @@
 
 #include <cstring>
 #include "types.hpp"
+#include "util/worker-pool.hpp"
 
 namespace Abstract
 {
@@ -45,19 +46,90 @@ namespace Abstract
     {
     public:
         /// Constructor.
-        PageTable() {};
+        PageTable();
         /// Destructor.
-        virtual ~PageTable() {};
+        virtual ~PageTable();
 
         /**
          * Perform a pagetable walk.
+         * Successful translations are cached, so repeated walks for the
+         * same page are cheap.
          * @param vaddr Virtual address to look up.
          * @param maddr Machine address variable for the result.
          * @param page_end If non-null, variable to be filled with the
          * last virtual address of the page.
          */
-        virtual void walk(const vaddr_t & vaddr, maddr_t & maddr,
-                          vaddr_t * page_end = NULL) const = 0;
+        void walk(const vaddr_t & vaddr, maddr_t & maddr,
+                  vaddr_t * page_end = NULL) const;
+
+        /**
+         * Set the number of translations cached for 4K pages by each
+         * PageTable.  A quarter as many are cached for superpages.  Rounded
+         * up to a power of two, and 0 disables caching.  Only affects
+         * PageTables which have not yet performed a walk.
+         * @param entries Number of entries.
+         */
+        static void set_tlb_size(const size_t entries);
+
+        /// Log translation cache statistics.
+        static void log_stats();
+
+        /// Default number of translations cached for 4K pages.
+        static const size_t DEFAULT_TLB_SIZE = 64;
+
+    protected:
+        /**
+         * Check that a virtual address is valid for this type of pagetable.
+         * @param vaddr Virtual address to check.
+         * @throws validate
+         */
+        virtual void validate_vaddr(const vaddr_t & vaddr) const = 0;
+
+        /**
+         * Perform an uncached pagetable walk.
+         * The machine address of vaddr is page_base | (vaddr & (page_size - 1)).
+         * @param vaddr Virtual address to look up, already checked by
+         * validate_vaddr().
+         * @param page_base Variable to be filled with the machine address
+         * of the page (or superpage) containing vaddr.
+         * @param page_size Variable to be filled with the size of the page
+         * (or superpage) containing vaddr.
+         */
+        virtual void walk_uncached(const vaddr_t & vaddr, maddr_t & page_base,
+                                   uint64_t & page_size) const = 0;
+
+        /// Cached translation.
+        struct TLBEntry
+        {
+            /// Virtual address of the start of the page.
+            vaddr_t vbase;
+            /// Machine address of the page.
+            maddr_t mbase;
+            /// Page size - 1, or 0 for an unused entry.
+            uint64_t mask;
+        };
+
+        /// Cached translations.  4K pages first, then superpages.
+        mutable TLBEntry * tlb;
+        /// Number of entries for 4K pages.
+        mutable size_t tlb_small;
+        /// Number of entries for superpages.
+        mutable size_t tlb_large;
+        /// Protects the cached translations.
+        mutable Mutex tlb_lock;
+
+        /// Configured number of entries for 4K pages.
+        static size_t tlb_size;
+        /// Number of walks satisfied from the cache, across all PageTables.
+        static uint64_t tlb_hits;
+        /// Number of walks which missed the cache, across all PageTables.
+        static uint64_t tlb_misses;
+
+    private:
+        // @cond EXCLUDE
+        PageTable(const PageTable &);
+        PageTable & operator= (const PageTable &);
+        // @endcond
     };
 }
 
@@ -27,10 +27,10 @@
  */
 
 #include <stddef.h>
-#include <cstdio>
 
 #include "util/macros.hpp"
 #include "abstract/pagetable.hpp"
+#include "util/writer.hpp"
 #include "abstract/vcpu.hpp"
 
 namespace Abstract
@@ -96,20 +96,20 @@ namespace Abstract
          * - Code dump
          * - Stack trace
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state(FILE * stream) const = 0;
+        virtual int print_state(Writer & stream) const = 0;
 
         /**
          * Dump entire stack contents.
          *
          * Designed for power users to interpret
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int dump_stack(FILE * stream) const = 0;
+        virtual int dump_stack(Writer & stream) const = 0;
 
         /// Parsing flags.  Will be made up of PCPU::PCPUFlags
         uint32_t flags;
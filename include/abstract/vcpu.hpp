@@ -29,6 +29,7 @@
 #include "types.hpp"
 #include "util/macros.hpp"
 #include "abstract/pagetable.hpp"
+#include "util/writer.hpp"
 
 namespace Abstract
 {
@@ -120,19 +121,19 @@ namespace Abstract
          * - Code dump
          * - Stack trace
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state(FILE * stream) const = 0;
+        virtual int print_state(Writer & stream) const = 0;
 
         /**
          * Dump Xen structures for this vcpu.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param xenpt PageTable with which translations can be performed.
          * @return Number of bytes written to stream.
          */
-        virtual int dump_structures(FILE * stream, const Abstract::PageTable & xenpt) const = 0;
+        virtual int dump_structures(Writer & stream, const Abstract::PageTable & xenpt) const = 0;
 
         /// Xen pointer to this struct vcpu.
         vaddr_t vcpu_ptr;
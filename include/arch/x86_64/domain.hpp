@@ -66,36 +66,36 @@ namespace x86_64
          * - Memory info.
          * - Register state.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state(FILE * stream) const;
+        virtual int print_state(Writer & stream) const;
 
         /**
          * Dump Xen structures for this domain.  Includes Xen's struct domain
          * and each struct vcpu.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int dump_structures(FILE * stream) const;
+        virtual int dump_structures(Writer & stream) const;
 
         /**
          * Print the console ring.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param info CoreInfo object containing dom0 vmcoreinfo data.
          * @return Number of bytes written to stream.
          */
-        virtual int print_console(FILE * stream, CoreInfo& info) const;
+        virtual int print_console(Writer & stream, CoreInfo& info) const;
 
         /**
          * Print the command line.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_cmdline(FILE * stream) const;
+        virtual int print_cmdline(Writer & stream) const;
 
         /**
          * Read vmcoreinfo data by resolving the vmcoreinfo_note
@@ -108,11 +108,11 @@ namespace x86_64
         /**
          * Print vmcoreinfo data
          *
-         * @param stream Stream to write to
+         * @param stream Writer to write to
          * @param info CoreInfo object containing dom0 vmcoreinfo data.
          * @return Number of bytes written to stream
          */
-        virtual int print_vmcoreinfo(FILE * stream, CoreInfo & info) const;
+        virtual int print_vmcoreinfo(Writer & stream, CoreInfo & info) const;
 
         /**
          * Get a usable set of Domain pagetables.
@@ -126,11 +126,11 @@ namespace x86_64
         /**
          * Print the console ring for a 3.x kernel
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param info CoreInfo object containing dom0 vmcoreinfo data.
          * @return Number of bytes written to stream.
          */
-        int print_console_3x(FILE * stream, CoreInfo& info) const;
+        int print_console_3x(Writer & stream, CoreInfo& info) const;
 
     };
 
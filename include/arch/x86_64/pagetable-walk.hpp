@@ -29,21 +29,35 @@
 #include "types.hpp"
 #include "exceptions.hpp"
 
+#include <cstddef>
+
 /**
  * Pagetable walk for 64bit mode.
  * Long mode executing 64bit code has a 52bit physical address space and a 64bit
  * virtual address space.
+ * The machine address of vaddr is base | (vaddr & (size - 1)).
  * @param cr3 Value of the cr3 register.
  * @param vaddr Virtual address to look up.
- * @param maddr Machine address result of the pagetable walk.
- * @param page_end If non-null, variable to be filled with the last virtual address
- * within the page which contains vaddr.
+ * @param base Machine address of the page (or superpage) containing vaddr.
+ * @param size Size of the page (or superpage) containing vaddr.
  * @throws memseek
  * @throws memread
  * @throws pagefault
  */
 void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
-                       maddr_t & maddr, vaddr_t * page_end = NULL);
+                       maddr_t & base, uint64_t & size);
+
+/**
+ * Set the size of the cache of pagetable pages shared by all 64bit pagetable
+ * walks.  Pages from mapped regions of the core are used directly and not
+ * cached, so the cache is only allocated if an unmapped pagetable page is
+ * encountered.
+ * @param size Size of the cache in bytes.  0 disables the cache.
+ */
+void pagetable_walk_64_set_cache_size(const size_t size);
+
+/// Log usage statistics of the cache of pagetable pages.
+void pagetable_walk_64_log_stats();
 
 #endif
 
@@ -44,15 +44,22 @@ namespace x86_64
         /// Destructor.
         virtual ~PT64();
 
+    protected:
         /**
-         * Perform a pagetable walk.
+         * Check that a virtual address is valid for this type of pagetable.
+         * @param vaddr Virtual address to check.
+         * @throws validate
+         */
+        virtual void validate_vaddr(const vaddr_t & vaddr) const;
+
+        /**
+         * Perform an uncached pagetable walk.
          * @param vaddr Virtual address to look up.
-         * @param maddr Machine address variable for the result.
-         * @param page_end If non-null, variable to be filled with the
-         * last virtual address of the page.
+         * @param page_base Variable to be filled with the machine address of the page.
+         * @param page_size Variable to be filled with the size of the page.
          */
-        virtual void walk(const vaddr_t & vaddr, maddr_t & maddr,
-                          vaddr_t * page_end = NULL) const;
+        virtual void walk_uncached(const vaddr_t & vaddr, maddr_t & page_base,
+                                   uint64_t & page_size) const;
 
     private:
         /// Control Register 3
@@ -77,15 +84,22 @@ namespace x86_64
         /// Destructor.
         virtual ~PT64Compat();
 
+    protected:
+        /**
+         * Check that a virtual address is valid for this type of pagetable.
+         * @param vaddr Virtual address to check.
+         * @throws validate
+         */
+        virtual void validate_vaddr(const vaddr_t & vaddr) const;
+
         /**
-         * Perform a pagetable walk.
+         * Perform an uncached pagetable walk.
          * @param vaddr Virtual address to look up.
-         * @param maddr Machine address variable for the result.
-         * @param page_end If non-null, variable to be filled with the
-         * last virtual address of the page.
+         * @param page_base Variable to be filled with the machine address of the page.
+         * @param page_size Variable to be filled with the size of the page.
          */
-        virtual void walk(const vaddr_t & vaddr, maddr_t & maddr,
-                          vaddr_t * page_end = NULL) const;
+        virtual void walk_uncached(const vaddr_t & vaddr, maddr_t & page_base,
+                                   uint64_t & page_size) const;
 
     private:
         /// Control Register 3
@@ -87,20 +87,20 @@ namespace x86_64
          * - Code dump
          * - Stack trace
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state(FILE * stream) const;
+        virtual int print_state(Writer & stream) const;
 
         /**
          * Dump entire stack contents.
          *
          * Designed for power users to interpret
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int dump_stack(FILE * stream) const;
+        virtual int dump_stack(Writer & stream) const;
 
     protected:
         /// PCPU Registers
@@ -110,12 +110,12 @@ namespace x86_64
          * Print xen per-cpu stack.
          *
          * Include extending parsing of interrupt stack tables.
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param stack Xen's per-cpu stack pointer.
          * @param mask Bitmask of visited stack pages to avoid unbounded recursion.
          * @return Number of bytes written to stream.
          */
-        int print_stack(FILE * stream, const vaddr_t & stack, unsigned mask) const;
+        int print_stack(Writer & stream, const vaddr_t & stack, unsigned mask) const;
 
     };
 
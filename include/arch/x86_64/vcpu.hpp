@@ -100,19 +100,19 @@ namespace x86_64
          * - Code dump
          * - Stack trace
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state(FILE * stream) const;
+        virtual int print_state(Writer & stream) const;
 
         /**
          * Dump Xen structures for this vcpu.
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @param xenpt PageTable with which translations can be performed.
          * @return Number of bytes written to stream.
          */
-        virtual int dump_structures(FILE * stream, const Abstract::PageTable & xenpt) const;
+        virtual int dump_structures(Writer & stream, const Abstract::PageTable & xenpt) const;
 
         /**
          * Print the information about this vcpu to the provided stream, if this
@@ -125,34 +125,41 @@ namespace x86_64
          * - Code dump
          * - Stack trace
          *
-         * @param stream Stream to write to.
+         * @param stream Writer to write to.
          * @return Number of bytes written to stream.
          */
-        virtual int print_state_compat(FILE * stream) const;
+        virtual int print_state_compat(Writer & stream) const;
 
     protected:
 
         /**
-         * Parse General purpose registers.
-         *
-         * This grabs rax thru r15, as well as rflags, cs and ss.
+         * Read a guest register block.
          *
          * @param addr Xen virtual address of the guest regs.
          * @param xenpt PageTable with which translations can be performed.
+         * @param uregs Register block to fill.
          * @return boolean indicating success or failure.
          */
-        virtual bool parse_gp_regs(const vaddr_t & addr, const Abstract::PageTable & xenpt);
+        bool read_uregs(const vaddr_t & addr, const Abstract::PageTable & xenpt,
+                        x86_64_cpu_user_regs & uregs) const;
+
+        /**
+         * Parse General purpose registers.
+         *
+         * This grabs rax thru r15, as well as rflags, cs and ss.
+         *
+         * @param uregs Guest register block.
+         */
+        void parse_gp_regs(const x86_64_cpu_user_regs & uregs);
 
         /**
          * Parse segment registers.
          *
          * This grabs ds thru gs.
          *
-         * @param addr Xen virtual address of the guest regs.
-         * @param xenpt PageTable with which translations can be performed.
-         * @return boolean indicating success or failure.
+         * @param uregs Guest register block.
          */
-        virtual bool parse_seg_regs(const vaddr_t & addr, const Abstract::PageTable & xenpt);
+        void parse_seg_regs(const x86_64_cpu_user_regs & uregs);
 
         /// Register values
         x86_64regs regs;
@@ -27,12 +27,16 @@
  */
 
 #include <cstring>
+#include <vector>
 
 #include "types.hpp"
 
 /**
  * Wrapper class for storing vmcoreinfo strings,
  * supporting RAII semantics.
+ *
+ * Once the data is complete, build_index() parses the key=value lines
+ * into a hash table, so each lookup is a single probe for an exact key.
  */
 class CoreInfo {
     private:
@@ -56,6 +60,43 @@ class CoreInfo {
         /// ELF note data, with trailing '\0' to behave like a C-string
         char * data;
 
+        /// Entry in the key index.
+        struct KeyEntry
+        {
+            /// Hash of the key.
+            uint32_t hash;
+            /// Offset of the key in data.
+            uint32_t key;
+            /// Length of the key.
+            uint32_t key_len;
+            /// Offset of the value in data, or KEY_EMPTY for an unused entry.
+            uint32_t value;
+        };
+
+        /// Marker for an unused KeyEntry.
+        static const uint32_t KEY_EMPTY = ~0U;
+
+        /// Key index, a power of two in size, or empty if not built.
+        std::vector<KeyEntry> keys;
+
+        /**
+         * Hash a key.
+         * @param key the key.
+         * @param len length of the key.
+         * @returns 64bit FNV-1a hash of the key, truncated to 32 bits.
+         */
+        static uint32_t hash_key(const char * key, const size_t len);
+
+        /**
+         * Find the key index entry for a key.
+         * @param key the key.
+         * @param len length of the key.
+         * @param hash hash of the key.
+         * @returns Index of the entry holding the key, or of the empty
+         * entry where it would be inserted.
+         */
+        size_t key_slot(const char * key, const size_t len, const uint32_t hash) const;
+
         /**
          * Search for key and return pointer to beginning of value
          * @param key the key to search for
@@ -107,7 +148,16 @@ class CoreInfo {
         char * vmcoreinfoData() { return data; }
 
         /**
-         * Transfer ownership of vmcoreinfo into this object from another.
+         * Parse the key=value lines of the vmcoreinfo data into the key
+         * index, which lookups require.  Where a key appears more than
+         * once, the first value is used.
+         * @throws std::bad_alloc in the case of insufficient memory
+         */
+        void build_index();
+
+        /**
+         * Transfer ownership of vmcoreinfo, and its key index, into this
+         * object from another.
          * @param other The object to transfer ownership from
          */
         void transferOwnershipFrom(CoreInfo& other);
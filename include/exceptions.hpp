@@ -244,7 +244,7 @@ private:
 /**
  * File write exception
  *
- * Thrown from FPRINTF (& friends) wrapper functions to catch and deal with
+ * Thrown by Writer::flush() (& friends) to catch and deal with
  * write errors to the stream.
  */
 class filewrite: public std::exception
@@ -30,6 +30,7 @@
 
 #include "coreinfo.hpp"
 #include "symbol-table.hpp"
+#include "abstract/domain.hpp"
 #include "abstract/pcpu.hpp"
 #include "abstract/elf.hpp"
 #include "arch/x86_64/structures.hpp"
@@ -82,6 +83,17 @@ public:
      */
     int print_domains(bool dump_structures);
 
+    /**
+     * Decode and print a domain whose basic information has been parsed.
+     * Safe to call concurrently for different domains.
+     * @param dom Domain.
+     * @param xenpt Xen pagetables.
+     * @param dump_structures boolean indicating whether the Xen structures should be dumped.
+     * @return boolean indicating success or failure.
+     */
+    bool print_domain(Abstract::Domain & dom, const Abstract::PageTable & xenpt,
+                      bool dump_structures);
+
     /**
      * Validate a Xen virtual address.
      * @param vaddr Xen virtual address.
@@ -154,6 +166,18 @@ public:
     /// dom0 vmcoreinfo
     CoreInfo dom0_vmcoreinfo;
 
+protected:
+    /**
+     * Print the state of each PCPU to a writer, concurrently if there are
+     * several worker threads.
+     * @param o Writer.
+     * @param len Incremented by the number of characters printed.
+     * @throws filewrite
+     * @return boolean indicating success or failure.  Failures have
+     * already been logged.
+     */
+    bool print_pcpus(Writer & o, int & len);
+
 private:
     // @cond EXCLUDE
     Host(const Host &);
@@ -32,6 +32,8 @@
 #include "exceptions.hpp"
 #include "abstract/pagetable.hpp"
 #include "abstract/elf.hpp"
+#include "util/frame-cache.hpp"
+#include "util/worker-pool.hpp"
 
 #include <cstdio>
 
@@ -51,6 +53,8 @@ public:
     MemRegion(const ElfProgHdr & hdr);
     /// Copy Constructor.
     MemRegion(const MemRegion & rhs);
+    /// Assignment operator.
+    MemRegion & operator= (const MemRegion & rhs);
 
     /// Starting physical address.
     maddr_t start;
@@ -59,6 +63,13 @@ public:
     /// Offset of memory region into core file.
     uint64_t offset;
 
+    /// Start of the mapping covering this region, or NULL if not mapped.
+    void * map_base;
+    /// Length of the mapping covering this region.
+    size_t map_length;
+    /// Pointer to the byte representing start in the mapping, or NULL.
+    const char * data;
+
     /**
      * Operator < for sorting purposes.
      * @param rhs Right hand side of the expression.
@@ -67,6 +78,150 @@ public:
     bool operator < (const MemRegion & rhs) const;
 };
 
+/**
+ * A single read for Memory::read_many().
+ */
+class MemRequest
+{
+public:
+    /**
+     * Constructor.
+     * @param pt PageTable to perform a pagetable walk with.
+     * @param addr Virtual address.
+     * @param dst Destination buffer.
+     * @param len Number of bytes to read.
+     */
+    MemRequest(const PageTable & pt, const vaddr_t & addr, void * dst, size_t len);
+
+    /// PageTable to perform a pagetable walk with.
+    const PageTable * pt;
+    /// Virtual address.
+    vaddr_t addr;
+    /// Destination buffer.
+    void * dst;
+    /// Number of bytes to read.
+    size_t len;
+};
+
+/**
+ * Construct a MemRequest to read an integer or structure.
+ * @param pt PageTable to perform a pagetable walk with.
+ * @param addr Virtual address.
+ * @param dst Destination variable, whose size is the number of bytes read.
+ * @returns MemRequest.
+ */
+template <typename T>
+MemRequest mem_request(const PageTable & pt, const vaddr_t & addr, T & dst)
+{
+    return MemRequest(pt, addr, &dst, sizeof dst);
+}
+
+/**
+ * Read-only span of core memory, filled by Memory::view_vaddr().
+ *
+ * If the memory is mapped, data points straight into the mapping.
+ * Otherwise it is copied into the bounce buffer, so the view remains
+ * valid regardless of what else happens to the frame cache.
+ */
+class MemView
+{
+public:
+    /// Constructor.  The view is initially empty.
+    MemView();
+
+    /**
+     * Does the view cover n bytes at vaddr?
+     * @param vaddr Address, of the same kind as the view.
+     * @param n Number of bytes.
+     * @returns boolean.
+     */
+    bool covers(const vaddr_t & vaddr, const size_t n) const;
+
+    /// Address of the start of the span, virtual or machine as viewed.
+    uint64_t addr;
+    /// Span data.
+    const char * data;
+    /// Span length.
+    size_t length;
+    /// Storage for memory which is not mapped.
+    char bounce[FrameCache::FRAME_SIZE];
+
+private:
+    // @cond EXCLUDE
+    MemView(const MemView &);
+    MemView & operator= (const MemView &);
+    // @endcond
+};
+
+/**
+ * Copy of a whole Xen structure, read from the core in one go.
+ *
+ * Fields are then decoded from the copy using their xensym offsets.
+ * Structures up to INLINE_SIZE bytes are held inline, so a snapshot on
+ * the stack needs no heap allocation.
+ */
+class MemSnapshot
+{
+public:
+    /// Size of structure which can be held without allocating.
+    static const size_t INLINE_SIZE = 8192;
+
+    /// Constructor.  The snapshot is initially empty.
+    MemSnapshot();
+    /// Destructor.
+    ~MemSnapshot();
+
+    /**
+     * Read a structure.
+     * @param pt PageTable to perform a pagetable walk with.
+     * @param addr Virtual address of the structure.
+     * @param size Size of the structure.
+     */
+    void read(const PageTable & pt, const vaddr_t & addr, const size_t size);
+
+    /**
+     * Copy a field out of the snapshot.
+     * Throws validate if the field is not within the structure.
+     * @param offset Offset of the field into the structure.
+     * @param dst Destination buffer.
+     * @param n Size of the field.
+     */
+    void get_block(const vaddr_t & offset, void * dst, const size_t n) const;
+
+    /**
+     * Copy an integer or structure field out of the snapshot.
+     * Throws validate if the field is not within the structure.
+     * @param offset Offset of the field into the structure.
+     * @param dst Destination variable, whose size is the size of the field.
+     */
+    template <typename T>
+    void get(const vaddr_t & offset, T & dst) const
+    {
+        this->get_block(offset, &dst, sizeof dst);
+    }
+
+    /// Virtual address of the structure.
+    vaddr_t addr;
+    /// Size of the structure.
+    size_t size;
+
+protected:
+    /// Structure data, pointing at either storage or heap.
+    char * data;
+    /// Heap buffer for structures larger than INLINE_SIZE.
+    char * heap;
+    /// Size of heap.
+    size_t heap_size;
+    /// Inline buffer.
+    char storage[INLINE_SIZE];
+
+private:
+    // @cond EXCLUDE
+    MemSnapshot(const MemSnapshot &);
+    MemSnapshot & operator= (const MemSnapshot &);
+    // @endcond
+};
+
 /**
  * Memory
  * Provide a contiguous view of memory using the ELF CORE PT_LOAD
@@ -75,6 +230,18 @@ public:
 class Memory
 {
 public:
+    /// Default size of the frame cache.
+    static const size_t DEFAULT_CACHE_SIZE = 16 << 20;
+
+    /// Backend used to access the CORE file.
+    enum Backend
+    {
+        /// pread() from the CORE file, through the frame cache.
+        BACKEND_READ,
+        /// mmap() each PT_LOAD region, falling back to BACKEND_READ per region.
+        BACKEND_MMAP
+    };
+
     /// Constructor.
     Memory();
     /// Destructor.
@@ -84,9 +251,25 @@ public:
      * Set up the memory regions
      * @param path Path of the ELF CORE file.
      * @param elf Elf parser.
+     * @param backend Backend to access the CORE file with.
+     * @param cache_size Size in bytes of the frame cache used for regions
+     * which are not mapped.  0 disables the cache.
      * @return boolean indicating success or failure.
      */
-    bool setup(const char * path, const Abstract::Elf * elf);
+    bool setup(const char * path, const Abstract::Elf * elf,
+               const Backend backend = BACKEND_MMAP,
+               const size_t cache_size = DEFAULT_CACHE_SIZE);
+
+    /// Log usage statistics.
+    void log_stats() const;
+
+    /**
+     * Parse a backend name.
+     * @param name Backend name, "read" or "mmap".
+     * @param backend Backend to fill.
+     * @return boolean indicating whether name was recognised.
+     */
+    static bool parse_backend(const char * name, Backend & backend);
 
     /**
      * Read a string from machine address addr.
@@ -129,6 +312,67 @@ public:
     void read_block_vaddr(const PageTable & pt, const vaddr_t & addr, char * dst, ssize_t n) const;
 
 
+    /**
+     * Perform several virtual reads at once.
+     * All requests are translated first.  Reads from parts of the core
+     * which are not mapped are then sorted by file offset, merged where
+     * adjacent or close, and issued with preadv().  With the frame cache
+     * enabled, the reads fill whole missing frames into the cache.
+     * @param reqs Array of requests.
+     * @param nr Number of requests.
+     */
+    void read_many(const MemRequest * reqs, const size_t nr) const;
+
+    /**
+     * View up to n bytes from machine address addr.
+     * The view stops at the end of the memory region and, if the region is
+     * not mapped, at the end of the bounce buffer.
+     * @param addr Machine address.
+     * @param n Maximum number of bytes to view.
+     * @param view View to fill.
+     */
+    void view_maddr(const maddr_t & addr, const size_t n, MemView & view) const;
+
+    /**
+     * View up to n bytes from virtual address addr.
+     * As view_maddr(), but also stopping at the end of the page.  Callers
+     * wanting more should view again from view.addr + view.length.
+     * @param pt PageTable to perform a pagetable walk with.
+     * @param addr Virtual address.
+     * @param n Maximum number of bytes to view.
+     * @param view View to fill.
+     */
+    void view_vaddr(const PageTable & pt, const vaddr_t & addr, const size_t n, MemView & view) const;
+
+    /**
+     * Read n bytes from virtual address addr using a view, refilling the
+     * view with as much of [addr, end) as possible if it does not cover
+     * the read.  Suitable for walking a range of memory in small steps.
+     * @param view View to read through.
+     * @param pt PageTable to perform a pagetable walk with.
+     * @param addr Virtual address.
+     * @param dst Destination buffer.
+     * @param n Number of bytes to read.
+     * @param end End of the range being walked.
+     */
+    void read_view(MemView & view, const PageTable & pt, const vaddr_t & addr,
+                   void * dst, const size_t n, const vaddr_t & end) const;
+
+    /**
+     * Read an integer from virtual address addr using a view.
+     * @param view View to read through.
+     * @param pt PageTable to perform a pagetable walk with.
+     * @param addr Virtual address.
+     * @param dst Destination integer.
+     * @param end End of the range being walked.
+     */
+    template <typename T>
+    void read_view(MemView & view, const PageTable & pt, const vaddr_t & addr,
+                   T & dst, const vaddr_t & end) const
+    {
+        this->read_view(view, pt, addr, &dst, sizeof dst, end);
+    }
+
     /**
      * Read a 8 bit integer from addr.
      * Reads 1 bytes from addr into dst.
@@ -199,7 +443,9 @@ public:
 
     /**
      * Writes a block of from addr into the specified file.
-     * Reads n bytes starting at addr into file.
+     * Reads n bytes starting at addr into file.  Large extents are copied
+     * from the CORE file by the kernel, without passing through this
+     * process; the file is flushed first.
      * @param addr Machine address.
      * @param file Destination file reference.
      * @param n Length of buffer.
@@ -209,7 +455,8 @@ public:
 
     /**
      * Writes a block of from addr into the specified file.
-     * Reads n bytes starting at addr into file.
+     * Reads n bytes starting at addr into file, as write_block_to_file(),
+     * taking pages which are contiguous in machine memory together.
      * @param pt PageTable to perform a pagetable walk with.
      * @param addr Virtual address.
      * @param file Destination file reference.
@@ -218,14 +465,99 @@ public:
      */
     ssize_t write_block_vaddr_to_file(const PageTable & pt, const vaddr_t & addr, FILE * file, ssize_t n) const;
 
+    /**
+     * Get a pointer to a whole frame, if it is mapped.
+     * @param frame Machine address of a FrameCache::FRAME_SIZE aligned frame.
+     * @returns Pointer to the frame in the mapping, or NULL if the frame is
+     * not entirely within a mapped region.
+     */
+    const char * mapped_frame(const maddr_t & frame) const;
+
+    /**
+     * Read a whole frame directly from the CORE file, bypassing the frame
+     * cache.  Does not log or throw on failure.
+     * @param frame Machine address of a FrameCache::FRAME_SIZE aligned frame.
+     * @param dst Destination buffer of FrameCache::FRAME_SIZE bytes.
+     * @returns boolean indicating success or failure.
+     */
+    bool read_frame(const maddr_t & frame, char * dst) const;
+
 protected:
 
     /**
-     * Seek the CORE file to the byte representing the machine address addr.
-     * @param addr Machine address to seek to.
+     * Look up the memory region containing the machine address addr.
+     * @param addr Machine address to look up.
+     * @returns Memory region, or NULL if no region contains addr.
+     */
+    const MemRegion * lookup_region(const maddr_t & addr) const;
+
+    /**
+     * Find the memory region containing the machine address addr.
+     * @param addr Machine address to look up.
+     * @returns Memory region.  Throws memseek if no region contains addr.
+     */
+    const MemRegion & find_region(const maddr_t & addr) const;
+
+    /**
+     * Read n bytes from machine address addr into dst, from the mapping or
+     * frame cache if possible, or from the CORE file otherwise.
+     * @param addr Machine address.
+     * @param dst Destination buffer.
+     * @param n Number of bytes to read.
+     */
+    void read_raw(const maddr_t & addr, void * dst, ssize_t n) const;
+
+    /**
+     * Read n bytes from machine address addr into dst, using the frame cache.
+     * The range must lie entirely within region.
+     * @param region Memory region containing addr.
+     * @param addr Machine address.
+     * @param dst Destination buffer.
+     * @param n Number of bytes to read.
+     */
+    void read_cached(const MemRegion & region, const maddr_t & addr, char * dst, ssize_t n) const;
+
+    /**
+     * Read n bytes from machine address addr into dst, directly from the
+     * CORE file.
+     * @param region Memory region containing addr.
+     * @param addr Machine address.
+     * @param dst Destination buffer.
+     * @param n Number of bytes to read.
+     */
+    void read_file(const MemRegion & region, const maddr_t & addr, void * dst, ssize_t n) const;
+
+    /**
+     * Get a frame from the frame cache, reading it from the CORE file if
+     * necessary.
+     * @param region Memory region containing the frame.
+     * @param frame Machine address of the frame.
+     * @returns Frame data, or NULL if the frame can't be cached.
+     */
+    const char * get_frame(const MemRegion & region, const maddr_t & frame) const;
+
+    /**
+     * Copy n bytes from machine address addr to a file descriptor, straight
+     * from the CORE file within the kernel.  Uses copy_file_range() where
+     * available, and sendfile() otherwise.  The range must lie entirely
+     * within region.
+     * @param region Memory region containing addr.
+     * @param addr Machine address.
+     * @param out File descriptor to write to, at its current offset.
+     * @param n Number of bytes to copy.
+     * @returns Number of bytes copied.  Short if the kernel can't copy
+     * between these files, or on error.
+     */
+    size_t copy_file(const MemRegion & region, const maddr_t & addr, const int out,
+                     const size_t n) const;
+
+    /**
+     * Try to mmap() a memory region of the CORE file.
+     * @param region Region to map.
+     * @param file_size Size of the CORE file, or -1 if unknown (no limit).
      * @returns boolean indicating success or failure.
      */
-    void seek(const maddr_t & addr) const;
+    bool map_region(MemRegion & region, const uint64_t file_size) const;
 
     /// Vector of memory regions.
     std::vector<MemRegion> regions;
@@ -233,6 +565,12 @@ protected:
     bool finalised;
     /// Core File reference
     int fd;
+    /// Backend in use.
+    Backend backend;
+    /// Cache of frames from regions which are not mapped.
+    mutable FrameCache frame_cache;
+    /// Protects frame_cache, including copies out of cached frames.
+    mutable Mutex cache_lock;
 };
 
 /// Memory
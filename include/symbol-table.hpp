@@ -27,8 +27,11 @@
  */
 
 #include "util/symbol.hpp"
-#include <map>
-#include <list>
+#include "util/xensym-common.hpp"
+#include "util/worker-pool.hpp"
+#include "util/writer.hpp"
+#include "util/stack-scan.hpp"
+#include <vector>
 
 #include <cstdio>
 
@@ -36,8 +39,21 @@
  * Symbol table.
  * Symbols need to be indexed by name (to find specific data in memory),
  * and by address (to generate a stack trace).  Therefore, maintain two
- * mappings to the same symbol objects; one a mapping of virtual address
+ * mappings to the same symbol records; one a mapping of virtual address
  * to symbol, and one a mapping of name to symbol.
+ *
+ * Symbols are held as a single array of fixed size records, with names in
+ * a single string table, and everything refers to them by 32bit index.
+ * The arrays are either owned by the table, or mapped directly from a
+ * binary index saved by an earlier run.
+ *
+ * The name mapping is an open addressing hash table with linear probing,
+ * holding one entry per distinct name.  Names which appear more than once
+ * are marked ambiguous, and can't be looked up.
+ *
+ * The address mapping covers code symbols only.  It is a sorted array of
+ * symbols, searched through a copy of their addresses in Eytzinger (BFS)
+ * order, which keeps the hot top levels of the search together in cache.
  */
 class SymbolTable
 {
@@ -63,40 +79,92 @@ public:
 
     /**
      * Parse a symbol file.
+     * May only be called once per SymbolTable.  Large files are split
+     * between up to WorkerPool::threads() threads.
      * @param path Path to the symbol file.
      * @param offsets Whether to check for offset symbols.
      * @returns boolean indicating success.
      */
     bool parse(const char * path, bool offsets = false);
 
+    /**
+     * Set the directory in which binary symbol indexes are cached.
+     * @param dir Directory, or NULL to disable the cache.
+     */
+    static void set_cache_dir(const char * dir);
+
     /**
      * Print a 32bit symbol.
      *
-     * @param stream Stream to print to.
+     * @param stream Writer to print to.
      * @param addr Address of symbol.
      * @param brackets boolean indicating whether brackets should be printed.
      * @returns number of bytes written to stream.
      */
-    int print_symbol32(FILE * stream, const vaddr_t & addr, bool brackets = false) const;
+    int print_symbol32(Writer & stream, const vaddr_t & addr, bool brackets = false) const;
 
     /**
      * Print a 64bit symbol.
      *
-     * @param stream Stream to print to.
+     * @param stream Writer to print to.
      * @param addr Address of symbol.
      * @param brackets boolean indicating whether brackets should be printed.
      * @returns number of bytes written to stream.
      */
-    int print_symbol64(FILE * stream, const vaddr_t & addr, bool brackets = false) const;
+    int print_symbol64(Writer & stream, const vaddr_t & addr, bool brackets = false) const;
+
+    /**
+     * Print a batch of 32bit symbols, as print_symbol32() would for each
+     * address in turn.
+     *
+     * The addresses are resolved together in a single pass over the code
+     * symbols, which is far cheaper than a search each for a stack page.
+     *
+     * @param stream Writer to print to.
+     * @param addrs Addresses of symbols.
+     * @param nr Number of addresses.
+     * @returns number of bytes written to stream.
+     */
+    int print_symbols32(Writer & stream, const vaddr_t * addrs, const size_t nr) const;
+
+    /**
+     * Print a batch of 64bit symbols, as print_symbol64() would for each
+     * address in turn.
+     *
+     * @param stream Writer to print to.
+     * @param addrs Addresses of symbols.
+     * @param nr Number of addresses.
+     * @returns number of bytes written to stream.
+     */
+    int print_symbols64(Writer & stream, const vaddr_t * addrs, const size_t nr) const;
 
     /**
      * Print the text part of a symbol only.
      *
-     * @param stream Stream to print to.
+     * @param stream Writer to print to.
      * @param addr Address of symbol.
      * @returns number of bytes written to stream.
      */
-    int print_text_symbol(FILE * stream, const vaddr_t & addr) const;
+    int print_text_symbol(Writer & stream, const vaddr_t & addr) const;
+
+    /**
+     * Log lookup cache statistics.
+     * @param name Name of the table, for the log message.
+     */
+    void log_stats(const char * name) const;
+
+    /// Number of address lookups cached per table.
+    static const size_t LOOKUP_CACHE_SIZE = 4096;
+
+    /**
+     * Name of a symbol.
+     * @param sym Symbol from this table.
+     * @returns Name.
+     */
+    const char * name(const Symbol * sym) const
+    {
+        return &this->strings[sym->name];
+    }
 
     /**
      * Is the address within the text region.
@@ -105,6 +173,13 @@ public:
      */
     bool is_text_symbol(const vaddr_t & addr) const;
 
+    /**
+     * Add the ranges which is_text_symbol() accepts to a stack scanner,
+     * as StackScanner::TEXT.
+     * @param scan Stack scanner.
+     */
+    void add_text_ranges(StackScanner & scan) const;
+
     /// Whether this symbol table can print symbols.
     bool can_print;
     /// Whether this symbol table can decode hypercall pages.
@@ -112,38 +187,171 @@ public:
 
 protected:
 
+    /// Xen symbol or offset from the symbol file, for the binary index.
+    struct XensymRef
+    {
+        /// Value.
+        vaddr_t value;
+        /// Offset of the name in the string table.
+        uint32_t name;
+        /// Padding.
+        uint32_t pad;
+    };
+
+    /// Entry in the name index.
+    struct NameSlot
+    {
+        /// Low half of the hash of the name.
+        uint32_t hash;
+        /// Symbol number, possibly with NAME_AMBIGUOUS set, or NAME_EMPTY.
+        uint32_t sym;
+    };
+
+    /// Marker for an unused NameSlot.
+    static const uint32_t NAME_EMPTY = ~0U;
+    /// Set in NameSlot::sym if more than one symbol has the name.
+    static const uint32_t NAME_AMBIGUOUS = 1U << 31;
+    /// Limit on the number of symbols, so they can be marked ambiguous.
+    static const uint32_t MAX_SYMBOLS = NAME_AMBIGUOUS - 1;
+
     /**
-     * Insert a new Symbol into the tables.
-     * @param sym Symbol to insert.
+     * Build the tables from the symbols parsed out of a symbol file.
+     * Offset symbols, whose names start with '+', are dropped.
+     * @param offsets Whether to check for offset symbols.
+     * @param xensyms Filled with the Xen symbols and offsets found.
+     */
+    void build(const bool offsets, std::vector<XensymRef> & xensyms);
+
+    /**
+     * Point the table at its own storage.
+     */
+    void attach_owned();
+
+    /**
+     * Work out which address ranges can be printed, once all symbols are
+     * present.
+     */
+    void finish_parse();
+
+    /**
+     * Index of the xensyms known to the analyser, built on first use.
+     * @returns Index of the abstract and x86_64 xensym lists.
+     */
+    static const XensymIndex & xensym_index();
+
+    /**
+     * Hash the contents of a symbol file, to key the binary index.
+     * @param data File contents.
+     * @param size Size of the contents.
+     * @returns 64bit hash.
+     */
+    static uint64_t hash_contents(const char * data, const size_t size);
+
+    /**
+     * Load the symbol table from a binary index.
+     * Does nothing unless the index matches the symbol file and this
+     * build of the analyser.
+     * @param path Path of the index.
+     * @param hash hash_contents() of the symbol file.
+     * @param size Size of the symbol file.
+     * @param offsets Whether the symbol file is checked for offset symbols.
+     * @returns boolean indicating whether the table was loaded.
+     */
+    bool load_index(const char * path, const uint64_t hash, const uint64_t size,
+                    const bool offsets);
+
+    /**
+     * Save the symbol table as a binary index.
+     * @param path Path of the index.
+     * @param hash hash_contents() of the symbol file.
+     * @param size Size of the symbol file.
+     * @param offsets Whether the symbol file was checked for offset symbols.
+     * @param xensyms Xen symbols and offsets found in the file.
+     * @returns boolean indicating success.
      */
-    void insert(Symbol * sym);
+    bool save_index(const char * path, const uint64_t hash, const uint64_t size,
+                    const bool offsets, const std::vector<XensymRef> & xensyms) const;
 
     /**
-     * Private wrapper around std::strcmp.
-     * Suitable as a comparison function for std::multimap
-     * @param lhs Left hand side string.
-     * @param rhs Right hand side string.
-     * @returns boolean.
+     * Find the name index slot for a name.
+     * @param slots Name index, a power of two in size.
+     * @param nr_slots Size of the name index.
+     * @param name Symbol name.
+     * @param hash Hash of the name.
+     * @returns Index of the slot holding the name, or of the empty slot
+     * where it would be inserted.
      */
-    static bool strcmp(const char * lhs, const char * rhs);
+    size_t name_slot(const NameSlot * slots, const size_t nr_slots,
+                     const char * name, const uint64_t hash) const;
 
     /**
-     * Private helper for sorting list.  Sorts by symbol address.
+     * Fill the Eytzinger index from the sorted code symbols.
      *
-     * @param lhs Left hand side Symbol.
-     * @param rhs Right hand side Symbol.
-     * @returns boolean.
+     * @param next Next sorted symbol to place.
+     * @param k Eytzinger index to fill at.
+     * @returns Next sorted symbol to place after this subtree.
      */
-    static bool addrcmp(const Symbol * lhs, const Symbol * rhs);
+    size_t fill_text_index(size_t next, const size_t k);
 
     /**
-     * Private helper for searching lot.
+     * Print a symbol which has been looked up.
      *
-     * @param addr Address to compare.
-     * @param sym Symbol to compare to.
-     * @returns boolean.
+     * @param stream Writer to print to.
+     * @param addr Address of symbol.
+     * @param before Last code symbol at or below addr.
+     * @param after First code symbol above addr.
+     * @param brackets boolean indicating whether brackets should be printed.
+     * @param width Number of hex digits to print addr with.
+     * @returns number of bytes written to stream.
      */
-    static bool symcmp(const vaddr_t & addr, const Symbol * sym);
+    int print_symbol(Writer & stream, const vaddr_t & addr, const Symbol * before,
+                     const Symbol * after, bool brackets, const int width) const;
+
+    /**
+     * Print a batch of symbols.
+     *
+     * @param stream Writer to print to.
+     * @param addrs Addresses of symbols.
+     * @param nr Number of addresses.
+     * @param width Number of hex digits to print addresses with.
+     * @returns number of bytes written to stream.
+     */
+    int print_symbols(Writer & stream, const vaddr_t * addrs, const size_t nr,
+                      const int width) const;
+
+    /**
+     * Look an address up in the lookup cache.
+     * @param addr Address.
+     * @param rank Set to the cached upper_rank() of addr on a hit.
+     * @returns boolean indicating a hit.
+     */
+    bool cache_lookup(const vaddr_t & addr, size_t & rank) const;
+
+    /**
+     * Record an address lookup in the lookup cache.
+     * @param addr Address.
+     * @param rank upper_rank() of addr.
+     */
+    void cache_insert(const vaddr_t & addr, const size_t rank) const;
+
+    /**
+     * Find the first code symbol above an address.
+     *
+     * @param addr Address to look up.
+     * @returns Position in text, or nr_text if there is none.
+     */
+    size_t upper_rank(const vaddr_t & addr) const;
+
+    /**
+     * Find the code symbols either side of an address.
+     *
+     * @param addr Address to look up.
+     * @param before Set to the last symbol at or below addr.
+     * @param after Set to the first symbol above addr.
+     * @returns boolean indicating whether both symbols were found.
+     */
+    bool lookup_text_symbol(const vaddr_t & addr, const Symbol *& before,
+                            const Symbol *& after) const;
 
     /// value of '_stext' symbol.
     vaddr_t text_start,
@@ -156,21 +364,127 @@ protected:
     /// value of 'hypercall_page' symbol.
         hypercall_page;
 
-    /// Multimap of Symbol name -> Symbol
-    std::multimap<const char *, Symbol *, bool(*)(const char*, const char*)> names;
-    /// List of code symbols, for stack traces.
-    std::list<Symbol*> symbols;
+    /// Directory of cached binary symbol indexes, or NULL.
+    static const char * cache_dir;
+
+    /// All symbols, in file order.
+    const Symbol * records;
+    /// Number of symbols.
+    size_t nr_records;
+    /// Symbol names, each nul terminated.
+    const char * strings;
+    /// Size of the string table.
+    size_t strings_size;
+    /// Code symbols as symbol numbers, sorted by address.
+    const uint32_t * text;
+    /// Number of code symbols.
+    size_t nr_text;
+    /// Code symbol addresses in Eytzinger order, 1-based, nr_text+1 long.
+    const vaddr_t * text_index;
+    /// Position in text of each entry of text_index.
+    const uint32_t * text_rank;
+    /// Name index.
+    const NameSlot * names;
+    /// Size of the name index, a power of two.
+    size_t nr_slots;
+
+    /// Storage for records, if parsed.
+    std::vector<Symbol> own_records;
+    /// Storage for strings, if parsed.
+    std::vector<char> own_strings;
+    /// Storage for text, if parsed.
+    std::vector<uint32_t> own_text;
+    /// Storage for text_index, if parsed.
+    std::vector<vaddr_t> own_text_index;
+    /// Storage for text_rank, if parsed.
+    std::vector<uint32_t> own_text_rank;
+    /// Storage for names, if parsed.
+    std::vector<NameSlot> own_names;
+
+    /// Cached address lookup.
+    struct LookupEntry
+    {
+        /// Address looked up.
+        vaddr_t addr;
+        /// upper_rank() of addr, or LOOKUP_EMPTY for an unused entry.
+        uint32_t rank;
+    };
 
-    /// List iterator
-    typedef std::list<Symbol*>::iterator list_iter;
-    /// Constant list iterator
-    typedef std::list<Symbol*>::const_iterator const_list_iter;
+    /// Marker for an unused LookupEntry.
+    static const uint32_t LOOKUP_EMPTY = ~0U;
 
-    /// Multimap pair
-    typedef std::pair<const char *, Symbol*> name_pair;
+    /// Direct mapped cache of address lookups, allocated on first use.
+    mutable LookupEntry * lookup_cache;
+    /// Number of lookups satisfied from the cache.
+    mutable uint64_t lookup_hits;
+    /// Number of lookups which missed the cache.
+    mutable uint64_t lookup_misses;
+    /// Protects the lookup cache and its statistics.
+    mutable Mutex lookup_lock;
+
+    /// Mapping of the binary index the table was loaded from, or NULL.
+    void * index_map;
+    /// Length of index_map.
+    size_t index_map_size;
+
+private:
+    // @cond EXCLUDE
+    SymbolTable(const SymbolTable &);
+    SymbolTable & operator= (const SymbolTable &);
+    // @endcond
+};
+
+/**
+ * Collects addresses to be printed as symbols, so a stack page at a time
+ * can be resolved with SymbolTable::print_symbols64() or print_symbols32().
+ *
+ * Anything added must be flushed, including when bailing out part way
+ * through a stack, to keep the output as if printed one at a time.
+ */
+class SymbolBatch
+{
+public:
+    /// Number of addresses held before they are printed, a page of words.
+    static const size_t BATCH_SIZE = 512;
+
+    /**
+     * Constructor.
+     * @param symtab Symbol table to print with.
+     * @param stream Writer to print to.
+     * @param wide boolean indicating 64bit rather than 32bit symbols.
+     */
+    SymbolBatch(const SymbolTable & symtab, Writer & stream, bool wide);
+
+    /**
+     * Add an address, printing the batch if it is full.
+     * @param addr Address of symbol.
+     * @returns number of bytes written to stream.
+     */
+    int add(const vaddr_t & addr);
+
+    /**
+     * Print any addresses held.
+     * @returns number of bytes written to stream.
+     */
+    int flush();
+
+protected:
+    /// Symbol table.
+    const SymbolTable & symtab;
+    /// Writer.
+    Writer & stream;
+    /// 64bit rather than 32bit symbols.
+    bool wide;
+    /// Number of addresses held.
+    size_t nr;
+    /// Addresses held.
+    vaddr_t addrs[BATCH_SIZE];
 
-    /// Multimap const iterator
-    typedef std::multimap<const char *, Symbol *, bool(*)(const char*, const char*)>::const_iterator name_iter;
+private:
+    // @cond EXCLUDE
+    SymbolBatch(const SymbolBatch &);
+    SymbolBatch & operator= (const SymbolBatch &);
+    // @endcond
 };
 
 #endif
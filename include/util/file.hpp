@@ -33,6 +33,7 @@
  * Because all the parameters passed in could be relative links to the
  * required files, this program has to run from the working directory.
  * However, it needs to put files out in the output directory.
+ * Safe to call from several threads at once.
  * @param path Path of the file, relative to the output directory.
  * @param flags Open mode flags for fopen.
  * @returns fopen'd descriptor, or NULL.
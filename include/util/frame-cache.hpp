@@ -0,0 +1,171 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#ifndef __FRAME_CACHE_HPP__
+#define __FRAME_CACHE_HPP__
+
+/**
+ * @file include/util/frame-cache.hpp
+ * @author agent
+ */
+
+#include "types.hpp"
+
+#include <cstddef>
+
+/**
+ * Fixed size cache of 4K frames, with LRU eviction.
+ *
+ * All memory is allocated by init(), so the cache never grows beyond
+ * its budget.  Frames are identified by an arbitrary 64bit key, typically
+ * a machine frame number.
+ */
+class FrameCache
+{
+public:
+    /// Size of a cached frame.
+    static const size_t FRAME_SIZE = 4096;
+
+    /// Constructor.
+    FrameCache();
+    /// Destructor.
+    ~FrameCache();
+
+    /**
+     * Allocate space for the cache.
+     * @param nr_frames Number of frames to hold.
+     * @returns boolean indicating success or failure.
+     */
+    bool init(const size_t nr_frames);
+
+    /**
+     * Look up a frame, marking it as most recently used.
+     * @param key Frame key.
+     * @returns Pointer to the frame data, or NULL if not present.
+     */
+    const char * lookup(const uint64_t & key);
+
+    /**
+     * Claim a slot for a frame, evicting the least recently used frame if
+     * the cache is full.  The caller is expected to fill the returned
+     * buffer, or to call invalidate() if it is unable to.
+     * @param key Frame key, which must not already be present.
+     * @returns Pointer to FRAME_SIZE bytes of frame data.
+     */
+    char * insert(const uint64_t & key);
+
+    /**
+     * Remove a frame from the cache, if present.
+     * @param key Frame key.
+     */
+    void invalidate(const uint64_t & key);
+
+    /**
+     * Log usage statistics.
+     * @param name Name of the cache, for the log message.
+     */
+    void log_stats(const char * name) const;
+
+    /// Number of frames the cache can hold.
+    size_t nr_frames;
+    /// Number of lookups which hit.
+    uint64_t hits;
+    /// Number of lookups which missed.
+    uint64_t misses;
+    /// Number of frames evicted to make space.
+    uint64_t evictions;
+
+protected:
+    /// Index used to terminate lists.
+    static const uint32_t NONE = ~0U;
+
+    /// Per slot metadata.
+    struct Slot
+    {
+        /// Frame key.
+        uint64_t key;
+        /// Next slot in the hash chain.
+        uint32_t hash_next;
+        /// More recently used slot.
+        uint32_t lru_prev;
+        /// Less recently used slot.
+        uint32_t lru_next;
+    };
+
+    /**
+     * Hash bucket for a key.
+     * @param key Frame key.
+     * @returns Bucket index.
+     */
+    uint32_t bucket(const uint64_t & key) const;
+
+    /**
+     * Remove a slot from the hash chain of its key.
+     * @param slot Slot index.
+     */
+    void unhash(const uint32_t slot);
+
+    /**
+     * Remove a slot from the LRU list.
+     * @param slot Slot index.
+     */
+    void lru_remove(const uint32_t slot);
+
+    /**
+     * Insert a slot at the most recently used end of the LRU list.
+     * @param slot Slot index.
+     */
+    void lru_push(const uint32_t slot);
+
+    /// Slot metadata.
+    Slot * slots;
+    /// Frame data, FRAME_SIZE bytes per slot.
+    char * data;
+    /// Hash bucket heads.
+    uint32_t * buckets;
+    /// Number of hash buckets, a power of two.
+    uint32_t nr_buckets;
+    /// Number of slots handed out so far.
+    uint32_t nr_used;
+    /// Unused slots available for reuse.
+    uint32_t free_head;
+    /// Most recently used slot.
+    uint32_t lru_head;
+    /// Least recently used slot.
+    uint32_t lru_tail;
+
+private:
+    // @cond EXCLUDE
+    FrameCache(const FrameCache &);
+    FrameCache & operator= (const FrameCache &);
+    // @endcond
+};
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,91 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#ifndef __HEX_HPP__
+#define __HEX_HPP__
+
+/**
+ * @file include/util/hex.hpp
+ * @author agent
+ *
+ * Fixed width hex formatting of blocks of values, for stack and structure
+ * dumps.  Uses AVX2 or SSE2 where available, chosen at runtime, and plain
+ * C++ otherwise.  Output is lower case and is not null terminated.
+ */
+
+#include "types.hpp"
+
+#include <cstddef>
+
+/// Characters written by hex_words64() per value.
+static const size_t HEX_WORD64_LEN = 17;
+/// Characters written by hex_words32() per value.
+static const size_t HEX_WORD32_LEN = 9;
+/// Characters written by hex_bytes() per byte.
+static const size_t HEX_BYTE_LEN = 3;
+
+/**
+ * Format a value as 16 hex digits, as per "%016"PRIx64.
+ * @param out Buffer for 16 characters.
+ * @param val Value.
+ */
+void hex_64(char * out, const uint64_t val);
+
+/**
+ * Format 64bit values, each as per " %016"PRIx64.
+ * @param out Buffer for nr * HEX_WORD64_LEN characters.
+ * @param vals Values.
+ * @param nr Number of values.
+ */
+void hex_words64(char * out, const uint64_t * vals, const size_t nr);
+
+/**
+ * Format 32bit values, each as per " %08"PRIx32.
+ * @param out Buffer for nr * HEX_WORD32_LEN characters.
+ * @param vals Values.
+ * @param nr Number of values.
+ */
+void hex_words32(char * out, const uint32_t * vals, const size_t nr);
+
+/**
+ * Format bytes, each as per "%02x ".
+ * @param out Buffer for nr * HEX_BYTE_LEN characters.
+ * @param data Bytes.
+ * @param nr Number of bytes.
+ */
+void hex_bytes(char * out, const uint8_t * data, const size_t nr);
+
+/**
+ * Name of the implementation in use.
+ * @returns "avx2", "sse2" or "scalar".
+ */
+const char * hex_impl_name();
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
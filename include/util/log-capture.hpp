@@ -0,0 +1,86 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#ifndef __LOG_CAPTURE_HPP__
+#define __LOG_CAPTURE_HPP__
+
+/**
+ * @file include/util/log-capture.hpp
+ * @author agent
+ */
+
+#include <cstdio>
+
+/**
+ * Buffer for the log file output of one item of concurrent work.
+ *
+ * While started, the log file output of the calling thread is appended to
+ * the buffer.  Flushing the buffers of several items in order makes the
+ * log file read the same as if the items had been worked on serially.
+ */
+class LogCapture
+{
+public:
+    /// Constructor.
+    LogCapture();
+    /// Destructor.  Flushes any captured output.
+    ~LogCapture();
+
+    /**
+     * Start capturing the calling thread's log file output.  If a buffer
+     * can't be allocated, output continues to go straight to the log file.
+     */
+    void start();
+
+    /// Stop capturing the calling thread's log file output.
+    void stop();
+
+    /// Write the captured output to the log file, and empty the buffer.
+    void flush();
+
+    /// Empty the buffer without writing the captured output anywhere.
+    void discard();
+
+protected:
+    /// Stream writing to data.
+    FILE * stream;
+    /// Captured output.
+    char * data;
+    /// Length of data.
+    size_t size;
+
+private:
+    // @cond EXCLUDE
+    LogCapture(const LogCapture &);
+    LogCapture & operator= (const LogCapture &);
+    // @endcond
+};
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -56,7 +56,9 @@ enum LOG_VERBOSITY
 extern int verbosity;
 
 /**
- * Log function.
+ * Log function.  Normally called through the LOG_* macros, which have
+ * already checked the severity against verbosity.  Safe to call from
+ * multiple threads.
  * @param severity Severity of the log message.  Interacts with verbosity to work
  * out whether it should be logged or not.
  * @param file File string (__FILE__).
@@ -67,47 +69,78 @@ extern int verbosity;
  */
 void __log(int severity, const char * file, int line, const char * fnc, const char * fmt, ...);
 
+class Writer;
+
+/**
+ * Set an additional destination for error logging, for the calling thread.
+ * Warnings and errors are appended to the writer, in order with the output
+ * it holds.
+ * @param w Writer, or NULL to cancel.
+ */
+void set_additional_log(Writer * w);
+
+/**
+ * Divert log file output from the calling thread into a stream, so output
+ * from concurrent work can be written to the log file in a sensible order.
+ * Errors are still sent to stderr immediately.
+ * @param fd Stream, or NULL to write to the log file again.
+ */
+void set_log_capture(FILE * fd);
+
+/**
+ * Write previously captured output to the log file.
+ * @param data Captured output.
+ * @param len Length of data.
+ */
+void write_log_capture(const char * data, size_t len);
+
 /**
- * Set an additional destination for error logging.
- * @param fd File descriptor, or NULL to cancel.
+ * Will a log message of the given severity be emitted?  The LOG macros
+ * check this before evaluating or formatting their arguments, so
+ * suppressed messages cost no more than the comparison.
+ * @param severity Severity of the log message.
  */
-void set_additional_log(FILE * fd);
+#define LOG_ENABLED(severity) ((severity) <= verbosity)
 
 /**
  * Debug log message
  * @param fmt String format, as per printf.
  * @param args Extra arguments, as per printf.
  */
-#define LOG_DEBUG(fmt, args...) \
-    do { __log(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __FUNCTION__,   \
-               (fmt) , ##args); } while(0)
+#define LOG_DEBUG(fmt, args...)                                       \
+    do { if ( LOG_ENABLED(LOG_LEVEL_DEBUG) )                          \
+            __log(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __FUNCTION__,  \
+                  (fmt) , ##args); } while(0)
 
 /**
  * Info log message
  * @param fmt String format, as per printf.
  * @param args Extra arguments, as per printf.
  */
-#define LOG_INFO(fmt, args...) \
-    do { __log(LOG_LEVEL_INFO, __FILE__, __LINE__ , __FUNCTION__,   \
-               (fmt) , ##args); } while(0)
+#define LOG_INFO(fmt, args...)                                        \
+    do { if ( LOG_ENABLED(LOG_LEVEL_INFO) )                           \
+            __log(LOG_LEVEL_INFO, __FILE__, __LINE__, __FUNCTION__,   \
+                  (fmt) , ##args); } while(0)
 
 /**
  * Warning log message
  * @param fmt String format, as per printf.
  * @param args Extra arguments, as per printf.
  */
-#define LOG_WARN(fmt, args...) \
-    do { __log(LOG_LEVEL_WARN, __FILE__, __LINE__ , __FUNCTION__,   \
-               (fmt) , ##args); } while(0)
+#define LOG_WARN(fmt, args...)                                        \
+    do { if ( LOG_ENABLED(LOG_LEVEL_WARN) )                           \
+            __log(LOG_LEVEL_WARN, __FILE__, __LINE__, __FUNCTION__,   \
+                  (fmt) , ##args); } while(0)
 
 /**
  * Error log message
  * @param fmt String format, as per printf.
  * @param args Extra arguments, as per printf.
  */
-#define LOG_ERROR(fmt, args...) \
-    do { __log(LOG_LEVEL_ERROR, __FILE__, __LINE__ , __FUNCTION__,  \
-               (fmt) , ##args); } while(0)
+#define LOG_ERROR(fmt, args...)                                       \
+    do { if ( LOG_ENABLED(LOG_LEVEL_ERROR) )                          \
+            __log(LOG_LEVEL_ERROR, __FILE__, __LINE__, __FUNCTION__,  \
+                  (fmt) , ##args); } while(0)
 
 #endif
 
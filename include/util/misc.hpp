@@ -26,6 +26,8 @@
  * @author Andrew Cooper
  */
 
+#include "types.hpp"
+
 #include <cstddef>
 
 /**
@@ -37,6 +39,41 @@
  */
 bool is_zeroes(const char * buffer, const size_t size);
 
+/**
+ * Length of the run of zero words at the start of a buffer.
+ * Checks 64 bytes at a time with SSE2 where available.
+ *
+ * @param words Words to check.
+ * @param nr Number of words.
+ * @return Number of leading zero words, nr if they are all zero.
+ */
+size_t zero_run_length(const uint64_t * words, const size_t nr);
+
+/// Starting value for a 64bit FNV-1a hash.
+static const uint64_t FNV1A_INIT = 0xcbf29ce484222325ULL;
+/// 64bit FNV prime.
+static const uint64_t FNV1A_PRIME = 0x100000001b3ULL;
+
+/**
+ * 64bit FNV-1a hash of a buffer.
+ * Callers wanting a 32bit hash may truncate the result.
+ *
+ * @param data Buffer to hash.
+ * @param len Length of the buffer.
+ * @param hash Running hash to continue from.
+ * @return Updated hash.
+ */
+uint64_t fnv1a(const void * data, const size_t len, uint64_t hash = FNV1A_INIT);
+
+/**
+ * 64bit FNV-1a hash of a null terminated string, excluding the terminator.
+ *
+ * @param str String to hash.
+ * @param hash Running hash to continue from.
+ * @return Updated hash.
+ */
+uint64_t fnv1a_str(const char * str, uint64_t hash = FNV1A_INIT);
+
 #endif
 
 /*
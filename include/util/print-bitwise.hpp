@@ -24,52 +24,52 @@
  */
 
 #include "types.hpp"
-#include <cstdio>
+#include "util/writer.hpp"
 
 /**
  * Bitwise decode cr0 to stream.
  *
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param cr0 CR0 register to decode.
  * @return number of bytes written.
  */
-int print_cr0(FILE * stream, const uint64_t & cr0);
+int print_cr0(Writer & stream, const uint64_t & cr0);
 
 /**
  * Bitwise decode cr4 to stream.
  *
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param cr4 CR4 register to decode.
  * @return number of bytes written.
  */
-int print_cr4(FILE * stream, const uint64_t & cr4);
+int print_cr4(Writer & stream, const uint64_t & cr4);
 
 /**
  * Bitwise decode rflags to stream.
  *
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param rflags register to decode.
  * @return number of bytes written.
  */
-int print_rflags(FILE * stream, const uint64_t & rflags);
+int print_rflags(Writer & stream, const uint64_t & rflags);
 
 /**
  * Bitwise decode a vcpu's pause_flags to stream.
  *
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pause_flags to decode.
  * @return number of bytes written.
  */
-int print_pause_flags(FILE * stream, const uint32_t & pause_flags);
+int print_pause_flags(Writer & stream, const uint32_t & pause_flags);
 
 /**
  * Bitwise decode a domains paging mode assistance flags to stream.
  *
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param paging_mode to decode.
  * @return number of bytes written.
  */
-int print_paging_mode(FILE * stream, const uint32_t & paging_mode);
+int print_paging_mode(Writer & stream, const uint32_t & paging_mode);
 
 /*
  * Local variables:
@@ -25,45 +25,45 @@
 
 #include "types.hpp"
 #include "abstract/pagetable.hpp"
-#include <cstdio>
+#include "util/writer.hpp"
 
 using Abstract::PageTable;
 
 /**
  * Print a 64bit stack dump.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param rsp Stack pointer to start at.
  * @param count Number of entries to print.  Defaults to rounding up to the nearest page size.
  * @return Number of bytes written.
  */
-int print_64bit_stack(FILE * stream, const PageTable & pt, const vaddr_t & rsp,
+int print_64bit_stack(Writer & stream, const PageTable & pt, const vaddr_t & rsp,
                       const size_t count=0);
 
 /**
  * Print a 32bit stack dump.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param rsp Stack pointer to start at.
  * @param count Number of entries to print.  Defaults to rounding up to the nearest page size.
  * @return Number of bytes written.
  */
-int print_32bit_stack(FILE * stream, const PageTable & pt, const vaddr_t & rsp,
+int print_32bit_stack(Writer & stream, const PageTable & pt, const vaddr_t & rsp,
                       const size_t count=0);
 
 /**
  * Print a code dump
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param rip Instruction pointer.
  * @return Number of bytes written.
  */
-int print_code(FILE * stream, const PageTable & pt, const vaddr_t & rip);
+int print_code(Writer & stream, const PageTable & pt, const vaddr_t & rip);
 
 
 /**
  * Print a console ring.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param ring Virtual address of the console ring.
  * @param length Total length of the ring buffer.
@@ -71,13 +71,13 @@ int print_code(FILE * stream, const PageTable & pt, const vaddr_t & rip);
  * @param cons Consumer index, or 0 if unavailable.
  * @return Number of bytes written.
  */
-int print_console_ring(FILE * stream, const PageTable & pt, const vaddr_t & ring,
+int print_console_ring(Writer & stream, const PageTable & pt, const vaddr_t & ring,
                        const uint64_t & length, const uint64_t & prod,
                        const uint64_t & cons);
 
 /**
  * Print a console ring from a 3.x kernel.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param log_buf Virtual address of the console log buffer.
  * @param log_buf_len Total length of log buffer.
@@ -85,7 +85,7 @@ int print_console_ring(FILE * stream, const PageTable & pt, const vaddr_t & ring
  * @param log_next_idx Offset in log buffer to the next log record (i.e. one after the last)
  * @return Number of bytes written.
  */
-int print_console_ring_3x(FILE * stream, const PageTable & pt,
+int print_console_ring_3x(Writer & stream, const PageTable & pt,
                           const vaddr_t log_buf,
                           const uint64_t log_buf_len,
                           const uint64_t log_first_idx,
@@ -93,39 +93,39 @@ int print_console_ring_3x(FILE * stream, const PageTable & pt,
 
 /**
  * Dump a data region.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param word_size Size of words (4 or 8) in bytes.
  * @param pt PageTable to do a pagetable lookup with.
  * @param start Virtual address to start dumping from.
  * @param length Total length of data to dump in bytes.
  * @return Number of bytes written.
  */
-int dump_data(FILE * stream, size_t word_size, const PageTable & pt, const vaddr_t & start,
+int dump_data(Writer & stream, size_t word_size, const PageTable & pt, const vaddr_t & start,
               const uint64_t & length);
 
 /**
  * Dump a 32bit data region.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param start Virtual address to start dumping from.
  * @param length Total length of data to dump in bytes.
  * @return Number of bytes written.
  */
 static inline int dump_32bit_data(
-    FILE * stream, const PageTable & pt, const vaddr_t & start,
+    Writer & stream, const PageTable & pt, const vaddr_t & start,
     const uint64_t & length)
 { return dump_data(stream, 4, pt, start, length); }
 
 /**
  * Dump a 64bit data region.
- * @param stream Stream to print to.
+ * @param stream Writer to print to.
  * @param pt PageTable to do a pagetable lookup with.
  * @param start Virtual address to start dumping from.
  * @param length Total length of data to dump in bytes.
  * @return Number of bytes written.
  */
 static inline int dump_64bit_data(
-    FILE * stream, const PageTable & pt, const vaddr_t & start,
+    Writer & stream, const PageTable & pt, const vaddr_t & start,
     const uint64_t & length)
 { return dump_data(stream, 8, pt, start, length); }
 
@@ -0,0 +1,129 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#ifndef __STACK_SCAN_HPP__
+#define __STACK_SCAN_HPP__
+
+/**
+ * @file include/util/stack-scan.hpp
+ * @author agent
+ */
+
+#include "Xen.h"
+#include "types.hpp"
+#include "abstract/pagetable.hpp"
+#include "memory.hpp"
+
+using Abstract::PageTable;
+
+/**
+ * Stack scanner.
+ *
+ * Reads a stack a page at a time and classifies every word of the page
+ * in one go: zero, or within one of a few address ranges (code, or the
+ * stack itself).  Callers then only need to look closer at the words
+ * which are interesting.  Range comparisons use AVX2 where the CPU has
+ * it, and plain C++ otherwise.
+ */
+class StackScanner
+{
+public:
+    /// Word is zero.
+    static const uint8_t ZERO = 1 << 0;
+    /// Word is an address which SymbolTable::is_text_symbol() accepts.
+    static const uint8_t TEXT = 1 << 1;
+    /// Word points into the stack being scanned.
+    static const uint8_t STACK = 1 << 2;
+
+    /// Maximum number of words read at once; a page.
+    static const size_t MAX_WORDS = PAGE_SIZE / 8;
+    /// Maximum number of ranges.
+    static const size_t MAX_RANGES = 4;
+
+    /// Constructor.  No ranges are set.
+    StackScanner();
+
+    /**
+     * Add a range to classify words against.
+     * @param start First address of the range.
+     * @param end Last address of the range, inclusive.
+     * @param flag Flag to set on words within the range.
+     */
+    void add_range(const vaddr_t & start, const vaddr_t & end, const uint8_t flag);
+
+    /**
+     * Read and classify words from addr, up to the end of the page, the end
+     * of the memory region, or end, whichever comes first.  A word
+     * straddling one of these is read on its own.
+     *
+     * Throws the same exceptions as reading the first word would, so a
+     * stack may be scanned with repeated calls until it errors, giving the
+     * same words as reading one at a time.
+     *
+     * @param pt PageTable to perform a pagetable walk with.
+     * @param addr Virtual address to start at.
+     * @param end End of the stack, exclusive.
+     * @returns Number of words in words and flags.  At least 1.
+     */
+    size_t read(const PageTable & pt, const vaddr_t & addr, const vaddr_t & end);
+
+    /**
+     * Classify words against the ranges.
+     * @param words Words.
+     * @param flags Array of nr flags to fill.
+     * @param nr Number of words.
+     */
+    void classify(const uint64_t * words, uint8_t * flags, const size_t nr) const;
+
+    /// Words from the last read().
+    uint64_t words[MAX_WORDS];
+    /// Flags for words.
+    uint8_t flags[MAX_WORDS];
+
+protected:
+    /// First address of each range.
+    vaddr_t range_start[MAX_RANGES];
+    /// Last address of each range, inclusive.
+    vaddr_t range_end[MAX_RANGES];
+    /// Flag for each range.
+    uint8_t range_flag[MAX_RANGES];
+    /// Number of ranges.
+    size_t nr_ranges;
+    /// View of the memory being scanned.
+    MemView view;
+
+private:
+    // @cond EXCLUDE
+    StackScanner(const StackScanner &);
+    StackScanner & operator= (const StackScanner &);
+    // @endcond
+};
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,177 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#ifndef __WORKER_POOL_HPP__
+#define __WORKER_POOL_HPP__
+
+/**
+ * @file include/util/worker-pool.hpp
+ * @author agent
+ */
+
+#include "types.hpp"
+
+#include <cstddef>
+#include <pthread.h>
+
+/**
+ * Pool of worker threads, running independent items of work concurrently.
+ *
+ * Threads only exist for the duration of run().  With a single thread, or
+ * a single item of work, everything runs serially on the caller.
+ */
+class WorkerPool
+{
+public:
+    /// An item of work, identified by its index.
+    class Job
+    {
+    public:
+        /// Destructor.
+        virtual ~Job();
+
+        /**
+         * Perform one item of work.  May be called concurrently for
+         * different indices, and must not throw.  As a last resort, an
+         * exception which escapes is logged and the item abandoned.
+         * @param index Index of the item, below the number passed to run().
+         */
+        virtual void run(const size_t index) = 0;
+    };
+
+    /**
+     * Set the number of threads used to run work.
+     * @param nr Number of threads.  0 picks one per online cpu.
+     */
+    static void set_threads(const unsigned nr);
+
+    /**
+     * Number of threads used to run work.
+     * @returns Number of threads, at least 1.
+     */
+    static unsigned threads();
+
+    /**
+     * Is work currently running on several threads?
+     * @returns boolean.
+     */
+    static bool concurrent() { return running; }
+
+    /**
+     * Run items of work, returning once all have completed.  Items are
+     * handed out in index order.  Nested calls run serially.
+     * @param job Work to perform.
+     * @param nr Number of items.
+     */
+    static void run(Job & job, const size_t nr);
+
+protected:
+    /// Number of threads to use.
+    static unsigned nr_threads;
+    /// Whether run() has worker threads active.
+    static bool running;
+};
+
+/**
+ * Mutual exclusion lock.
+ */
+class Mutex
+{
+public:
+    /// Constructor.
+    Mutex();
+    /// Destructor.
+    ~Mutex();
+
+    /// Take the lock.
+    void lock();
+    /// Release the lock.
+    void unlock();
+
+protected:
+    /// Underlying mutex.
+    pthread_mutex_t mutex;
+
+private:
+    // @cond EXCLUDE
+    Mutex(const Mutex &);
+    Mutex & operator= (const Mutex &);
+    // @endcond
+};
+
+/**
+ * Scoped lock of a Mutex, taken only while a WorkerPool is running work
+ * concurrently.  Serial operation doesn't pay for locking.
+ */
+class MutexLock
+{
+public:
+    /**
+     * Constructor.  Takes the lock if necessary.
+     * @param mutex Mutex to lock.
+     */
+    explicit MutexLock(Mutex & mutex):
+        mutex(WorkerPool::concurrent() ? &mutex : NULL)
+    {
+        if ( this->mutex )
+            this->mutex->lock();
+    }
+
+    /// Destructor.  Releases the lock if it was taken.
+    ~MutexLock()
+    {
+        if ( this->mutex )
+            this->mutex->unlock();
+    }
+
+protected:
+    /// Mutex held, or NULL.
+    Mutex * mutex;
+
+private:
+    // @cond EXCLUDE
+    MutexLock(const MutexLock &);
+    MutexLock & operator= (const MutexLock &);
+    // @endcond
+};
+
+/**
+ * Increment a statistics counter which may be shared between workers.
+ * @param counter Counter to increment.
+ */
+inline void count_event(uint64_t & counter)
+{
+    if ( WorkerPool::concurrent() )
+        __sync_fetch_and_add(&counter, 1);
+    else
+        ++counter;
+}
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
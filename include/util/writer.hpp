@@ -0,0 +1,217 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#ifndef __WRITER_HPP__
+#define __WRITER_HPP__
+
+/**
+ * @file include/util/writer.hpp
+ * @author agent
+ */
+
+#include "types.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/**
+ * Buffered writer for output files.
+ *
+ * Output is appended to a large private buffer, and only handed to the
+ * underlying stream when the buffer fills or flush() is called.  The
+ * append functions do no error checking; write errors are reported by
+ * flush(), as a filewrite exception.  The append functions return the
+ * number of characters appended, as fprintf() would.
+ *
+ * Destroying a Writer writes out any pending output, ignoring errors, so
+ * output up to an exception is not lost.  Callers wanting to know about
+ * write errors must call flush() first.
+ */
+class Writer
+{
+public:
+    /// Default size of the buffer.
+    static const size_t DEFAULT_SIZE = 64 << 10;
+
+    /**
+     * Constructor.  If the buffer can't be allocated, output is passed
+     * straight through to the stream and checked immediately.
+     * @param stream Stream to write to.
+     * @param size Size of the buffer.
+     */
+    Writer(FILE * stream, const size_t size = DEFAULT_SIZE);
+
+    /// Destructor.  Writes pending output, ignoring errors.
+    ~Writer();
+
+    /**
+     * Write pending output to the stream.
+     * @throws filewrite if the stream reports an error.
+     */
+    void flush();
+
+    /**
+     * Flush, and get the underlying stream for writing to directly.
+     * @returns Stream.
+     */
+    FILE * file();
+
+    /**
+     * Append a block of characters.
+     * @param data Characters.
+     * @param len Number of characters.
+     * @returns len
+     */
+    int write(const char * data, const size_t len)
+    {
+        if ( len > this->size - this->used )
+            return this->write_slow(data, len);
+        std::memcpy(&this->buffer[this->used], data, len);
+        this->used += len;
+        return (int)len;
+    }
+
+    /**
+     * Append a string.
+     * @param str Null terminated string.
+     * @returns Length of str.
+     */
+    int puts(const char * str) { return this->write(str, std::strlen(str)); }
+
+    /**
+     * Append a character.
+     * @param c Character.
+     * @returns 1
+     */
+    int putc(const char c)
+    {
+        if ( this->used == this->size )
+            return this->write_slow(&c, 1);
+        this->buffer[this->used++] = c;
+        return 1;
+    }
+
+    /**
+     * Append a number in lower case hex, as per "%0*x".
+     * @param val Value.
+     * @param width Minimum number of digits, zero padded.  At most 16.
+     * @returns Number of characters appended.
+     */
+    int hex(uint64_t val, const unsigned width);
+
+    /**
+     * Append 64bit values, each as per " %016"PRIx64.
+     * @param vals Values.
+     * @param nr Number of values.
+     * @returns Number of characters appended.
+     */
+    int hex_words(const uint64_t * vals, const size_t nr);
+
+    /**
+     * Append 32bit values, each as per " %08"PRIx32.
+     * @param vals Values.
+     * @param nr Number of values.
+     * @returns Number of characters appended.
+     */
+    int hex_words(const uint32_t * vals, const size_t nr);
+
+    /**
+     * Append bytes, each as per "%02x ".
+     * @param data Bytes.
+     * @param nr Number of bytes.
+     * @returns Number of characters appended.
+     */
+    int hex_bytes(const uint8_t * data, const size_t nr);
+
+    /**
+     * Append a number in hex with a 0x prefix, as per "%#x".  Zero is
+     * written as "0".
+     * @param val Value.
+     * @returns Number of characters appended.
+     */
+    int hex_prefixed(const uint64_t val);
+
+    /**
+     * Append a number in decimal, as per "%u".
+     * @param val Value.
+     * @returns Number of characters appended.
+     */
+    int dec(uint64_t val);
+
+    /**
+     * Append a number of spaces.
+     * @param nr Number of spaces.
+     * @returns nr
+     */
+    int pad(size_t nr);
+
+    /**
+     * Append formatted output.  Slower than the other append functions,
+     * so intended for output which is not repeated much.
+     * @param fmt String format, as per printf.
+     * @param ... Extra parameters for printf.
+     * @returns Number of characters appended.
+     */
+    int printf(const char * fmt, ...) __attribute__((format(printf, 2, 3)));
+
+protected:
+    /**
+     * Append data which doesn't fit in the buffer.
+     * @param data Characters.
+     * @param len Number of characters.
+     * @returns len
+     */
+    int write_slow(const char * data, const size_t len);
+
+    /**
+     * Make space at the end of the buffer.
+     * @param len Number of characters.
+     * @returns Pointer to len characters of buffer, or NULL if the buffer
+     * is too small.
+     */
+    char * reserve(const size_t len);
+
+    /// Stream to write to.
+    FILE * stream;
+    /// Pending output.
+    char * buffer;
+    /// Size of buffer.
+    size_t size;
+    /// Amount of buffer in use.
+    size_t used;
+
+private:
+    // @cond EXCLUDE
+    Writer(const Writer &);
+    Writer & operator= (const Writer &);
+    // @endcond
+};
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
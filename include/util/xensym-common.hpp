@@ -29,6 +29,7 @@
 
 #include "types.hpp"
 #include <cstring>
+#include <vector>
 
 /**
  * Macro for declaring a group of related symbols.
@@ -88,13 +89,62 @@ typedef struct xensym
 
 
 /**
- * Insert a symbol or offset from the Xen symbol table into a specific xensym list.
+ * Hashed index of the names in one or more xensym lists.
  *
- * @param xensyms Null terminated list of xensym containers.
- * @param name Symbol or offset name.
- * @param value Value or address of symbol or offset.
+ * Looking a name up costs a single hash probe, rather than a strcmp()
+ * against every entry of every list.  A name present in several lists
+ * has an entry for each, kept in the order the lists were added.
  */
-void insert_xensym(const xensym_t * xensyms, const char * name, vaddr_t & value);
+class XensymIndex
+{
+public:
+    /// Constructor.
+    XensymIndex();
+
+    /**
+     * Add the entries of a xensym list to the index.
+     * May throw std::bad_alloc.
+     * @param xensyms Null terminated list of xensym containers.
+     */
+    void add(const xensym_t * xensyms);
+
+    /**
+     * Insert a symbol or offset from the Xen symbol table into every
+     * indexed list which contains it.  A name repeated within one list
+     * only fills its first entry.
+     *
+     * @param name Symbol or offset name.
+     * @param value Value or address of symbol or offset.
+     * @returns boolean indicating whether name is in any list.
+     */
+    bool insert(const char * name, vaddr_t & value) const;
+
+protected:
+    /// Entry in the index.
+    struct Slot
+    {
+        /// Hash of the name.
+        uint64_t hash;
+        /// List the entry came from.
+        const xensym_t * list;
+        /// Xensym, or NULL if the slot is empty.
+        const xensym_t * sym;
+    };
+
+    /**
+     * Place an entry in the index, which must have space for it.
+     * @param list List the entry came from.
+     * @param sym Xensym.
+     */
+    void place(const xensym_t * list, const xensym_t * sym);
+
+    /// Lists in the index, in the order they were added.
+    std::vector<const xensym_t *> lists;
+    /// Slots, a power of two in size and at most a quarter full.
+    std::vector<Slot> slots;
+    /// Number of used slots.
+    size_t nr_entries;
+};
 
 /**
  * Check whether all group xensyms are present.
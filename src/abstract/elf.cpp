@@ -30,6 +30,7 @@
 #include "util/macros.hpp"
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
 #include <elf.h>
@@ -41,7 +42,7 @@ namespace Abstract
         arch(Elf::ELF_Unknown),
         nr_phdrs(0), phdrs(NULL),
         notedata(NULL), nr_notes(0), notes(NULL),
-        nr_cpus(0), fd(fd)
+        nr_cpus(0), fd(fd), notemap(NULL), notemap_size(0)
     {}
 
     Elf::~Elf()
@@ -53,7 +54,15 @@ namespace Abstract
         // Note entries pointers point into this->notedata,
         // so don't explicitly delete.
         SAFE_DELETE_ARRAY(this->notes);
-        SAFE_DELETE_ARRAY(this->notedata);
+        if ( this->notemap )
+        {
+            if ( munmap(this->notemap, this->notemap_size) == -1 )
+                LOG_ERROR("Failed to unmap crash file notes: %s\n", strerror(errno));
+            this->notemap = NULL;
+            this->notedata = NULL;
+        }
+        else
+            SAFE_DELETE_ARRAY(this->notedata);
 
         SAFE_DELETE_ARRAY(this->phdrs);
     }
@@ -0,0 +1,142 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/abstract/pagetable.cpp
+ * @author agent
+ */
+
+#include "abstract/pagetable.hpp"
+
+#include "util/log.hpp"
+#include "util/macros.hpp"
+
+#include <new>
+
+namespace Abstract
+{
+    const size_t PageTable::DEFAULT_TLB_SIZE;
+    size_t PageTable::tlb_size = PageTable::DEFAULT_TLB_SIZE;
+    uint64_t PageTable::tlb_hits = 0;
+    uint64_t PageTable::tlb_misses = 0;
+
+    PageTable::PageTable():
+        tlb(NULL), tlb_small(0), tlb_large(0), tlb_lock()
+    {}
+
+    PageTable::~PageTable()
+    {
+        SAFE_DELETE_ARRAY(this->tlb);
+    }
+
+    void PageTable::walk(const vaddr_t & vaddr, maddr_t & maddr,
+                         vaddr_t * page_end) const
+    {
+        TLBEntry * small = NULL, * large = NULL, * e;
+        maddr_t base;
+        uint64_t size;
+
+        this->validate_vaddr(vaddr);
+
+        {
+            MutexLock guard(this->tlb_lock);
+
+            if ( ! this->tlb && tlb_size )
+            {
+                size_t nr = 1;
+                while ( nr < tlb_size )
+                    nr <<= 1;
+
+                // If we can't allocate the cache, walk uncached.
+                this->tlb = new (std::nothrow) TLBEntry[nr + (nr > 4 ? nr / 4 : 1)];
+                if ( this->tlb )
+                {
+                    this->tlb_small = nr;
+                    this->tlb_large = nr > 4 ? nr / 4 : 1;
+                    for ( size_t x = 0; x < this->tlb_small + this->tlb_large; ++x )
+                        this->tlb[x].mask = 0;
+                }
+            }
+
+            if ( this->tlb )
+            {
+                /* 4K pages are indexed by 4K frame, superpages by 2M frame.  A 1G
+                 * or 512G superpage may therefore occupy several entries. */
+                small = &this->tlb[(vaddr >> 12) & (this->tlb_small - 1)];
+                large = &this->tlb[this->tlb_small + ((vaddr >> 21) & (this->tlb_large - 1))];
+
+                if ( small->mask && (vaddr & ~small->mask) == small->vbase )
+                    e = small;
+                else if ( large->mask && (vaddr & ~large->mask) == large->vbase )
+                    e = large;
+                else
+                    e = NULL;
+
+                if ( e )
+                {
+                    count_event(tlb_hits);
+                    maddr = e->mbase | (vaddr & e->mask);
+                    if ( page_end )
+                        *page_end = vaddr | e->mask;
+                    return;
+                }
+            }
+        }
+
+        count_event(tlb_misses);
+        this->walk_uncached(vaddr, base, size);
+
+        maddr = base | (vaddr & (size - 1));
+        if ( page_end )
+            *page_end = vaddr | (size - 1);
+
+        // small and large are only set if this walk found the cache allocated.
+        if ( small )
+        {
+            MutexLock guard(this->tlb_lock);
+
+            e = size == 0x1000 ? small : large;
+            e->vbase = vaddr & ~(size - 1);
+            e->mbase = base;
+            e->mask = size - 1;
+        }
+    }
+
+    void PageTable::set_tlb_size(const size_t entries)
+    {
+        tlb_size = entries;
+    }
+
+    void PageTable::log_stats()
+    {
+        LOG_INFO("Pagetable walk cache: %"PRIu64" hits, %"PRIu64" misses\n",
+                 tlb_hits, tlb_misses);
+    }
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
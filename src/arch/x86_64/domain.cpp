@@ -29,7 +29,6 @@
 #include "util/log.hpp"
 #include "util/macros.hpp"
 #include "util/symbol.hpp"
-#include "util/stdio-wrapper.hpp"
 
 /**
  * @file src/arch/x86_64/domain.cpp
@@ -71,29 +70,36 @@ namespace x86_64
             host.validate_xen_vaddr(domain_ptr);
             this->domain_ptr = domain_ptr;
 
-            memory.read16_vaddr(this->xenpt, this->domain_ptr + DOMAIN_id, this->domain_id);
+            MemSnapshot dom;
+            dom.read(this->xenpt, this->domain_ptr, DOMAIN_sizeof);
 
-            memory.read8_vaddr (this->xenpt, this->domain_ptr + DOMAIN_is_32bit_pv, this->is_32bit_pv);
-            memory.read8_vaddr (this->xenpt, this->domain_ptr + DOMAIN_is_hvm, this->is_hvm);
-            memory.read8_vaddr (this->xenpt, this->domain_ptr + DOMAIN_is_privileged, this->is_privileged);
+            dom.get(DOMAIN_id, this->domain_id);
 
-            memory.read32_vaddr(this->xenpt, this->domain_ptr + DOMAIN_max_vcpus, this->max_cpus);
-            memory.read64_vaddr(this->xenpt, this->domain_ptr + DOMAIN_vcpus, this->vcpus_ptr);
+            dom.get(DOMAIN_is_32bit_pv, this->is_32bit_pv);
+            dom.get(DOMAIN_is_hvm, this->is_hvm);
+            dom.get(DOMAIN_is_privileged, this->is_privileged);
 
-            memory.read32_vaddr(this->xenpt, this->domain_ptr + DOMAIN_paging_mode, this->paging_mode);
-            memory.read32_vaddr(this->xenpt, this->domain_ptr + DOMAIN_tot_pages, this->tot_pages);
-            memory.read32_vaddr(this->xenpt, this->domain_ptr + DOMAIN_max_pages, this->max_pages);
-            memory.read32_vaddr(this->xenpt, this->domain_ptr + DOMAIN_shr_pages, (uint32_t&)this->shr_pages);
+            dom.get(DOMAIN_max_vcpus, this->max_cpus);
+            dom.get(DOMAIN_vcpus, this->vcpus_ptr);
 
-            memory.read32_vaddr(this->xenpt, this->domain_ptr + DOMAIN_pause_count, this->pause_count);
+            dom.get(DOMAIN_paging_mode, this->paging_mode);
+            dom.get(DOMAIN_tot_pages, this->tot_pages);
+            dom.get(DOMAIN_max_pages, this->max_pages);
+            dom.get(DOMAIN_shr_pages, this->shr_pages);
 
-            memory.read_block_vaddr(this->xenpt, this->domain_ptr + DOMAIN_handle,
-                                    (char*)this->handle, sizeof this->handle);
+            dom.get(DOMAIN_pause_count, this->pause_count);
 
-            memory.read64_vaddr(this->xenpt, this->domain_ptr + DOMAIN_next, this->next_domain_ptr);
+            dom.get(DOMAIN_handle, this->handle);
+
+            dom.get(DOMAIN_next, this->next_domain_ptr);
 
             return true;
         }
+        catch ( const std::bad_alloc & )
+        {
+            LOG_ERROR("Bad alloc of %"PRIu64" bytes for parsing domain structure "
+                      "at 0x%016"PRIx64"\n", DOMAIN_sizeof, domain_ptr);
+        }
         catch ( const CommonError & e )
         {
             e.log();
@@ -184,6 +190,7 @@ namespace x86_64
                     strncpy(tmp.vmcoreinfoName(), "VMCOREINFO", 10);
                     memory.read_block_vaddr(dompt, note_sym->address+24,
                             tmp.vmcoreinfoData(), note_data_len);
+                    tmp.build_index();
                     dest.transferOwnershipFrom(tmp);
                 }
             }
@@ -200,63 +207,63 @@ namespace x86_64
         return false;
     }
 
-    int Domain::print_vmcoreinfo(FILE * o, CoreInfo & info) const
+    int Domain::print_vmcoreinfo(Writer & o, CoreInfo & info) const
     {
         int len(0);
         if ( info.vmcoreinfoData() )
-            len += FPRINTF(o, "VMCOREINFO:\n%s\n", info.vmcoreinfoData());
+            len += o.printf("VMCOREINFO:\n%s\n", info.vmcoreinfoData());
         return len;
     }
 
-    int Domain::print_state(FILE * o) const
+    int Domain::print_state(Writer & o) const
     {
         int len = 0;
 
-        len += FPRINTF(o, "Domain %"PRIu16": (%d vcpus)\n", this->domain_id, this->max_cpus);
+        len += o.printf("Domain %"PRIu16": (%d vcpus)\n", this->domain_id, this->max_cpus);
 
-        len += FPUTS("  Flags:", o);
+        len += o.puts("  Flags:");
 
         if ( this->is_privileged )
-            len += FPUTS(" PRIVILEGED", o);
+            len += o.puts(" PRIVILEGED");
 
         if ( this->is_32bit_pv )
-            len += FPUTS(" 32BIT-PV", o);
+            len += o.puts(" 32BIT-PV");
 
         if ( this->is_hvm )
-            len += FPUTS(" HVM", o);
+            len += o.puts(" HVM");
 
         if ( this->pause_count )
-            len += FPRINTF(o, " PAUSED(count %"PRId32")", this->pause_count);
+            len += o.printf(" PAUSED(count %"PRId32")", this->pause_count);
         else
-            len += FPUTS(" UNPAUSED", o);
+            len += o.puts(" UNPAUSED");
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
-        len += FPUTS("  Paging assistance: ", o);
+        len += o.puts("  Paging assistance: ");
         len += print_paging_mode(o, this->paging_mode);
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
 ///@cond EXCLUDE
 #define PAGES_TO_GB(p) (((double)(p)) * 4096.0 / (1024.0 * 1024.0 * 1024.0))
 #define PAGES_TO_MB(p) (((double)(p)) * 4096.0 / (1024.0 * 1024.0))
 #define PAGES_TO_KB(p) (((double)(p)) * 4096.0 / (1024.0))
 
-        len += FPRINTF(o, "  Max Pages: %"PRIu32" (%.3fGB, %.3fMB, %.fKB)\n",
-                       this->max_pages, PAGES_TO_GB(this->max_pages),
-                       PAGES_TO_MB(this->max_pages), PAGES_TO_KB(this->max_pages));
-        len += FPRINTF(o, "  Current Pages: %"PRIu32"\n", this->tot_pages);
-        len += FPRINTF(o, "  Shared Pages: %"PRId32"\n", this->shr_pages);
+        len += o.printf("  Max Pages: %"PRIu32" (%.3fGB, %.3fMB, %.fKB)\n",
+                        this->max_pages, PAGES_TO_GB(this->max_pages),
+                        PAGES_TO_MB(this->max_pages), PAGES_TO_KB(this->max_pages));
+        len += o.printf("  Current Pages: %"PRIu32"\n", this->tot_pages);
+        len += o.printf("  Shared Pages: %"PRId32"\n", this->shr_pages);
 
-        len += FPRINTF(o, "  Handle: %02"PRIx8"%02"PRIx8"%02"PRIx8"%02"PRIx8"-%02"PRIx8
-                       "%02"PRIx8"-%02"PRIx8"%02"PRIx8"-""%02"PRIx8"%02"PRIx8"-%02"PRIx8
-                       "%02"PRIx8"%02"PRIx8"%02"PRIx8"%02"PRIx8"%02"PRIx8"\n",
-                       this->handle[ 0], this->handle[ 1], this->handle[ 2], this->handle[ 3],
-                       this->handle[ 4], this->handle[ 5], this->handle[ 6], this->handle[ 7],
-                       this->handle[ 8], this->handle[ 9], this->handle[10], this->handle[11],
-                       this->handle[12], this->handle[13], this->handle[14], this->handle[15] );
+        len += o.printf("  Handle: %02"PRIx8"%02"PRIx8"%02"PRIx8"%02"PRIx8"-%02"PRIx8
+                        "%02"PRIx8"-%02"PRIx8"%02"PRIx8"-""%02"PRIx8"%02"PRIx8"-%02"PRIx8
+                        "%02"PRIx8"%02"PRIx8"%02"PRIx8"%02"PRIx8"%02"PRIx8"\n",
+                        this->handle[ 0], this->handle[ 1], this->handle[ 2], this->handle[ 3],
+                        this->handle[ 4], this->handle[ 5], this->handle[ 6], this->handle[ 7],
+                        this->handle[ 8], this->handle[ 9], this->handle[10], this->handle[11],
+                        this->handle[12], this->handle[13], this->handle[14], this->handle[15] );
 
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         CoreInfo vmcoreinfo;
         if ( this->domain_id == 0 )
@@ -269,18 +276,18 @@ namespace x86_64
         for ( uint32_t x = 0; x < this->max_cpus; ++ x )
             if ( this->vcpus[x] )
             {
-                len += FPRINTF(o, "  VCPU%"PRIu32":\n", this->vcpus[x]->vcpu_id);
+                len += o.printf("  VCPU%"PRIu32":\n", this->vcpus[x]->vcpu_id);
                 len += this->vcpus[x]->print_state(o);
             }
             else
-                len += FPRINTF(o, "No information for vcpu%"PRIu32"\n", x);
+                len += o.printf("No information for vcpu%"PRIu32"\n", x);
 
-        len += FPUTS("\n  Console Ring:\n", o);
+        len += o.puts("\n  Console Ring:\n");
 
         if ( this->domain_id == 0 )
             this->print_console(o, vmcoreinfo);
         else
-            len += FPUTS("    No Symbol Table\n", o);
+            len += o.puts("    No Symbol Table\n");
 
 #undef PAGES_TO_KB
 #undef PAGES_TO_MB
@@ -289,31 +296,31 @@ namespace x86_64
         return len;
     }
 
-    int Domain::dump_structures(FILE * o) const
+    int Domain::dump_structures(Writer & o) const
     {
         int len = 0;
 
         if ( ! REQ_CORE_XENSYMS(domain) )
             return len;
 
-        len += FPRINTF(o, "Xen structures for Domain %"PRId16"\n\n", this->domain_id);
+        len += o.printf("Xen structures for Domain %"PRId16"\n\n", this->domain_id);
 
-        len += FPRINTF(o, "struct domain (0x%016"PRIx64")\n", this->domain_ptr);
+        len += o.printf("struct domain (0x%016"PRIx64")\n", this->domain_ptr);
         len += dump_64bit_data(o, this->xenpt, this->domain_ptr, DOMAIN_sizeof);
 
         for ( uint32_t x = 0; x < this->max_cpus; ++x )
             if ( this->vcpus[x] )
             {
-                len += FPUTS("\n", o);
+                len += o.puts("\n");
                 len += this->vcpus[x]->dump_structures(o, this->xenpt);
             }
             else
-                len += FPRINTF(o, "Nothing to dump for vcpu%"PRIu32"\n\n", x);
+                len += o.printf("Nothing to dump for vcpu%"PRIu32"\n\n", x);
 
         return len;
     }
 
-    int Domain::print_console(FILE * o, CoreInfo& info) const
+    int Domain::print_console(Writer & o, CoreInfo& info) const
     {
         int len = 0;
 
@@ -342,11 +349,11 @@ namespace x86_64
 
             if ( len == 0 )
             {
-                len += FPUTS("\tUnavailable, the following symbols are not available:\n", o);
-                len += FPRINTF(o, "  %s%s%s.\n\n",
-                               log_end_sym     == NULL ? " log_end"     : "",
-                               log_buf_sym     == NULL ? " log_buf"     : "",
-                               log_buf_len_sym == NULL ? " log_buf_len" : "");
+                len += o.puts("\tUnavailable, the following symbols are not available:\n");
+                len += o.printf("  %s%s%s.\n\n",
+                                log_end_sym     == NULL ? " log_end"     : "",
+                                log_buf_sym     == NULL ? " log_buf"     : "",
+                                log_buf_len_sym == NULL ? " log_buf_len" : "");
             }
             return len;
         }
@@ -371,8 +378,8 @@ namespace x86_64
 
             if ( length > (1<<21) )
             {
-                len += FPRINTF(o, "\tLength of 0x%"PRIx64" looks abnormally long.  Truncating to"
-                               "0x%x.\n", length, 1<<16);
+                len += o.printf("\tLength of 0x%"PRIx64" looks abnormally long.  Truncating to"
+                                "0x%x.\n", length, 1<<16);
                 length = 1<<16;
             }
 
@@ -388,7 +395,7 @@ namespace x86_64
         return len;
     }
 
-    int Domain::print_console_3x(FILE * o, CoreInfo& info) const
+    int Domain::print_console_3x(Writer & o, CoreInfo& info) const
     {
         int len(0);
         vaddr_t log_buf_addr_addr, log_buf_len_addr;
@@ -437,7 +444,7 @@ namespace x86_64
         return len;
     }
 
-    int Domain::print_cmdline(FILE * o) const
+    int Domain::print_cmdline(Writer & o) const
     {
         int len = 0;
         char * cmdline = NULL;
@@ -448,7 +455,7 @@ namespace x86_64
 
         const Symbol * cmdline_sym = host.dom0_symtab.find("saved_command_line");
         if ( ! cmdline_sym )
-            len += FPUTS("Missing symbol for command line\n", o);
+            len += o.puts("Missing symbol for command line\n");
         else
         {
             try
@@ -465,7 +472,7 @@ namespace x86_64
                     memory.read64_vaddr(dompt, cmdline_sym->address, cmdline_vaddr.val64);
 
                 memory.read_str_vaddr(dompt, cmdline_vaddr.val64, cmdline, 2047);
-                len += FPRINTF(o, "  Command line: %s\n", cmdline);
+                len += o.printf("  Command line: %s\n", cmdline);
 
                 SAFE_DELETE_ARRAY(cmdline);
             }
@@ -479,7 +486,7 @@ namespace x86_64
             }
         }
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
         SAFE_DELETE_ARRAY(cmdline);
         return len;
     }
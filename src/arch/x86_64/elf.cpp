@@ -37,15 +37,54 @@
 /// @endcond
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <errno.h>
 #include <limits.h>
 #include <new>
+#include <vector>
+#include <algorithm>
 
 /// Round n up to the nearest 4
 #define round_up(n) (((n)+3)&~3)
 
+/**
+ * Read an exact number of bytes from a file offset, retrying short reads.
+ * @param fd File descriptor.
+ * @param buf Buffer to read into.
+ * @param size Number of bytes to read.
+ * @param offset File offset to read from.
+ * @returns Number of bytes read, which is only less than size at the end
+ * of the file, or -1 with errno set.
+ */
+static ssize_t read_at(int fd, void * buf, size_t size, off64_t offset)
+{
+    char * ptr = static_cast<char *>(buf);
+    size_t done = 0;
+    ssize_t r;
+
+    while ( done < size )
+    {
+        r = pread64(fd, ptr + done, size - done, offset + done);
+
+        if ( r == -1 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return -1;
+        }
+
+        if ( r == 0 )
+            break;
+
+        done += r;
+    }
+
+    return done;
+}
+
 namespace x86_64
 {
 
@@ -56,14 +95,9 @@ namespace x86_64
     {
         Elf64_Ehdr ehdr;
         ssize_t r;
+        uint32_t phnum;
 
-        if ( (-(off64_t)1) == lseek64(this->fd, 0, SEEK_SET) )
-        {
-            LOG_ERROR("  Failed to seek back to the beginning: %s\n", strerror(errno));
-            return false;
-        }
-
-        if ( (r = read(this->fd, &ehdr, sizeof ehdr)) == -1 )
+        if ( (r = read_at(this->fd, &ehdr, sizeof ehdr, 0)) == -1 )
         {
             LOG_ERROR("  Failed to read elf ehdr: %s\n", strerror(errno));
             return false;
@@ -86,16 +120,53 @@ namespace x86_64
         LOG_DEBUG("  Found %"PRIu16" section headers of size %"PRIu16" bytes at offset %"PRIx64"\n",
                   ehdr.e_shnum, ehdr.e_shentsize, ehdr.e_shoff);
 
-        LOG_DEBUG("  Found %"PRIu16" program headers of size %"PRIu16" bytes at offset %#"PRIx64"\n",
-                  ehdr.e_phnum, ehdr.e_phentsize, ehdr.e_phoff);
+        phnum = ehdr.e_phnum;
 
-        if ( ehdr.e_phnum < 2 )
+        /* With more than PN_XNUM - 1 program headers, e_phnum holds PN_XNUM
+         * and the real count lives in sh_info of section header 0. */
+        if ( phnum == PN_XNUM )
+        {
+            Elf64_Shdr shdr;
+
+            if ( ehdr.e_shoff == 0 || ehdr.e_shentsize != sizeof shdr )
+            {
+                LOG_ERROR("  Extended program header count, but no usable section header 0\n");
+                return false;
+            }
+
+            if ( (r = read_at(this->fd, &shdr, sizeof shdr, ehdr.e_shoff)) == -1 )
+            {
+                LOG_ERROR("  Failed to read section header 0: %s\n", strerror(errno));
+                return false;
+            }
+
+            if ( r != sizeof shdr )
+            {
+                LOG_ERROR("  Failed to read all of section header 0.  Read %zu bytes instead of %zu\n",
+                          r, sizeof shdr);
+                return false;
+            }
+
+            phnum = shdr.sh_info;
+            LOG_DEBUG("  Extended program header count of %"PRIu32"\n", phnum);
+        }
+
+        LOG_DEBUG("  Found %"PRIu32" program headers of size %"PRIu16" bytes at offset %#"PRIx64"\n",
+                  phnum, ehdr.e_phentsize, ehdr.e_phoff);
+
+        if ( phnum < 2 )
         {
             LOG_ERROR("  Expected at least 2 program headers for a crash file\n");
             return false;
         }
 
-        this->nr_phdrs = ehdr.e_phnum;
+        if ( phnum > INT_MAX )
+        {
+            LOG_ERROR("  Too many program headers (%"PRIu32")\n", phnum);
+            return false;
+        }
+
+        this->nr_phdrs = phnum;
         try
         {
             this->phdrs = new ElfProgHdr[this->nr_phdrs];
@@ -153,50 +224,61 @@ namespace x86_64
 
     bool Elf::parse_phdrs(const Elf64_Half & size, const Elf64_Off & offset)
     {
-        Elf64_Phdr phdr;
+        Elf64_Phdr * table = NULL;
+        size_t table_size = this->nr_phdrs * sizeof *table;
         ssize_t r;
 
-        if ( sizeof phdr != size )
+        if ( sizeof *table != size )
         {
             LOG_ERROR("  Mismatch for program header size.  Expected %zu, got %"PRIu16"\n",
-                      sizeof phdr, size);
+                      sizeof *table, size);
             return false;
         }
 
-        if ( (-(off64_t)1) == lseek64(this->fd, offset, SEEK_SET) )
+        try
         {
-            LOG_ERROR("  Failed to seek to the program headers: %s\n", strerror(errno));
+            table = new Elf64_Phdr[this->nr_phdrs];
+        }
+        catch ( const std::bad_alloc & )
+        {
+            LOG_ERROR("Bad Alloc exception.  Out of memory\n");
             return false;
         }
 
-        for ( int x = 0; x < this->nr_phdrs; ++x )
+        // Read the entire table at once; large hosts have thousands of entries.
+        if ( (r = read_at(this->fd, table, table_size, offset)) == -1 )
         {
-            if ( (r = read(this->fd, &phdr, sizeof phdr)) == -1 )
-            {
-                LOG_ERROR("  Failed to read elf phdr: %s\n", strerror(errno));
-                return false;
-            }
+            LOG_ERROR("  Failed to read elf phdrs: %s\n", strerror(errno));
+            SAFE_DELETE_ARRAY(table);
+            return false;
+        }
 
-            if ( r != sizeof phdr )
-            {
-                LOG_ERROR("  Failed to read all of the program header.  Read %zu bytes instead of %zu\n",
-                          r, sizeof phdr);
-                return false;
-            }
+        if ( (size_t)r != table_size )
+        {
+            LOG_ERROR("  Failed to read all of the program headers.  Read %zu bytes instead of %zu\n",
+                      r, table_size);
+            SAFE_DELETE_ARRAY(table);
+            return false;
+        }
 
-            this->phdrs[x].type   = phdr.p_type;
-            this->phdrs[x].offset = phdr.p_offset;
-            this->phdrs[x].phys   = phdr.p_paddr;
-            this->phdrs[x].size   = phdr.p_filesz;
+        for ( int x = 0; x < this->nr_phdrs; ++x )
+        {
+            this->phdrs[x].type   = table[x].p_type;
+            this->phdrs[x].offset = table[x].p_offset;
+            this->phdrs[x].phys   = table[x].p_paddr;
+            this->phdrs[x].size   = table[x].p_filesz;
         }
 
+        SAFE_DELETE_ARRAY(table);
         return true;
     }
 
     bool Elf::parse_nhdrs(const ElfProgHdr & hdr)
     {
-        Elf64_Nhdr * nhdr;
-        ssize_t r, size;
+        const Elf64_Nhdr * nhdr;
+        struct stat64 st;
+        size_t size;
+        ssize_t r;
 
         if ( hdr.type != PT_NOTE )
         {
@@ -206,91 +288,91 @@ namespace x86_64
 
         if ( hdr.size > SSIZE_MAX )
         {
-            LOG_ERROR("  Note header size %"PRIu64" greater than SSIZE_MAX\n");
+            LOG_ERROR("  Note header size %"PRIu64" greater than SSIZE_MAX\n", hdr.size);
             return false;
         }
 
-        size = (ssize_t)hdr.size;
+        size = (size_t)hdr.size;
 
-        if ( (-(off64_t)1) == lseek64(this->fd, hdr.offset, SEEK_SET) )
+        /* Map the notes rather than copying them, but only if they lie
+         * within a regular file; mapping beyond the end risks SIGBUS. */
+        if ( size && fstat64(this->fd, &st) == 0 && S_ISREG(st.st_mode) &&
+             hdr.offset <= (uint64_t)st.st_size &&
+             size <= (uint64_t)st.st_size - hdr.offset )
         {
-            LOG_ERROR("  Failed to seek to the note header: %s\n", strerror(errno));
-            return false;
-        }
+            long page_size = sysconf(_SC_PAGESIZE);
+            uint64_t skew = hdr.offset & (page_size - 1);
+            void * map = mmap(NULL, size + skew, PROT_READ, MAP_PRIVATE,
+                              this->fd, hdr.offset - skew);
 
-        try
-        {
-            this->notedata = new char[size];
-        }
-        catch ( const std::bad_alloc & )
-        {
-            LOG_ERROR("Bad Alloc exception.  Out of memory\n");
-            return false;
-        }
-
-        if ( (r = read(this->fd, this->notedata, size)) == -1 )
-        {
-            LOG_ERROR("  Failed to read elf notes: %s\n", strerror(errno));
-            return false;
+            if ( map != MAP_FAILED )
+            {
+                this->notemap = static_cast<char *>(map);
+                this->notemap_size = size + skew;
+                this->notedata = this->notemap + skew;
+            }
+            else
+                LOG_DEBUG("  Failed to map elf notes: %s.  Reading instead\n",
+                          strerror(errno));
         }
 
-        if ( r != size )
+        if ( ! this->notemap )
         {
-            LOG_ERROR("  Failed to read all of the notes.  Read %zu bytes instead of %zd\n",
-                      r, size);
-            return false;
-        }
-
-
-        ssize_t index = 0;
-
-        do
-        {
-            nhdr = (Elf64_Nhdr*)&this->notedata[index];
-            ++this->nr_notes;
-            index += sizeof *nhdr + round_up(nhdr->n_namesz) + round_up(nhdr->n_descsz);
+            try
+            {
+                this->notedata = new char[size];
+            }
+            catch ( const std::bad_alloc & )
+            {
+                LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+                return false;
+            }
 
-        } while ( index < size && index >= 0 );
+            if ( (r = read_at(this->fd, this->notedata, size, hdr.offset)) == -1 )
+            {
+                LOG_ERROR("  Failed to read elf notes: %s\n", strerror(errno));
+                return false;
+            }
 
-        if ( this->nr_notes < 3 )
-        {
-            LOG_ERROR("  Expected at least 3 notes.  Got %zu\n", this->nr_notes);
-            return false;
+            if ( (size_t)r != size )
+            {
+                LOG_ERROR("  Failed to read all of the notes.  Read %zu bytes instead of %zu\n",
+                          r, size);
+                return false;
+            }
         }
 
-        try
-        {
-            this->notes = new ElfNote[this->nr_notes];
-        }
-        catch ( const std::bad_alloc & )
-        {
-            LOG_ERROR("Bad Alloc exception.  Out of memory\n");
-            return false;
-        }
+        std::vector<ElfNote> found;
+        int pt_count = 0, xen_core_count = 0, xen_info_count = 0;
+        size_t index = 0;
 
-        index = 0;
-        int noteindex = 0;
+        found.reserve(16);
 
-        do
+        // Single pass, checking that each note lies within the segment.
+        while ( size - index >= sizeof *nhdr )
         {
-            nhdr = (Elf64_Nhdr*)&this->notedata[index];
+            ElfNote note;
+            size_t name_off, desc_off;
 
-            this->notes[noteindex].name_size = nhdr->n_namesz;
-            this->notes[noteindex].desc_size = nhdr->n_descsz;
-            this->notes[noteindex].type = nhdr->n_type;
-            this->notes[noteindex].name =
-                &this->notedata[index + sizeof *nhdr];
-            this->notes[noteindex].desc =
-                &this->notedata[index + sizeof *nhdr + round_up(nhdr->n_namesz)];
+            nhdr = (const Elf64_Nhdr*)&this->notedata[index];
+            name_off = index + sizeof *nhdr;
+            desc_off = name_off + round_up((size_t)nhdr->n_namesz);
 
-            index += sizeof *nhdr + round_up(nhdr->n_namesz) + round_up(nhdr->n_descsz);
-            ++noteindex;
+            if ( desc_off > size || round_up((size_t)nhdr->n_descsz) > size - desc_off )
+            {
+                LOG_ERROR("  Note %zu at offset %#zx overruns the note segment\n",
+                          found.size(), index);
+                return false;
+            }
 
-        } while ( noteindex < this->nr_notes );
+            note.name_size = nhdr->n_namesz;
+            note.desc_size = nhdr->n_descsz;
+            note.type = nhdr->n_type;
+            note.name = &this->notedata[name_off];
+            note.desc = &this->notedata[desc_off];
+            found.push_back(note);
 
-        int pt_count = 0, xen_core_count = 0, xen_info_count = 0;
-        for ( int x = 0; x < this->nr_notes; ++x )
-            switch ( this->notes[x].type )
+            switch ( note.type )
             {
             case NT_PRSTATUS:
                 ++pt_count;
@@ -305,6 +387,29 @@ namespace x86_64
                 break;
             }
 
+            index = desc_off + round_up((size_t)nhdr->n_descsz);
+        }
+
+        if ( found.size() < 3 )
+        {
+            LOG_ERROR("  Expected at least 3 notes.  Got %zu\n", found.size());
+            return false;
+        }
+
+        this->nr_notes = found.size();
+
+        try
+        {
+            this->notes = new ElfNote[this->nr_notes];
+        }
+        catch ( const std::bad_alloc & )
+        {
+            LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+            return false;
+        }
+
+        std::copy(found.begin(), found.end(), this->notes);
+
         if ( xen_info_count != 1 )
         {
             LOG_ERROR("  Expected 1 CrashXenInfo note, not %d\n", xen_info_count);
@@ -26,8 +26,12 @@
 #include "arch/x86_64/pagetable-walk.hpp"
 
 #include "util/log.hpp"
+#include "util/frame-cache.hpp"
+#include "util/worker-pool.hpp"
 #include "memory.hpp"
 
+#include <cstring>
+
 /// Is the present bit set for a pagetable entry
 #define present(v)     ((v) & 1)
 /// Is the page size bit set for a pagetable entry
@@ -42,26 +46,90 @@
 /// Calculate entry offset into the PT based on a virtual address
 #define pt_offset(v)   (((v >> 12) & ((1<<9)-1)) * 8)
 
-/// Calculate offset into a 4K page given a base physical address and virtual address
-#define offset_4K(b, v)   ((b) | ((v) & ((1ULL<<12)-1)))
-/// Calculate offset into a 2M superpage given a base physical address and virtual address
-#define offset_2M(b, v)   ((b) | ((v) & ((1ULL<<21)-1)))
-/// Calculate offset into a 1G superpage given a base physical address and virtual address
-#define offset_1G(b, v)   ((b) | ((v) & ((1ULL<<30)-1)))
-/// Calculate offset into a 512G superpage given a base physical address and virtual address
-#define offset_512G(b, v) ((b) | ((v) & ((1ULL<<39)-1)))
-
-/// Round an address up to the last byte in a 4K page
-#define roundup_4K(v)   ((v) | ((1ULL<<12)-1))
-/// Round an address up to the last byte in a 2M superpage
-#define roundup_2M(v)   ((v) | ((1ULL<<21)-1))
-/// Round an address up to the last byte in a 1G superpage
-#define roundup_1G(v)   ((v) | ((1ULL<<30)-1))
-/// Round an address up to the last byte in a 512G superpage
-#define roundup_512G(v) ((v) | ((1ULL<<39)-1))
+/// Size of a 4K page
+#define size_4K   (1ULL<<12)
+/// Size of a 2M superpage
+#define size_2M   (1ULL<<21)
+/// Size of a 1G superpage
+#define size_1G   (1ULL<<30)
+/// Size of a 512G superpage
+#define size_512G (1ULL<<39)
+
+/// Cache of pagetable pages, shared between walks from every cr3.
+static FrameCache table_cache;
+/// Size of table_cache in frames, allocated when first needed.
+static size_t table_cache_frames = 0;
+/// Protects table_cache and table_cache_frames.
+static Mutex table_lock;
+
+void pagetable_walk_64_set_cache_size(const size_t size)
+{
+    table_cache_frames = size / FrameCache::FRAME_SIZE;
+}
+
+void pagetable_walk_64_log_stats()
+{
+    table_cache.log_stats("Pagetable page cache");
+}
+
+/**
+ * Read a pagetable entry.
+ * Entries are read from the mapped core if possible, or from the shared
+ * cache of pagetable pages.  Pages which can't be read whole fall back to
+ * a plain read of the entry, which throws the appropriate error.
+ * @param table Machine address of the pagetable page.
+ * @param offset Byte offset of the entry into the page.
+ * @param entry Pagetable entry result.
+ */
+static void read_entry(const maddr_t & table, const uint64_t offset, uint64_t & entry)
+{
+    const char * page = memory.mapped_frame(table);
+
+    if ( page )
+    {
+        std::memcpy(&entry, page + offset, sizeof entry);
+        return;
+    }
+
+    {
+        MutexLock guard(table_lock);
+
+        // Only allocate the cache once a pagetable page is found to be unmapped.
+        if ( table_cache_frames && ! table_cache.nr_frames )
+        {
+            if ( ! table_cache.init(table_cache_frames) )
+                LOG_WARN("Unable to allocate pagetable page cache.  Continuing without\n");
+            table_cache_frames = 0;
+        }
+
+        if ( table_cache.nr_frames )
+        {
+            const uint64_t mfn = table / FrameCache::FRAME_SIZE;
+
+            if ( ! (page = table_cache.lookup(mfn)) )
+            {
+                char * fill = table_cache.insert(mfn);
+
+                if ( memory.read_frame(table, fill) )
+                    page = fill;
+                else
+                    table_cache.invalidate(mfn);
+            }
+        }
+
+        // Copy while holding the lock, as the page may be evicted at any time.
+        if ( page )
+        {
+            std::memcpy(&entry, page + offset, sizeof entry);
+            return;
+        }
+    }
+
+    memory.read64(table + offset, entry);
+}
 
 void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
-                       maddr_t & maddr, vaddr_t * page_end)
+                       maddr_t & base, uint64_t & size)
 {
     // cr3 has the pml4 physical address between bits 51 and 12
     // each page entry contain the next physical address between the same bits
@@ -78,8 +146,6 @@ void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
     maddr_t pt_base;
     maddr_t pt_entry;
 
-    maddr_t page;
-
     /* While this could technically be valid under x86 architecture, it is
      * certainly invalid under a sensible Xen setup, and implies a failure to
      * parse a {P,V}CPU correctly.
@@ -87,8 +153,7 @@ void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
     if ( ! cr3 )
         throw pagefault(vaddr, cr3, 5, pagefault::FAULT_INVALID);
 
-    memory.read64((cr3 & addr_mask) + pm4l_offset(vaddr),
-                  pml4_entry);
+    read_entry(cr3 & addr_mask, pm4l_offset(vaddr), pml4_entry);
 
     // PDPT present?
     if ( ! present(pml4_entry) )
@@ -99,14 +164,12 @@ void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
     // Page Size bit set? (512G superpage)
     if ( page_size(pml4_entry) )
     {
-        maddr = offset_512G(pdpt_base, vaddr);
-        if ( page_end )
-            *page_end = roundup_512G(vaddr);
+        base = pdpt_base;
+        size = size_512G;
         return;
     }
 
-    memory.read64(pdpt_base + pdpt_offset(vaddr),
-                  pdpt_entry);
+    read_entry(pdpt_base, pdpt_offset(vaddr), pdpt_entry);
 
     // PD present?
     if ( ! present(pdpt_entry) )
@@ -117,14 +180,12 @@ void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
     // Page Size bit set? (1G superpage)
     if ( page_size(pdpt_entry) )
     {
-        maddr = offset_1G(pd_base, vaddr);
-        if ( page_end )
-            *page_end = roundup_1G(vaddr);
+        base = pd_base;
+        size = size_1G;
         return;
     }
 
-    memory.read64(pd_base + pd_offset(vaddr),
-                  pd_entry);
+    read_entry(pd_base, pd_offset(vaddr), pd_entry);
 
     // PT present?
     if ( ! present(pd_entry) )
@@ -135,23 +196,19 @@ void pagetable_walk_64(const maddr_t & cr3, const vaddr_t & vaddr,
     // Page Size bit set? (2M superpage)
     if ( page_size(pd_entry) )
     {
-        maddr = offset_2M(pt_base, vaddr);
-        if ( page_end )
-            *page_end = roundup_2M(vaddr);
+        base = pt_base;
+        size = size_2M;
         return;
     }
 
-    memory.read64(pt_base + pt_offset(vaddr),
-                  pt_entry);
+    read_entry(pt_base, pt_offset(vaddr), pt_entry);
 
     // Page present?
     if ( ! present(pt_entry) )
         throw pagefault(vaddr, cr3, 1, pagefault::FAULT_NOTPRESENT);
 
-    page = pt_entry & addr_mask;
-    maddr = offset_4K(page, vaddr);
-    if ( page_end )
-        *page_end = roundup_4K(vaddr);
+    base = pt_entry & addr_mask;
+    size = size_4K;
 }
 
 /*
@@ -33,31 +33,37 @@ namespace x86_64
     PT64::PT64(const uint64_t & cr3):cr3(cr3) {};
     PT64::~PT64() {};
 
-    void PT64::walk(const vaddr_t & vaddr, maddr_t & maddr,
-                       vaddr_t * page_end) const
+    void PT64::validate_vaddr(const vaddr_t & vaddr) const
     {
         /* Verify the pointer is canonical.  If not, the vaddr is
          * certainly junk. */
         if ( vaddr > 0x00007fffffffffffULL &&
              vaddr < 0xffff800000000000ULL )
             throw validate(vaddr, "Address is non-canonical.");
+    }
 
-        pagetable_walk_64(this->cr3, vaddr, maddr, page_end);
+    void PT64::walk_uncached(const vaddr_t & vaddr, maddr_t & page_base,
+                             uint64_t & page_size) const
+    {
+        pagetable_walk_64(this->cr3, vaddr, page_base, page_size);
     }
 
 
     PT64Compat::PT64Compat(const uint64_t & cr3):cr3(cr3) {};
     PT64Compat::~PT64Compat() {};
 
-    void PT64Compat::walk(const vaddr_t & vaddr, maddr_t & maddr,
-                       vaddr_t * page_end) const
+    void PT64Compat::validate_vaddr(const vaddr_t & vaddr) const
     {
         /* Long compat mode uses 32bit pointers running on the same
          * 64bit pagetables, with a 0-extended pointer. */
         if ( vaddr & 0xffffffff00000000ULL )
             throw validate(vaddr, "Pointer out of range for 64bit Compat pagetables.");
+    }
 
-        pagetable_walk_64(this->cr3, vaddr, maddr, page_end);
+    void PT64Compat::walk_uncached(const vaddr_t & vaddr, maddr_t & page_base,
+                                   uint64_t & page_size) const
+    {
+        pagetable_walk_64(this->cr3, vaddr, page_base, page_size);
     }
 }
 
@@ -36,9 +36,9 @@
 #include "host.hpp"
 #include "util/print-bitwise.hpp"
 #include "util/print-structures.hpp"
+#include "util/stack-scan.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
-#include "util/stdio-wrapper.hpp"
 #include "util/misc.hpp"
 #include "memory.hpp"
 
@@ -183,9 +183,11 @@ namespace x86_64
 
             host.validate_xen_vaddr(cpu_info);
 
+            MemSnapshot info;
+            info.read(*this->xenpt, cpu_info, CPUINFO_sizeof);
+
             uint32_t pid;
-            memory.read32_vaddr(*this->xenpt, cpu_info + CPUINFO_processor_id,
-                                pid);
+            info.get(CPUINFO_processor_id, pid);
             this->processor_id = pid;
 
             LOG_INFO("  Processor ID %u\n", this->processor_id);
@@ -196,13 +198,11 @@ namespace x86_64
                 return false;
             }
 
-            memory.read64_vaddr(*this->xenpt, cpu_info + CPUINFO_current_vcpu,
-                                this->current_vcpu_ptr);
+            info.get(CPUINFO_current_vcpu, this->current_vcpu_ptr);
             host.validate_xen_vaddr(this->current_vcpu_ptr);
 
 
-            memory.read64_vaddr(*this->xenpt, cpu_info + CPUINFO_per_cpu_offset,
-                                this->per_cpu_offset);
+            info.get(CPUINFO_per_cpu_offset, this->per_cpu_offset);
             memory.read64_vaddr(*this->xenpt, this->per_cpu_offset + per_cpu__curr_vcpu,
                                 this->per_cpu_current_vcpu_ptr);
 
@@ -303,143 +303,143 @@ namespace x86_64
 
     bool PCPU::is_online() const { return this->online; }
 
-    int PCPU::print_state(FILE * o) const
+    int PCPU::print_state(Writer & o) const
     {
         int len = 0;
         Abstract::VCPU * vcpu_to_print = NULL;
 
-        len += FPRINTF(o, "  PCPU %d Host state:\n", this->processor_id);
+        len += o.printf("  PCPU %d Host state:\n", this->processor_id);
 
         if ( !this->online )
         {
-            return len + FPUTS("    PCPU Offline\n\n", o);
+            return len + o.puts("    PCPU Offline\n\n");
         }
 
         if ( this->flags & CPU_GP_REGS )
         {
-            len += FPRINTF(o, "\tRIP:    %04x:[<%016"PRIx64">] Ring %d\n",
-                           this->regs.cs, this->regs.rip, this->regs.cs & 0x3);
-            len += FPRINTF(o, "\tRFLAGS: %016"PRIx64" ", this->regs.rflags);
+            len += o.printf("\tRIP:    %04x:[<%016"PRIx64">] Ring %d\n",
+                            this->regs.cs, this->regs.rip, this->regs.cs & 0x3);
+            len += o.printf("\tRFLAGS: %016"PRIx64" ", this->regs.rflags);
             len += print_rflags(o, this->regs.rflags);
-            len += FPUTS("\n\n", o);
-
-            len += FPRINTF(o, "\trax: %016"PRIx64"   rbx: %016"PRIx64"   rcx: %016"PRIx64"\n",
-                           this->regs.rax, this->regs.rbx, this->regs.rcx);
-            len += FPRINTF(o, "\trdx: %016"PRIx64"   rsi: %016"PRIx64"   rdi: %016"PRIx64"\n",
-                           this->regs.rdx, this->regs.rsi, this->regs.rdi);
-            len += FPRINTF(o, "\trbp: %016"PRIx64"   rsp: %016"PRIx64"   r8:  %016"PRIx64"\n",
-                           this->regs.rbp, this->regs.rsp, this->regs.r8);
-            len += FPRINTF(o, "\tr9:  %016"PRIx64"   r10: %016"PRIx64"   r11: %016"PRIx64"\n",
-                           this->regs.r9,  this->regs.r10, this->regs.r11);
-            len += FPRINTF(o, "\tr12: %016"PRIx64"   r13: %016"PRIx64"   r14: %016"PRIx64"\n",
-                           this->regs.r12, this->regs.r13, this->regs.r14);
-            len += FPRINTF(o, "\tr15: %016"PRIx64"\n",
-                           this->regs.r15);
+            len += o.puts("\n\n");
+
+            len += o.printf("\trax: %016"PRIx64"   rbx: %016"PRIx64"   rcx: %016"PRIx64"\n",
+                            this->regs.rax, this->regs.rbx, this->regs.rcx);
+            len += o.printf("\trdx: %016"PRIx64"   rsi: %016"PRIx64"   rdi: %016"PRIx64"\n",
+                            this->regs.rdx, this->regs.rsi, this->regs.rdi);
+            len += o.printf("\trbp: %016"PRIx64"   rsp: %016"PRIx64"   r8:  %016"PRIx64"\n",
+                            this->regs.rbp, this->regs.rsp, this->regs.r8);
+            len += o.printf("\tr9:  %016"PRIx64"   r10: %016"PRIx64"   r11: %016"PRIx64"\n",
+                            this->regs.r9,  this->regs.r10, this->regs.r11);
+            len += o.printf("\tr12: %016"PRIx64"   r13: %016"PRIx64"   r14: %016"PRIx64"\n",
+                            this->regs.r12, this->regs.r13, this->regs.r14);
+            len += o.printf("\tr15: %016"PRIx64"\n",
+                            this->regs.r15);
         }
 
         if ( this->flags & CPU_CR_REGS )
         {
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
 
-            len += FPRINTF(o, "\tcr0: %016"PRIx64"  ", this->regs.cr0);
+            len += o.printf("\tcr0: %016"PRIx64"  ", this->regs.cr0);
             len += print_cr0(o, this->regs.cr0);
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
 
-            len += FPRINTF(o, "\tcr3: %016"PRIx64"   cr2: %016"PRIx64"\n",
-                           this->regs.cr3, this->regs.cr2);
+            len += o.printf("\tcr3: %016"PRIx64"   cr2: %016"PRIx64"\n",
+                            this->regs.cr3, this->regs.cr2);
 
-            len += FPRINTF(o, "\tcr4: %016"PRIx64"  ", this->regs.cr4);
+            len += o.printf("\tcr4: %016"PRIx64"  ", this->regs.cr4);
             len += print_cr4(o, this->regs.cr4);
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
         }
 
         if ( this->flags & CPU_GP_REGS )
         {
-            len += FPUTS("\n", o);
-            len += FPRINTF(o, "\tds: %04"PRIx16"   es: %04"PRIx16"   "
-                           "fs: %04"PRIx16"   gs: %04"PRIx16"   "
-                           "ss: %04"PRIx16"   cs: %04"PRIx16"\n",
-                           this->regs.ds, this->regs.es, this->regs.fs,
-                           this->regs.gs, this->regs.ss, this->regs.cs);
+            len += o.puts("\n");
+            len += o.printf("\tds: %04"PRIx16"   es: %04"PRIx16"   "
+                            "fs: %04"PRIx16"   gs: %04"PRIx16"   "
+                            "ss: %04"PRIx16"   cs: %04"PRIx16"\n",
+                            this->regs.ds, this->regs.es, this->regs.fs,
+                            this->regs.gs, this->regs.ss, this->regs.cs);
         }
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         if ( this->flags & CPU_STACK_STATE )
         {
             switch ( this->vcpu_state )
             {
             case CTX_NONE:
-                len += FPRINTF(o, "\tpercpu current VCPU %016"PRIx64" IDLE\n",
-                               this->per_cpu_current_vcpu_ptr);
-                len += FPUTS("\tNo associated VCPU\n", o);
+                len += o.printf("\tpercpu current VCPU %016"PRIx64" IDLE\n",
+                                this->per_cpu_current_vcpu_ptr);
+                len += o.puts("\tNo associated VCPU\n");
                 break;
 
             case CTX_IDLE:
-                len += FPRINTF(o, "\tstack current VCPU  %016"PRIx64" IDLE\n",
-                               this->current_vcpu_ptr);
-                len += FPRINTF(o, "\tpercpu current VCPU %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
-                               this->per_cpu_current_vcpu_ptr, this->vcpu->domid, this->vcpu->vcpu_id);
-                len += FPUTS("\tVCPU was IDLE\n", o);
+                len += o.printf("\tstack current VCPU  %016"PRIx64" IDLE\n",
+                                this->current_vcpu_ptr);
+                len += o.printf("\tpercpu current VCPU %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
+                                this->per_cpu_current_vcpu_ptr, this->vcpu->domid, this->vcpu->vcpu_id);
+                len += o.puts("\tVCPU was IDLE\n");
                 break;
 
             case CTX_RUNNING:
-                len += FPRINTF(o, "\tstack current VCPU  %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
-                               this->current_vcpu_ptr, this->vcpu->domid, this->vcpu->vcpu_id);
-                len += FPRINTF(o, "\tpercpu current VCPU %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
-                               this->per_cpu_current_vcpu_ptr, this->vcpu->domid, this->vcpu->vcpu_id);
-                len += FPUTS("\tVCPU was RUNNING\n", o);
+                len += o.printf("\tstack current VCPU  %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
+                                this->current_vcpu_ptr, this->vcpu->domid, this->vcpu->vcpu_id);
+                len += o.printf("\tpercpu current VCPU %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
+                                this->per_cpu_current_vcpu_ptr, this->vcpu->domid, this->vcpu->vcpu_id);
+                len += o.puts("\tVCPU was RUNNING\n");
                 vcpu_to_print = this->vcpu;
                 break;
 
             case CTX_SWITCH:
-                len += FPRINTF(o, "\tstack current VCPU  %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
-                               this->current_vcpu_ptr, this->ctx_from->domid, this->ctx_from->vcpu_id);
-                len += FPRINTF(o, "\tpercpu current VCPU %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
-                               this->per_cpu_current_vcpu_ptr, this->ctx_to->domid,
-                               this->ctx_to->vcpu_id);
-                len += FPRINTF(o, "\tXen was context switching from DOM%"PRIu16" VCPU%"
-                               PRIu32" to DOM%"PRIu16" VCPU%"PRIu32"\n",
-                               this->ctx_from->domid, this->ctx_from->vcpu_id,
-                               this->ctx_to->domid, this->ctx_to->vcpu_id );
+                len += o.printf("\tstack current VCPU  %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
+                                this->current_vcpu_ptr, this->ctx_from->domid, this->ctx_from->vcpu_id);
+                len += o.printf("\tpercpu current VCPU %016"PRIx64" DOM%"PRIu16" VCPU%"PRIu32"\n",
+                                this->per_cpu_current_vcpu_ptr, this->ctx_to->domid,
+                                this->ctx_to->vcpu_id);
+                len += o.printf("\tXen was context switching from DOM%"PRIu16" VCPU%"
+                                PRIu32" to DOM%"PRIu16" VCPU%"PRIu32"\n",
+                                this->ctx_from->domid, this->ctx_from->vcpu_id,
+                                this->ctx_to->domid, this->ctx_to->vcpu_id );
                 vcpu_to_print = this->ctx_from;
                 break;
 
             case CTX_UNKNOWN:
             default:
-                len += FPUTS("\tUnable to parse stack information\n", o);
+                len += o.puts("\tUnable to parse stack information\n");
                 break;
             }
         }
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
-        len += FPRINTF(o, "\tStack at %016"PRIx64":", this->regs.rsp);
+        len += o.printf("\tStack at %016"PRIx64":", this->regs.rsp);
         len += print_64bit_stack(o, *this->xenpt, this->regs.rsp);
 
-        len += FPUTS("\n\tCode:\n", o);
+        len += o.puts("\n\tCode:\n");
         len += print_code(o, *this->xenpt, this->regs.rip);
 
-        len += FPUTS("\n\tCall Trace:\n", o);
+        len += o.puts("\n\tCall Trace:\n");
 
         uint64_t val = this->regs.rip;
         len += host.symtab.print_symbol64(o, val, true);
 
         this->print_stack(o, this->regs.rsp, 0);
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         if ( vcpu_to_print )
         {
-            len += FPRINTF(o, "  PCPU %"PRIu32" Guest state (DOM%"PRIu16" VCPU%"PRIu32"):\n",
-                           vcpu_to_print->processor, vcpu_to_print->domid, vcpu_to_print->vcpu_id);
+            len += o.printf("  PCPU %"PRIu32" Guest state (DOM%"PRIu16" VCPU%"PRIu32"):\n",
+                            vcpu_to_print->processor, vcpu_to_print->domid, vcpu_to_print->vcpu_id);
             len += vcpu_to_print->print_state(o);
         }
 
         return len;
     }
 
-    int PCPU::dump_stack(FILE * o) const
+    int PCPU::dump_stack(Writer & o) const
     {
         static const char * stack_name[] = { "Double Fault", "NMI", "MCE", "Normal" };
 
@@ -450,17 +450,21 @@ namespace x86_64
 
         try
         {
-            len += FPRINTF(o, "PCPU %d\n", this->processor_id);
-            len += FPRINTF(o, "  rsp 0x%016"PRIx64", min 0x%016"PRIx64", max 0x%016"PRIx64"\n\n",
-                           this->regs.rsp, stack_min, stack_max);
+            len += o.printf("PCPU %d\n", this->processor_id);
+            len += o.printf("  rsp 0x%016"PRIx64", min 0x%016"PRIx64", max 0x%016"PRIx64"\n\n",
+                            this->regs.rsp, stack_min, stack_max);
 
             if ( !host.validate_xen_vaddr(stack_min, false) ||
                  !host.validate_xen_vaddr(stack_max, false) )
             {
-                len += FPRINTF(o, "Failed to validate stack ends.  Giving up.\n");
+                len += o.puts("Failed to validate stack ends.  Giving up.\n");
                 return len;
             }
 
+            StackScanner scan;
+            scan.add_range(stack_min, stack_max, StackScanner::STACK);
+            host.symtab.add_text_ranges(scan);
+
             for ( int stack_page = 0; stack_page < 8; ++stack_page )
             {
                 vaddr_t page_base = stack_min + stack_page * PAGE_SIZE;
@@ -468,8 +472,8 @@ namespace x86_64
 
                 maddr_t frame;
 
-                len += FPRINTF(o, "Stack page %d, 0x%016"PRIx64"-0x%016"PRIx64" (%s stack)\n",
-                               stack_page, page_base, page_max, stack_name[std::min(stack_page,3)]);
+                len += o.printf("Stack page %d, 0x%016"PRIx64"-0x%016"PRIx64" (%s stack)\n",
+                                stack_page, page_base, page_max, stack_name[std::min(stack_page,3)]);
                 try
                 {
                     this->xenpt->walk(page_base, frame, NULL);
@@ -478,53 +482,74 @@ namespace x86_64
                 {
                     if ( e.level == 1 && e.reason == pagefault::FAULT_NOTPRESENT)
                     {
-                        len += FPUTS("  Not present (Guard page?)\n\n", o);
+                        len += o.puts("  Not present (Guard page?)\n\n");
                         continue;
                     }
                     throw;
                 }
 
-                len += FPUTS("\n", o);
+                len += o.puts("\n");
 
-                uint64_t val;
                 uint8_t zero_mask = 0x3f, zeroes = zero_mask;
                 bool printed_something = false;
 
-                for ( vaddr_t sp = page_base ; sp < page_max ; sp += 8, frame += 8 )
+                for ( vaddr_t sp = page_base ; sp < page_max ; )
                 {
-                    memory.read64(frame, val);
+                    const size_t nr = scan.read(*this->xenpt, sp, page_max + 1);
 
-                    if ( zeroes == zero_mask )
+                    for ( size_t x = 0; x < nr; ++x, sp += 8 )
                     {
-                        if ( val == 0 )
-                            continue;
-                        else if ( sp != page_base )
-                            len += FPRINTF(o, "Truncating block of zeroes\n");
-                    }
-                    zeroes = (zeroes << 1 | !val) & zero_mask;
+                        if ( zeroes == zero_mask )
+                        {
+                            // Skip the rest of this run of zeroes in one go.
+                            const size_t run = zero_run_length(&scan.words[x], nr - x);
+
+                            x += run;
+                            sp += run * 8;
+                            if ( x == nr )
+                                break;
+                            if ( sp != page_base )
+                                len += o.puts("Truncating block of zeroes\n");
+                        }
 
-                    len += FPRINTF(o, "  %016"PRIx64": %016"PRIx64, sp, val);
+                        const uint64_t val = scan.words[x];
+                        const uint8_t flags = scan.flags[x];
 
-                    if ( val >= stack_min && val <= stack_max )
-                        len += FPRINTF(o, " .%+d\n", (int)(val - sp));
-                    else if ( host.symtab.is_text_symbol(val) )
-                    {
-                        len += FPUTS(" ", o);
-                        len += host.symtab.print_text_symbol(o, val);
-                        len += FPUTS("\n", o);
-                    }
-                    else
-                        len += FPUTS("\n", o);
+                        zeroes = (zeroes << 1 | !val) & zero_mask;
+
+                        len += o.puts("  ");
+                        len += o.hex(sp, 16);
+                        len += o.puts(": ");
+                        len += o.hex(val, 16);
 
-                    printed_something = true;
+                        if ( flags & StackScanner::STACK )
+                        {
+                            int offset = (int)(val - sp);
+
+                            len += o.puts(" .");
+                            len += o.putc(offset < 0 ? '-' : '+');
+                            len += o.dec(offset < 0 ? -(int64_t)offset : offset);
+                            len += o.putc('\n');
+                        }
+                        else if ( flags & StackScanner::TEXT )
+                        {
+                            len += o.putc(' ');
+                            len += host.symtab.print_text_symbol(o, val);
+                            len += o.putc('\n');
+                        }
+                        else
+                            len += o.putc('\n');
+
+                        printed_something = true;
+                    }
                 }
 
                 if ( !printed_something )
-                    len += FPUTS("Page was entirely zeroes\n", o);
+                    len += o.puts("Page was entirely zeroes\n");
                 else if ( zeroes == zero_mask )
-                    len += FPUTS("Truncating range of zeroes\n", o);
+                    len += o.puts("Truncating range of zeroes\n");
 
-                len += FPUTS("\n", o);
+                len += o.puts("\n");
             }
         }
         catch ( const CommonError & e )
@@ -536,7 +561,7 @@ namespace x86_64
     }
 
 
-    int PCPU::print_stack(FILE * o, const vaddr_t & stack, unsigned mask) const
+    int PCPU::print_stack(Writer & o, const vaddr_t & stack, unsigned mask) const
     {
         static const char * stack_name[] = { "Double Fault", "NMI", "MCE", "Normal" };
         uint64_t sp = stack;
@@ -547,7 +572,7 @@ namespace x86_64
 
         try
         {
-            uint64_t stack_top, val;
+            uint64_t stack_top;
             x86_64exception exp_regs;
 
             host.validate_xen_vaddr(stack);
@@ -555,9 +580,9 @@ namespace x86_64
             if ( mask & (1U << stack_page) )
             {
                 // Bail - we have already visited this stack
-                len += FPRINTF(o, "\t  Not recursing.  Already visited the %s stack "
-                               "(%u, mask %#x)\n", stack_name[stack_page],
-                               stack_page, mask);
+                len += o.printf("\t  Not recursing.  Already visited the %s stack "
+                                "(%u, mask %#x)\n", stack_name[stack_page],
+                                stack_page, mask);
                 return len;
             }
             else
@@ -574,26 +599,42 @@ namespace x86_64
                 stack_top |= STACK_SIZE - CPUINFO_sizeof;
             }
 
-            while ( sp < stack_top )
+            SymbolBatch batch(host.symtab, o, true);
+            StackScanner scan;
+            host.symtab.add_text_ranges(scan);
+            try
+            {
+                // Only code addresses make it into the call trace.
+                while ( sp < stack_top )
+                {
+                    const size_t nr = scan.read(*this->xenpt, sp, stack_top);
+
+                    for ( size_t x = 0; x < nr; ++x )
+                        if ( scan.flags[x] & StackScanner::TEXT )
+                            len += batch.add(scan.words[x]);
+                    sp += nr * 8;
+                }
+            }
+            catch ( const CommonError & )
             {
-                memory.read64_vaddr(*this->xenpt, sp, val);
-                len += host.symtab.print_symbol64(o, val);
-                sp += 8;
+                len += batch.flush();
+                throw;
             }
+            len += batch.flush();
 
             if ( stack_page <= 2 )
             {
                 // This hardware interrupt interrupted something else, most likely Xen
                 memory.read_block_vaddr(*this->xenpt, stack_top, (char*)&exp_regs, sizeof exp_regs);
 
-                len += FPRINTF(o, "\n\t      %s interrupted Code at %04"PRIx16":%016"PRIx64
-                               " and Stack at %04"PRIx16":%016"PRIx64"\n\n",
-                               stack_name[stack_page], exp_regs.cs,
-                               exp_regs.rip, exp_regs.ss, exp_regs.rsp);
+                len += o.printf("\n\t      %s interrupted Code at %04"PRIx16":%016"PRIx64
+                                " and Stack at %04"PRIx16":%016"PRIx64"\n\n",
+                                stack_name[stack_page], exp_regs.cs,
+                                exp_regs.rip, exp_regs.ss, exp_regs.rsp);
 
                 // Did we interrupt non-ring0 context? Perhaps we interrupted the VCPU
                 if ( (exp_regs.cs & 3) != 0 )
-                    return len + FPUTS("\t  Interrupted VCPU context\n", o);
+                    return len + o.puts("\t  Interrupted VCPU context\n");
 
                 if ( (stack_top & ~(STACK_SIZE-1)) != (exp_regs.rsp & ~(STACK_SIZE-1)) )
                 {
@@ -37,7 +37,6 @@
 #include "util/print-structures.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
-#include "util/stdio-wrapper.hpp"
 
 using namespace Abstract::xensyms;
 using namespace x86_64::xensyms;
@@ -66,27 +65,30 @@ namespace x86_64
             host.validate_xen_vaddr(addr);
             this->vcpu_ptr = addr;
 
-            memory.read64_vaddr(xenpt, this->vcpu_ptr + VCPU_domain,
-                                this->domain_ptr);
+            MemSnapshot vcpu;
+            vcpu.read(xenpt, this->vcpu_ptr, VCPU_sizeof);
 
-            host.validate_xen_vaddr(this->domain_ptr);
+            vcpu.get(VCPU_domain, this->domain_ptr);
+            vcpu.get(VCPU_vcpu_id, this->vcpu_id);
+            vcpu.get(VCPU_processor, this->processor);
+            vcpu.get(VCPU_pause_flags, this->pause_flags);
+            vcpu.get(VCPU_pause_count, this->pause_count);
+            vcpu.get(VCPU_cr3, this->regs.cr3);
 
-            memory.read32_vaddr(xenpt, this->vcpu_ptr + VCPU_vcpu_id,
-                                this->vcpu_id);
+            host.validate_xen_vaddr(this->domain_ptr);
 
-            memory.read32_vaddr(xenpt, this->vcpu_ptr + VCPU_processor,
-                                this->processor);
+            uint8_t is_32bit;
+            uint32_t paging_mode;
+            const MemRequest domain_reqs[] = {
+                mem_request(xenpt, this->domain_ptr + DOMAIN_id, this->domid),
+                mem_request(xenpt, this->domain_ptr + DOMAIN_is_32bit_pv, is_32bit),
+                mem_request(xenpt, this->domain_ptr + DOMAIN_paging_mode, paging_mode)
+            };
 
-            memory.read16_vaddr(xenpt, this->domain_ptr + DOMAIN_id,
-                                this->domid);
+            memory.read_many(domain_reqs, sizeof domain_reqs / sizeof domain_reqs[0]);
 
-            uint8_t is_32bit;
-            memory.read8_vaddr(xenpt, this->domain_ptr + DOMAIN_is_32bit_pv,
-                               is_32bit);
             this->flags |= is_32bit ? CPU_PV_COMPAT : 0;
 
-            uint32_t paging_mode;
-            memory.read32_vaddr(xenpt, this->domain_ptr + DOMAIN_paging_mode, paging_mode);
             if ( paging_mode == 0 )
                 this->paging_support = VCPU::PAGING_NONE;
             else if ( paging_mode & (1U<<20) )
@@ -94,16 +96,13 @@ namespace x86_64
             else if ( paging_mode & (1U<<21) )
                 this->paging_support = VCPU::PAGING_HAP;
 
-            memory.read32_vaddr(xenpt, this->vcpu_ptr + VCPU_pause_flags,
-                                this->pause_flags);
-            memory.read32_vaddr(xenpt, this->vcpu_ptr + VCPU_pause_count,
-                                this->pause_count);
-
-            memory.read64_vaddr(xenpt, this->vcpu_ptr + VCPU_cr3,
-                                this->regs.cr3);
-
             return true;
         }
+        catch ( const std::bad_alloc & )
+        {
+            LOG_ERROR("Bad alloc of %"PRIu64" bytes for parsing vcpu structure "
+                      "at 0x%016"PRIx64"\n", VCPU_sizeof, addr);
+        }
         catch ( const CommonError & e )
         {
             e.log();
@@ -115,6 +114,8 @@ namespace x86_64
     bool VCPU::parse_extended(const Abstract::PageTable & xenpt,
                               const vaddr_t * cpuinfo)
     {
+        x86_64_cpu_user_regs uregs;
+
         try
         {
             if ( this->regs.cr3 == 0ULL )
@@ -134,8 +135,11 @@ namespace x86_64
             switch ( this->runstate )
             {
             case RST_NONE:
-                this->parse_gp_regs(this->vcpu_ptr + VCPU_user_regs, xenpt);
-                this->parse_seg_regs(this->vcpu_ptr + VCPU_user_regs, xenpt);
+                if ( this->read_uregs(this->vcpu_ptr + VCPU_user_regs, xenpt, uregs) )
+                {
+                    this->parse_gp_regs(uregs);
+                    this->parse_seg_regs(uregs);
+                }
                 break;
 
             case RST_RUNNING:
@@ -148,8 +152,10 @@ namespace x86_64
                     return false;
                 }
 
-                this->parse_gp_regs(*cpuinfo + CPUINFO_guest_cpu_user_regs, xenpt);
-                this->parse_seg_regs(this->vcpu_ptr + VCPU_user_regs, xenpt);
+                if ( this->read_uregs(*cpuinfo + CPUINFO_guest_cpu_user_regs, xenpt, uregs) )
+                    this->parse_gp_regs(uregs);
+                if ( this->read_uregs(this->vcpu_ptr + VCPU_user_regs, xenpt, uregs) )
+                    this->parse_seg_regs(uregs);
                 break;
 
             case RST_UNKNOWN:
@@ -172,90 +178,57 @@ namespace x86_64
         return false;
     }
 
-    bool VCPU::parse_gp_regs(const vaddr_t & regs, const Abstract::PageTable & xenpt)
+    bool VCPU::read_uregs(const vaddr_t & regs, const Abstract::PageTable & xenpt,
+                          x86_64_cpu_user_regs & uregs) const
     {
-        x86_64_cpu_user_regs * uregs = NULL;
-
         try
         {
             host.validate_xen_vaddr(regs);
-            uregs = new x86_64_cpu_user_regs();
-
-            memory.read_block_vaddr(xenpt, regs, (char*)uregs, sizeof *uregs );
-
-            this->regs.r15 = uregs->r15;
-            this->regs.r14 = uregs->r14;
-            this->regs.r13 = uregs->r13;
-            this->regs.r12 = uregs->r12;
-            this->regs.rbp = uregs->rbp;
-            this->regs.rbx = uregs->rbx;
-            this->regs.r11 = uregs->r11;
-            this->regs.r10 = uregs->r10;
-            this->regs.r9 = uregs->r9;
-            this->regs.r8 = uregs->r8;
-            this->regs.rax = uregs->rax;
-            this->regs.rcx = uregs->rcx;
-            this->regs.rdx = uregs->rdx;
-            this->regs.rsi = uregs->rsi;
-            this->regs.rdi = uregs->rdi;
-            this->regs.rip = uregs->rip;
-            this->regs.cs = uregs->cs;
-            this->regs.rflags = uregs->rflags;
-            this->regs.rsp = uregs->rsp;
-            this->regs.ss = uregs->ss;
-
-            this->flags |= CPU_GP_REGS;
-
-            SAFE_DELETE(uregs);
+            memory.read_block_vaddr(xenpt, regs, (char*)&uregs, sizeof uregs);
             return true;
         }
-        catch ( const std::bad_alloc & )
-        {
-            LOG_ERROR("Bad alloc of %"PRIu64" bytes for parsing vcpu structure "
-                      "at 0x%016"PRIx64"\n", sizeof *uregs, this->vcpu_ptr);
-        }
         catch ( const CommonError & e )
         {
             e.log();
         }
 
-        SAFE_DELETE(uregs);
         return false;
     }
 
-    bool VCPU::parse_seg_regs(const vaddr_t & regs, const Abstract::PageTable & xenpt)
+    void VCPU::parse_gp_regs(const x86_64_cpu_user_regs & uregs)
     {
-        x86_64_cpu_user_regs * uregs = NULL;
-
-        try
-        {
-            host.validate_xen_vaddr(regs);
-            uregs = new x86_64_cpu_user_regs();
-
-            memory.read_block_vaddr(xenpt, regs, (char*)uregs, sizeof *uregs );
-
-            this->regs.ds = uregs->ds;
-            this->regs.es = uregs->es;
-            this->regs.fs = uregs->fs;
-            this->regs.gs = uregs->gs;
-
-            this->flags |= CPU_SEG_REGS;
+        this->regs.r15 = uregs.r15;
+        this->regs.r14 = uregs.r14;
+        this->regs.r13 = uregs.r13;
+        this->regs.r12 = uregs.r12;
+        this->regs.rbp = uregs.rbp;
+        this->regs.rbx = uregs.rbx;
+        this->regs.r11 = uregs.r11;
+        this->regs.r10 = uregs.r10;
+        this->regs.r9 = uregs.r9;
+        this->regs.r8 = uregs.r8;
+        this->regs.rax = uregs.rax;
+        this->regs.rcx = uregs.rcx;
+        this->regs.rdx = uregs.rdx;
+        this->regs.rsi = uregs.rsi;
+        this->regs.rdi = uregs.rdi;
+        this->regs.rip = uregs.rip;
+        this->regs.cs = uregs.cs;
+        this->regs.rflags = uregs.rflags;
+        this->regs.rsp = uregs.rsp;
+        this->regs.ss = uregs.ss;
+
+        this->flags |= CPU_GP_REGS;
+    }
 
-            SAFE_DELETE(uregs);
-            return true;
-        }
-        catch ( const std::bad_alloc & )
-        {
-            LOG_ERROR("Bad alloc of %"PRIu64" bytes for parsing vcpu structure "
-                      "at 0x%016"PRIx64"\n", sizeof *uregs, this->vcpu_ptr);
-        }
-        catch ( const CommonError & e )
-        {
-            e.log();
-        }
+    void VCPU::parse_seg_regs(const x86_64_cpu_user_regs & uregs)
+    {
+        this->regs.ds = uregs.ds;
+        this->regs.es = uregs.es;
+        this->regs.fs = uregs.fs;
+        this->regs.gs = uregs.gs;
 
-        SAFE_DELETE(uregs);
-        return false;
+        this->flags |= CPU_SEG_REGS;
     }
 
     bool VCPU::copy_from_active(const Abstract::VCPU* active)
@@ -296,84 +269,84 @@ namespace x86_64
 
     bool VCPU::is_online() const { return ! (this->pause_flags & 0x2); }
 
-    int VCPU::print_state(FILE * o) const
+    int VCPU::print_state(Writer & o) const
     {
         int len = 0;
 
         if ( ! this->is_online() )
-            return len + FPUTS("\tVCPU Offline\n\n", o);
+            return len + o.puts("\tVCPU Offline\n\n");
 
         if ( this->flags & CPU_PV_COMPAT )
             return len + this->print_state_compat(o);
 
         if ( this->flags & CPU_GP_REGS )
         {
-            len += FPRINTF(o, "\tRIP:    %04x:[<%016"PRIx64">] Ring %d\n",
-                           this->regs.cs, this->regs.rip, this->regs.cs & 0x3);
-            len += FPRINTF(o, "\tRFLAGS: %016"PRIx64" ", this->regs.rflags);
+            len += o.printf("\tRIP:    %04x:[<%016"PRIx64">] Ring %d\n",
+                            this->regs.cs, this->regs.rip, this->regs.cs & 0x3);
+            len += o.printf("\tRFLAGS: %016"PRIx64" ", this->regs.rflags);
             len += print_rflags(o, this->regs.rflags);
-            len += FPUTS("\n\n", o);
-
-            len += FPRINTF(o, "\trax: %016"PRIx64"   rbx: %016"PRIx64"   rcx: %016"PRIx64"\n",
-                           this->regs.rax, this->regs.rbx, this->regs.rcx);
-            len += FPRINTF(o, "\trdx: %016"PRIx64"   rsi: %016"PRIx64"   rdi: %016"PRIx64"\n",
-                           this->regs.rdx, this->regs.rsi, this->regs.rdi);
-            len += FPRINTF(o, "\trbp: %016"PRIx64"   rsp: %016"PRIx64"   r8:  %016"PRIx64"\n",
-                           this->regs.rbp, this->regs.rsp, this->regs.r8);
-            len += FPRINTF(o, "\tr9:  %016"PRIx64"   r10: %016"PRIx64"   r11: %016"PRIx64"\n",
-                           this->regs.r9,  this->regs.r10, this->regs.r11);
-            len += FPRINTF(o, "\tr12: %016"PRIx64"   r13: %016"PRIx64"   r14: %016"PRIx64"\n",
-                           this->regs.r12, this->regs.r13, this->regs.r14);
-            len += FPRINTF(o, "\tr15: %016"PRIx64"\n",
-                           this->regs.r15);
+            len += o.puts("\n\n");
+
+            len += o.printf("\trax: %016"PRIx64"   rbx: %016"PRIx64"   rcx: %016"PRIx64"\n",
+                            this->regs.rax, this->regs.rbx, this->regs.rcx);
+            len += o.printf("\trdx: %016"PRIx64"   rsi: %016"PRIx64"   rdi: %016"PRIx64"\n",
+                            this->regs.rdx, this->regs.rsi, this->regs.rdi);
+            len += o.printf("\trbp: %016"PRIx64"   rsp: %016"PRIx64"   r8:  %016"PRIx64"\n",
+                            this->regs.rbp, this->regs.rsp, this->regs.r8);
+            len += o.printf("\tr9:  %016"PRIx64"   r10: %016"PRIx64"   r11: %016"PRIx64"\n",
+                            this->regs.r9,  this->regs.r10, this->regs.r11);
+            len += o.printf("\tr12: %016"PRIx64"   r13: %016"PRIx64"   r14: %016"PRIx64"\n",
+                            this->regs.r12, this->regs.r13, this->regs.r14);
+            len += o.printf("\tr15: %016"PRIx64"\n",
+                            this->regs.r15);
         }
 
         if ( this->flags & CPU_CR_REGS )
         {
-            len += FPUTS("\n", o);
-            len += FPRINTF(o, "\tcr3: %016"PRIx64"\n", this->regs.cr3);
+            len += o.puts("\n");
+            len += o.printf("\tcr3: %016"PRIx64"\n", this->regs.cr3);
         }
 
         if ( this->flags & CPU_GP_REGS )
         {
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
 
             if ( this->flags & CPU_SEG_REGS )
-                len += FPRINTF(o, "\tds: %04"PRIx16"   es: %04"PRIx16"   "
-                               "fs: %04"PRIx16"   gs: %04"PRIx16"   "
-                               "ss: %04"PRIx16"   cs: %04"PRIx16"\n",
-                               this->regs.ds, this->regs.es, this->regs.fs,
-                               this->regs.gs, this->regs.ss, this->regs.cs);
+                len += o.printf("\tds: %04"PRIx16"   es: %04"PRIx16"   "
+                                "fs: %04"PRIx16"   gs: %04"PRIx16"   "
+                                "ss: %04"PRIx16"   cs: %04"PRIx16"\n",
+                                this->regs.ds, this->regs.es, this->regs.fs,
+                                this->regs.gs, this->regs.ss, this->regs.cs);
             else
-                len += FPRINTF(o, "\tss: %04"PRIx16"   cs: %04"PRIx16"\n",
-                               this->regs.ss, this->regs.cs);
+                len += o.printf("\tss: %04"PRIx16"   cs: %04"PRIx16"\n",
+                                this->regs.ss, this->regs.cs);
         }
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
-        len += FPRINTF(o, "\tPause Count: %"PRId32", Flags: 0x%"PRIx32" ",
-                       this->pause_count, this->pause_flags);
+        len += o.printf("\tPause Count: %"PRId32", Flags: 0x%"PRIx32" ",
+                        this->pause_count, this->pause_flags);
         len += print_pause_flags(o, this->pause_flags);
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         switch ( this->runstate )
         {
         case RST_NONE:
-            len += FPRINTF(o, "\tNot running:  Last run on PCPU%"PRIu32"\n", this->processor);
+            len += o.printf("\tNot running:  Last run on PCPU%"PRIu32"\n", this->processor);
             break;
         case RST_RUNNING:
-            len += FPRINTF(o, "\tCurrently running on PCPU%"PRIu32"\n", this->processor);
+            len += o.printf("\tCurrently running on PCPU%"PRIu32"\n", this->processor);
             break;
         case RST_CTX_SWITCH:
-            len += FPUTS("\tBeing Context Switched:  State unreliable\n", o);
+            len += o.puts("\tBeing Context Switched:  State unreliable\n");
             break;
         default:
-            len += FPUTS("\tUnknown runstate\n", o);
+            len += o.puts("\tUnknown runstate\n");
             break;
         }
-        len += FPRINTF(o, "\tStruct vcpu at %016"PRIx64"\n", this->vcpu_ptr);
+        len += o.printf("\tStruct vcpu at %016"PRIx64"\n", this->vcpu_ptr);
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         if ( this->flags & CPU_GP_REGS &&
              this->flags & CPU_CR_REGS &&
@@ -381,18 +354,20 @@ namespace x86_64
                this->paging_support == VCPU::PAGING_SHADOW )
             )
         {
-            len += FPRINTF(o, "\tStack at %16"PRIx64":", this->regs.rsp);
+            len += o.printf("\tStack at %16"PRIx64":", this->regs.rsp);
             len += print_64bit_stack(o, *this->dompt, this->regs.rsp);
 
-            len += FPUTS("\n\tCode:\n", o);
+            len += o.puts("\n\tCode:\n");
             len += print_code(o, *this->dompt, this->regs.rip);
 
-            len += FPUTS("\n\tCall Trace:\n", o);
+            len += o.puts("\n\tCall Trace:\n");
             if ( this->domid == 0 )
             {
                 vaddr_t sp = this->regs.rsp;
                 vaddr_t top = (this->regs.rsp | (PAGE_SIZE-1))+1;
                 uint64_t val;
+                MemView view;
+                SymbolBatch batch(host.dom0_symtab, o, true);
 
                 len += host.dom0_symtab.print_symbol64(o, this->regs.rip, true);
 
@@ -400,102 +375,104 @@ namespace x86_64
                 {
                     while ( sp < top )
                     {
-                        memory.read64_vaddr(*this->dompt, sp, val);
-                        len += host.dom0_symtab.print_symbol64(o, val);
+                        memory.read_view(view, *this->dompt, sp, val, top);
+                        len += batch.add(val);
                         sp += 8;
                     }
                 }
                 catch ( const CommonError & e )
                 {
+                    len += batch.flush();
                     e.log();
                 }
+                len += batch.flush();
             }
             else
-                len += FPUTS("\t  No symbol table for domain\n", o);
+                len += o.puts("\t  No symbol table for domain\n");
 
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
         }
         return len;
     }
 
-    int VCPU::print_state_compat(FILE * o) const
+    int VCPU::print_state_compat(Writer & o) const
     {
         int len = 0;
 
         if ( this->flags & CPU_GP_REGS )
         {
-            len += FPRINTF(o, "\tEIP:    %04"PRIx16":[<%08"PRIx32">] Ring %d\n",
-                           this->regs.cs, this->regs.eip, this->regs.cs & 0x3);
-            len += FPRINTF(o, "\tEFLAGS: %08"PRIx32" ", this->regs.eflags);
+            len += o.printf("\tEIP:    %04"PRIx16":[<%08"PRIx32">] Ring %d\n",
+                            this->regs.cs, this->regs.eip, this->regs.cs & 0x3);
+            len += o.printf("\tEFLAGS: %08"PRIx32" ", this->regs.eflags);
             len += print_rflags(o, this->regs.rflags & -((uint32_t)1));
-            len += FPUTS("\n", o);
-
-            len += FPRINTF(o, "\teax: %08"PRIx32"   ebx: %08"PRIx32"   ",
-                           this->regs.eax, this->regs.ebx);
-            len += FPRINTF(o, "ecx: %08"PRIx32"   edx: %08"PRIx32"\n",
-                           this->regs.ecx, this->regs.edx);
-            len += FPRINTF(o, "\tesi: %08"PRIx32"   edi: %08"PRIx32"   ",
-                           this->regs.esi, this->regs.edi);
-            len += FPRINTF(o, "ebp: %08"PRIx32"   esp: %08"PRIx32"\n",
-                           this->regs.ebp, this->regs.esp);
+            len += o.puts("\n");
+
+            len += o.printf("\teax: %08"PRIx32"   ebx: %08"PRIx32"   ",
+                            this->regs.eax, this->regs.ebx);
+            len += o.printf("ecx: %08"PRIx32"   edx: %08"PRIx32"\n",
+                            this->regs.ecx, this->regs.edx);
+            len += o.printf("\tesi: %08"PRIx32"   edi: %08"PRIx32"   ",
+                            this->regs.esi, this->regs.edi);
+            len += o.printf("ebp: %08"PRIx32"   esp: %08"PRIx32"\n",
+                            this->regs.ebp, this->regs.esp);
         }
 
         if ( this->flags & CPU_CR_REGS )
         {
-            len += FPRINTF(o, "\tcr3: %016"PRIx64"\n", this->regs.cr3);
+            len += o.printf("\tcr3: %016"PRIx64"\n", this->regs.cr3);
         }
 
         if ( this->flags & CPU_GP_REGS )
         {
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
 
             if ( this->flags & CPU_SEG_REGS )
-                len += FPRINTF(o, "\tds: %04"PRIx16"   es: %04"PRIx16"   "
-                               "fs: %04"PRIx16"   gs: %04"PRIx16"   "
-                               "ss: %04"PRIx16"   cs: %04"PRIx16"\n",
-                               this->regs.ds, this->regs.es, this->regs.fs,
-                               this->regs.gs, this->regs.ss, this->regs.cs);
+                len += o.printf("\tds: %04"PRIx16"   es: %04"PRIx16"   "
+                                "fs: %04"PRIx16"   gs: %04"PRIx16"   "
+                                "ss: %04"PRIx16"   cs: %04"PRIx16"\n",
+                                this->regs.ds, this->regs.es, this->regs.fs,
+                                this->regs.gs, this->regs.ss, this->regs.cs);
             else
-                len += FPRINTF(o, "\tss: %04"PRIx16"   cs: %04"PRIx16"\n",
-                               this->regs.ss, this->regs.cs);
+                len += o.printf("\tss: %04"PRIx16"   cs: %04"PRIx16"\n",
+                                this->regs.ss, this->regs.cs);
         }
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
-        len += FPRINTF(o, "\tPause Count: %"PRId32", Flags: 0x%"PRIx32" ",
-                       this->pause_count, this->pause_flags);
+        len += o.printf("\tPause Count: %"PRId32", Flags: 0x%"PRIx32" ",
+                        this->pause_count, this->pause_flags);
         len += print_pause_flags(o, this->pause_flags);
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         switch ( this->runstate )
         {
         case RST_NONE:
-            len += FPRINTF(o, "\tNot running:  Last run on PCPU%"PRIu32"\n", this->processor);
+            len += o.printf("\tNot running:  Last run on PCPU%"PRIu32"\n", this->processor);
             break;
         case RST_RUNNING:
-            len += FPRINTF(o, "\tCurrently running on PCPU%"PRIu32"\n", this->processor);
+            len += o.printf("\tCurrently running on PCPU%"PRIu32"\n", this->processor);
             break;
         case RST_CTX_SWITCH:
-            len += FPUTS("\tBeing Context Switched:  State unreliable\n", o);
+            len += o.puts("\tBeing Context Switched:  State unreliable\n");
             break;
         default:
-            len += FPUTS("\tUnknown runstate\n", o);
+            len += o.puts("\tUnknown runstate\n");
             break;
         }
-        len += FPRINTF(o, "\tStruct vcpu at %016"PRIx64"\n", this->vcpu_ptr);
+        len += o.printf("\tStruct vcpu at %016"PRIx64"\n", this->vcpu_ptr);
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
 
         if ( this->flags & CPU_GP_REGS &&
              this->flags & CPU_CR_REGS )
         {
-            len += FPRINTF(o, "\tStack at %08"PRIx32":", this->regs.esp);
+            len += o.printf("\tStack at %08"PRIx32":", this->regs.esp);
             len += print_32bit_stack(o, *this->dompt, this->regs.rsp);
 
-            len += FPUTS("\n\tCode:\n", o);
+            len += o.puts("\n\tCode:\n");
             len += print_code(o, *this->dompt, this->regs.rip);
 
-            len += FPUTS("\n\tCall Trace:\n", o);
+            len += o.puts("\n\tCall Trace:\n");
             if ( this->domid == 0 )
             {
                 vaddr_t sp = this->regs.rsp;
@@ -503,6 +480,8 @@ namespace x86_64
                 union { uint32_t val32; uint64_t val64; } val;
                 val.val64 = 0;
 
+                SymbolBatch batch(host.dom0_symtab, o, false);
+
                 len += host.dom0_symtab.print_symbol32(o, this->regs.rip, true);
 
                 try
@@ -510,33 +489,35 @@ namespace x86_64
                     while ( sp < top )
                     {
                         memory.read32_vaddr(*this->dompt, sp, val.val32);
-                        len += host.dom0_symtab.print_symbol32(o, val.val64);
+                        len += batch.add(val.val64);
                         sp += 4;
                     }
                 }
                 catch ( const CommonError & e )
                 {
+                    len += batch.flush();
                     e.log();
                 }
+                len += batch.flush();
             }
             else
-                len += FPUTS("\t  No symbol table for domain\n", o);
+                len += o.puts("\t  No symbol table for domain\n");
 
         }
 
-        len += FPUTS("\n", o);
+        len += o.puts("\n");
         return len;
     }
 
-    int VCPU::dump_structures(FILE * o, const Abstract::PageTable & xenpt) const
+    int VCPU::dump_structures(Writer & o, const Abstract::PageTable & xenpt) const
     {
         int len = 0;
 
         if ( ! ( REQ_CORE_XENSYMS(vcpu) ))
             return len;
 
-        len += FPRINTF(o, "struct vcpu (0x%016"PRIx64") for vcpu %"PRId32"\n",
-                       this->vcpu_ptr, this->vcpu_id);
+        len += o.printf("struct vcpu (0x%016"PRIx64") for vcpu %"PRId32"\n",
+                        this->vcpu_ptr, this->vcpu_id);
         len += dump_64bit_data(o, xenpt, this->vcpu_ptr, VCPU_sizeof);
         return len;
     }
@@ -25,16 +25,19 @@
 
 #include "coreinfo.hpp"
 #include "util/macros.hpp"
+#include "util/misc.hpp"
 
 #include <cstring>
 
+const uint32_t CoreInfo::KEY_EMPTY;
+
 CoreInfo::CoreInfo()
- : name(NULL), data(NULL)
+ : name(NULL), data(NULL), keys()
 {}
 
 CoreInfo::CoreInfo(const char * note_name, const size_t name_size,
                    const char * note_data, const size_t data_size)
- : name(NULL), data(NULL)
+ : name(NULL), data(NULL), keys()
 {
     name = new char[name_size + 1];
     memcpy(name, note_name, name_size);
@@ -46,7 +49,7 @@ CoreInfo::CoreInfo(const char * note_name, const size_t name_size,
 }
 
 CoreInfo::CoreInfo(const size_t name_size, const size_t data_size)
-    : name(NULL), data(NULL)
+    : name(NULL), data(NULL), keys()
 {
     name = new char[name_size + 1];
     memset(name, 0, name_size + 1);
@@ -64,6 +67,7 @@ void CoreInfo::destroy()
 {
     SAFE_DELETE_ARRAY(name);
     SAFE_DELETE_ARRAY(data);
+    keys.clear();
 }
 
 void CoreInfo::transferOwnershipFrom(CoreInfo& other)
@@ -76,22 +80,81 @@ void CoreInfo::transferOwnershipFrom(CoreInfo& other)
     other.name = NULL;
     this->data = other.data;
     other.data = NULL;
+    this->keys.swap(other.keys);
 }
 
-const char * CoreInfo::locate_key_value(const char * key) const
+void CoreInfo::build_index()
 {
+    const KeyEntry empty = { 0, 0, 0, KEY_EMPTY };
+    size_t nr_lines = 0, size = 16;
+
+    this->keys.clear();
     if ( this->data == NULL )
-        return NULL;
+        return;
+
+    for ( const char * c = this->data; *c; ++c )
+        nr_lines += *c == '\n';
+
+    // Keep the index at most half full.
+    while ( size < 2 * (nr_lines + 1) )
+        size <<= 1;
+    this->keys.assign(size, empty);
 
-    const char * kbegin = strstr(this->data, key);
-    if ( kbegin == NULL )
+    for ( const char * line = this->data; *line; )
+    {
+        const char * eol = strchr(line, '\n');
+        const char * end = eol ? eol : line + strlen(line);
+        const char * eq = static_cast<const char *>(memchr(line, '=', end - line));
+
+        if ( eq )
+        {
+            const size_t len = eq - line;
+            const uint32_t hash = hash_key(line, len);
+            KeyEntry & e = this->keys[this->key_slot(line, len, hash)];
+
+            if ( e.value == KEY_EMPTY )
+            {
+                e.hash = hash;
+                e.key = (uint32_t)(line - this->data);
+                e.key_len = (uint32_t)len;
+                e.value = (uint32_t)(eq + 1 - this->data);
+            }
+        }
+
+        line = eol ? eol + 1 : end;
+    }
+}
+
+uint32_t CoreInfo::hash_key(const char * key, const size_t len)
+{
+    return (uint32_t)fnv1a(key, len);
+}
+
+size_t CoreInfo::key_slot(const char * key, const size_t len, const uint32_t hash) const
+{
+    const size_t mask = this->keys.size() - 1;
+    size_t x = hash & mask;
+
+    while ( this->keys[x].value != KEY_EMPTY &&
+            ( this->keys[x].hash != hash ||
+              this->keys[x].key_len != len ||
+              memcmp(&this->data[this->keys[x].key], key, len) ) )
+        x = (x + 1) & mask;
+
+    return x;
+}
+
+const char * CoreInfo::locate_key_value(const char * key) const
+{
+    if ( this->data == NULL || this->keys.empty() )
         return NULL;
 
-    const char * value = strchr(kbegin, '=');
-    if ( value == NULL )
+    const size_t len = strlen(key);
+    const KeyEntry & e = this->keys[this->key_slot(key, len, hash_key(key, len))];
+
+    if ( e.value == KEY_EMPTY )
         return NULL;
-    else
-        return ++value;
+    return &this->data[e.value];
 }
 
 bool CoreInfo::lookup_key_string(
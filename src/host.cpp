@@ -38,8 +38,10 @@
 #include "util/log.hpp"
 #include "memory.hpp"
 #include "util/file.hpp"
+#include "util/log-capture.hpp"
+#include "util/writer.hpp"
 #include "util/macros.hpp"
-#include "util/stdio-wrapper.hpp"
+#include "util/worker-pool.hpp"
 
 #include <new>
 #include <sysexits.h>
@@ -209,6 +211,288 @@ bool Host::parse_crash_xen_info(const char * buff, const size_t len)
 }
 
 
+/// Printed state of one PCPU, for Host::print_pcpus().
+class PCPUOutput
+{
+public:
+    /// Constructor.
+    PCPUOutput():
+        stream(NULL), data(NULL), size(0), len(0), write_error(0), failed(false)
+    {}
+
+    /// Destructor.
+    ~PCPUOutput()
+    {
+        if ( this->stream )
+            fclose(this->stream);
+        free(this->data);
+    }
+
+    /// Stream writing to data.
+    FILE * stream;
+    /// Printed state.
+    char * data;
+    /// Length of data.
+    size_t size;
+    /// Number of characters printed.
+    int len;
+    /// errno of a failure to print, or 0.
+    int write_error;
+    /// Whether printing failed, so later PCPUs should not be printed.
+    bool failed;
+
+private:
+    // @cond EXCLUDE
+    PCPUOutput(const PCPUOutput &);
+    PCPUOutput & operator= (const PCPUOutput &);
+    // @endcond
+};
+
+/// Work on each PCPU, for Host::decode_xen() and Host::print_xen().
+class PCPUJob : public WorkerPool::Job
+{
+public:
+    /// Work to perform on each PCPU.
+    enum Stage
+    {
+        /// Decode extended state.
+        STAGE_DECODE,
+        /// Print state into a buffer per PCPU.
+        STAGE_PRINT,
+        /// Dump stacks into a file per PCPU.
+        STAGE_DUMP_STACK
+    };
+
+    /**
+     * Constructor.
+     * @param stage Work to perform.
+     * @param capture Whether to capture log output per PCPU.
+     */
+    PCPUJob(const Stage stage, const bool capture):
+        stage(stage), capture(capture),
+        logs(new LogCapture[host.nr_pcpus]),
+        outputs(stage == STAGE_PRINT ? new PCPUOutput[host.nr_pcpus] : NULL)
+    {}
+
+    /// Destructor.
+    virtual ~PCPUJob()
+    {
+        SAFE_DELETE_ARRAY(this->logs);
+        SAFE_DELETE_ARRAY(this->outputs);
+    }
+
+    /**
+     * Work on a PCPU.
+     * @param index PCPU index.
+     */
+    virtual void run(const size_t index)
+    {
+        const int x = (int)index;
+
+        if ( this->capture )
+            this->logs[x].start();
+
+        try
+        {
+            switch ( this->stage )
+            {
+            case STAGE_DECODE:
+                this->decode(x);
+                break;
+            case STAGE_PRINT:
+                this->print(x);
+                break;
+            case STAGE_DUMP_STACK:
+                this->dump_stack(x);
+                break;
+            }
+        }
+        catch ( const std::bad_alloc & )
+        {
+            LOG_ERROR("Bad alloc for pcpu%d.  Kdump environment needs more memory\n", x);
+            if ( this->outputs )
+                this->outputs[x].failed = true;
+        }
+
+        if ( this->capture )
+            this->logs[x].stop();
+    }
+
+    /// Write the captured log output, in PCPU order.
+    void flush_logs()
+    {
+        for ( int x = 0; x < host.nr_pcpus; ++x )
+            this->logs[x].flush();
+    }
+
+    /**
+     * Write the printed state of each PCPU to a stream in PCPU order,
+     * along with the captured log output.  Stops after the first PCPU
+     * which failed to print, discarding the rest, as a serial run would
+     * not have got that far.
+     * @param o Writer.
+     * @param len Incremented by the number of characters written.
+     * @throws filewrite
+     * @return boolean indicating whether every PCPU was printed.
+     */
+    bool write(Writer & o, int & len)
+    {
+        for ( int x = 0; x < host.nr_pcpus; ++x )
+        {
+            PCPUOutput & out = this->outputs[x];
+            int error = out.write_error;
+
+            // Closing the stream finalises data and size.
+            if ( out.stream )
+            {
+                fclose(out.stream);
+                out.stream = NULL;
+            }
+
+            try
+            {
+                o.write(out.data, out.size);
+            }
+            catch ( const filewrite & e )
+            {
+                error = e.error;
+            }
+            len += out.len;
+            this->logs[x].flush();
+
+            if ( error || out.failed )
+            {
+                for ( int y = x + 1; y < host.nr_pcpus; ++y )
+                    this->logs[y].discard();
+
+                if ( error )
+                    throw filewrite(error);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+protected:
+    /**
+     * Decode the extended state of a PCPU.
+     * @param x PCPU index.
+     */
+    void decode(const int x)
+    {
+        if ( ! host.pcpus[x]->is_online() )
+        {
+            LOG_DEBUG("  Skipping pcpu%d - offline\n", x);
+            return;
+        }
+        if ( ! host.pcpus[x]->decode_extended_state() )
+            LOG_WARN("  Failed to decode extended state for pcpu%d\n", x);
+    }
+
+    /**
+     * Print the state of a PCPU into its buffer.  Errors are logged to the
+     * buffer, as they would have been to xen.log.
+     * @param x PCPU index.
+     */
+    void print(const int x)
+    {
+        PCPUOutput & out = this->outputs[x];
+
+        if ( ! (out.stream = open_memstream(&out.data, &out.size)) )
+        {
+            out.write_error = errno;
+            out.failed = true;
+            return;
+        }
+
+        Writer w(out.stream);
+        set_additional_log(&w);
+
+        try
+        {
+            out.len = host.pcpus[x]->print_state(w);
+            w.flush();
+        }
+        catch ( const std::bad_alloc & )
+        {
+            LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+            out.failed = true;
+        }
+        catch ( const CommonError & e )
+        {
+            e.log();
+            out.failed = true;
+        }
+        catch ( const filewrite & e )
+        {
+            out.write_error = e.error;
+            out.failed = true;
+        }
+
+        set_additional_log(NULL);
+    }
+
+    /**
+     * Dump the stack of a PCPU into xen.pcpuN.stack.log.
+     * @param x PCPU index.
+     */
+    void dump_stack(const int x)
+    {
+        char filename[32];
+        FILE * file;
+
+        if ( !host.pcpus[x]->is_online() || host.pcpus[x]->processor_id != x )
+            return;
+
+        if ( snprintf(filename, sizeof filename, "xen.pcpu%d.stack.log", x) < 0 )
+            return;
+
+        if ( NULL == (file = fopen_in_outdir(filename, "w")) )
+        {
+            LOG_ERROR("Unable to open %s in output directory: %s\n",
+                      filename, strerror(errno));
+            return;
+        }
+
+        {
+            Writer w(file);
+
+            set_additional_log(&w);
+            try
+            {
+                host.pcpus[x]->dump_stack(w);
+                w.flush();
+            }
+            catch ( const std::bad_alloc & )
+            {
+                LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+            }
+            catch ( const filewrite & e )
+            {
+                e.log(filename);
+            }
+            set_additional_log(NULL);
+        }
+        SAFE_FCLOSE(file);
+    }
+
+    /// Work to perform.
+    const Stage stage;
+    /// Whether to capture log output per PCPU.
+    const bool capture;
+    /// Log output per PCPU.
+    LogCapture * logs;
+    /// Printed state per PCPU, for STAGE_PRINT.
+    PCPUOutput * outputs;
+
+private:
+    // @cond EXCLUDE
+    PCPUJob(const PCPUJob &);
+    PCPUJob & operator= (const PCPUJob &);
+    // @endcond
+};
+
 bool Host::decode_xen()
 {
     LOG_INFO("Decoding physical CPU information.  %d PCPUs\n", this->nr_pcpus);
@@ -241,15 +525,10 @@ bool Host::decode_xen()
         }
 
         LOG_DEBUG("  Reading PCPUs vcpus\n");
-        for (int x=0; x < nr_pcpus; ++x)
         {
-            if ( ! this->pcpus[x]->is_online() )
-            {
-                LOG_DEBUG("  Skipping pcpu%d - offline\n", x);
-                continue;
-            }
-            if ( ! this->pcpus[x]->decode_extended_state() )
-                LOG_WARN("  Failed to decode extended state for pcpu%d\n", x);
+            PCPUJob job(PCPUJob::STAGE_DECODE, WorkerPool::threads() > 1);
+            WorkerPool::run(job, nr_pcpus);
+            job.flush_logs();
         }
 
         this->active_vcpus.reserve(nr_pcpus);
@@ -307,147 +586,253 @@ bool Host::print_xen(bool dump_structures)
     }
     LOG_INFO("Opened for host information\n", xen_log_file);
 
-    set_additional_log(o);
-
-    try
     {
-        const Abstract::PageTable & xenpt = this->get_xenpt();
+        Writer w(o);
 
-        // Print some header information for the host
-        if ( this->xen_extra )
-            len += FPRINTF(o, "Xen version:      %d.%d%s\n", this->xen_major,
-                           this->xen_minor, this->xen_extra);
-        if ( this->xen_changeset )
-            len += FPRINTF(o, "Xen changeset:    %s\n", this->xen_changeset);
-        if ( this->xen_compiler )
-            len += FPRINTF(o, "Xen compiler:     %s\n", this->xen_compiler);
-        if ( this->xen_compile_date )
-            len += FPRINTF(o, "Xen compile date: %s\n", this->xen_compile_date);
-
-        len += FPRINTF(o, "Debug build:      %s\n\n",
-                       this->debug_build ? "true" : "false");
-
-        // Try to find and print the saved command line string
-        const Symbol * cmdline_sym = this->symtab.find("saved_cmdline");
-        if ( ! cmdline_sym )
-            len += FPUTS("Missing symbol for command line\n", o);
-        else
+        set_additional_log(&w);
+
+        try
         {
-            try
+            const Abstract::PageTable & xenpt = this->get_xenpt();
+
+            // Print some header information for the host
+            if ( this->xen_extra )
+                len += w.printf("Xen version:      %d.%d%s\n", this->xen_major,
+                                this->xen_minor, this->xen_extra);
+            if ( this->xen_changeset )
+                len += w.printf("Xen changeset:    %s\n", this->xen_changeset);
+            if ( this->xen_compiler )
+                len += w.printf("Xen compiler:     %s\n", this->xen_compiler);
+            if ( this->xen_compile_date )
+                len += w.printf("Xen compile date: %s\n", this->xen_compile_date);
+
+            len += w.printf("Debug build:      %s\n\n",
+                            this->debug_build ? "true" : "false");
+
+            // Try to find and print the saved command line string
+            const Symbol * cmdline_sym = this->symtab.find("saved_cmdline");
+            if ( ! cmdline_sym )
+                len += w.puts("Missing symbol for command line\n");
+            else
             {
-                // Size hardcoded in Xen
-                cmdline = new char[1024];
+                try
+                {
+                    // Size hardcoded in Xen
+                    cmdline = new char[1024];
 
-                host.validate_xen_vaddr(cmdline_sym->address);
-                memory.read_str_vaddr(xenpt, cmdline_sym->address, cmdline, 1023);
-                len += FPRINTF(o, "Xen command line: %s\n", cmdline);
+                    host.validate_xen_vaddr(cmdline_sym->address);
+                    memory.read_str_vaddr(xenpt, cmdline_sym->address, cmdline, 1023);
+                    len += w.printf("Xen command line: %s\n", cmdline);
 
+                    SAFE_DELETE_ARRAY(cmdline);
+                }
+                catch ( const std::bad_alloc & )
+                {
+                    LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+                }
+                catch ( const CommonError & e )
+                {
+                    e.log();
+                }
                 SAFE_DELETE_ARRAY(cmdline);
             }
-            catch ( const std::bad_alloc & )
-            {
-                LOG_ERROR("Bad Alloc exception.  Out of memory\n");
-            }
-            catch ( const CommonError & e )
-            {
-                e.log();
-            }
-            SAFE_DELETE_ARRAY(cmdline);
-        }
 
-        len += FPUTS("\n", o);
+            len += w.puts("\n");
 
-        // Dump the Xen vmcoreinfo, if set
-        if ( this->xen_vmcoreinfo.vmcoreinfoData() != NULL )
-        {
-            len += FPRINTF(o, "VMCOREINFO:\n%s",
-                    this->xen_vmcoreinfo.vmcoreinfoData());
-            this->xen_vmcoreinfo.destroy(); // Don't need it any more
-            len += FPUTS("\n", o);
-        }
+            // Dump the Xen vmcoreinfo, if set
+            if ( this->xen_vmcoreinfo.vmcoreinfoData() != NULL )
+            {
+                len += w.printf("VMCOREINFO:\n%s",
+                                this->xen_vmcoreinfo.vmcoreinfoData());
+                this->xen_vmcoreinfo.destroy(); // Don't need it any more
+                len += w.puts("\n");
+            }
 
-        for (int x=0; x < nr_pcpus; ++x)
-            len += this->pcpus[x]->print_state(o);
+            if ( ! this->print_pcpus(w, len) )
+                goto out;
 
-        len += FPUTS("\n  Console Ring:\n", o);
+            len += w.puts("\n  Console Ring:\n");
 
-        if ( HAVE_CORE_XENSYMS(console) )
-        {
-            uint64_t conring_ptr,length;
-            uint32_t tmp;
+            if ( HAVE_CORE_XENSYMS(console) )
+            {
+                uint64_t conring_ptr,length;
+                uint32_t tmp;
 
-            host.validate_xen_vaddr(conring);
-            host.validate_xen_vaddr(conring_size);
+                host.validate_xen_vaddr(conring);
+                host.validate_xen_vaddr(conring_size);
 
-            memory.read64_vaddr(xenpt, conring, conring_ptr);
-            memory.read32_vaddr(xenpt, conring_size, tmp);
-            length = tmp;
+                memory.read64_vaddr(xenpt, conring, conring_ptr);
+                memory.read32_vaddr(xenpt, conring_size, tmp);
+                length = tmp;
 
-            if ( HAVE_CORE_XENSYMS(consolepc) )
-            {
-                uint64_t prod,cons;
+                if ( HAVE_CORE_XENSYMS(consolepc) )
+                {
+                    uint64_t prod,cons;
 
-                host.validate_xen_vaddr(conringp);
-                host.validate_xen_vaddr(conringc);
+                    host.validate_xen_vaddr(conringp);
+                    host.validate_xen_vaddr(conringc);
 
-                memory.read32_vaddr(xenpt, conringp, tmp);
-                prod = tmp;
-                memory.read32_vaddr(xenpt, conringc, tmp);
-                cons = tmp;
+                    memory.read32_vaddr(xenpt, conringp, tmp);
+                    prod = tmp;
+                    memory.read32_vaddr(xenpt, conringc, tmp);
+                    cons = tmp;
 
-                len += print_console_ring(o, xenpt, conring_ptr, length, prod, cons);
+                    len += print_console_ring(w, xenpt, conring_ptr, length, prod, cons);
+                }
+                else
+                    len += print_console_ring(w, xenpt, conring_ptr, length, 0, 0);
             }
             else
-                len += print_console_ring(o, xenpt, conring_ptr, length, 0, 0);
+                len += w.puts("    Missing conring symbols\n");
+
+            w.flush();
+            success = true;
+        }
+        catch ( const CommonError & e )
+        {
+            e.log();
+        }
+        catch ( const filewrite & e )
+        {
+            e.log(xen_log_file);
         }
-        else
-            len += FPUTS("    Missing conring symbols\n", o);
 
-        success = true;
-    }
-    catch ( const CommonError & e )
-    {
-        e.log();
-    }
-    catch ( const filewrite & e )
-    {
-        e.log(xen_log_file);
+    out:
+        set_additional_log(NULL);
     }
-
-    set_additional_log(NULL);
     SAFE_FCLOSE(o);
 
     // If we dont wish to dump the structures, return now
     if ( ! dump_structures )
         return success;
 
-    for (int x=0; x < nr_pcpus; ++x)
+    try
     {
-        char filename[32];
-        FILE * file;
-
-        if ( !this->pcpus[x]->is_online() || this->pcpus[x]->processor_id != x )
-            continue;
+        PCPUJob job(PCPUJob::STAGE_DUMP_STACK, WorkerPool::threads() > 1);
+        WorkerPool::run(job, nr_pcpus);
+        job.flush_logs();
+    }
+    catch ( const std::bad_alloc & )
+    {
+        LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+    }
 
-        if ( snprintf(filename, sizeof filename, "xen.pcpu%d.stack.log", x) < 0 )
-            continue;
+    return success;
+}
 
-        if ( NULL == (file = fopen_in_outdir(filename, "w")) )
+bool Host::print_pcpus(Writer & o, int & len)
+{
+    if ( WorkerPool::threads() < 2 )
+    {
+        try
         {
-            LOG_ERROR("Unable to open %s in output directory: %s\n",
-                      filename, strerror(errno));
-            continue;
+            for (int x=0; x < nr_pcpus; ++x)
+                len += this->pcpus[x]->print_state(o);
+        }
+        catch ( const CommonError & e )
+        {
+            e.log();
+            return false;
         }
 
-        set_additional_log(file);
-        this->pcpus[x]->dump_stack(file);
-        set_additional_log(NULL);
-        SAFE_FCLOSE(file);
+        return true;
     }
 
-    return success;
+    // Each PCPU prints into its own buffer, then xen.log is assembled in order.
+    PCPUJob job(PCPUJob::STAGE_PRINT, true);
+    WorkerPool::run(job, nr_pcpus);
+    return job.write(o, len);
 }
 
+/// A domain found on the domain list, for Host::print_domains().
+class DomainWork
+{
+public:
+    /// Constructor.
+    DomainWork():
+        dom(NULL), ready(false), printed(false), log()
+    {}
+
+    /// Destructor.
+    ~DomainWork()
+    {
+        SAFE_DELETE(this->dom);
+    }
+
+    /// Domain.
+    Abstract::Domain * dom;
+    /// Whether the domain basics were parsed, so it can be printed.
+    bool ready;
+    /// Whether the domain was printed successfully.
+    bool printed;
+    /// Log output relating to this domain, if working concurrently.
+    LogCapture log;
+
+private:
+    // @cond EXCLUDE
+    DomainWork(const DomainWork &);
+    DomainWork & operator= (const DomainWork &);
+    // @endcond
+};
+
+/// Printing of the domains found on the domain list.
+class DomainJob : public WorkerPool::Job
+{
+public:
+    /**
+     * Constructor.
+     * @param xenpt Xen pagetables.
+     * @param dump_structures Whether the Xen structures should be dumped.
+     * @param capture Whether to capture log output per domain.
+     */
+    DomainJob(const Abstract::PageTable & xenpt, bool dump_structures, bool capture):
+        xenpt(xenpt), dump_structures(dump_structures), capture(capture), work()
+    {}
+
+    /// Destructor.
+    virtual ~DomainJob()
+    {
+        for ( size_t x = 0; x < this->work.size(); ++x )
+            SAFE_DELETE(this->work[x]);
+    }
+
+    /**
+     * Print a domain.
+     * @param index Index into work.
+     */
+    virtual void run(const size_t index)
+    {
+        DomainWork & w = *this->work[index];
+
+        if ( ! w.ready )
+            return;
+
+        if ( this->capture )
+            w.log.start();
+
+        w.printed = host.print_domain(*w.dom, this->xenpt, this->dump_structures);
+        SAFE_DELETE(w.dom);
+
+        if ( this->capture )
+            w.log.stop();
+    }
+
+    /// Xen pagetables.
+    const Abstract::PageTable & xenpt;
+    /// Whether the Xen structures should be dumped.
+    const bool dump_structures;
+    /// Whether to capture log output per domain.
+    const bool capture;
+    /// Domains, in domain list order.
+    std::vector<DomainWork *> work;
+
+private:
+    // @cond EXCLUDE
+    DomainJob(const DomainJob &);
+    DomainJob & operator= (const DomainJob &);
+    // @endcond
+};
+
 int Host::print_domains(bool dump_structures)
 {
     int success = 0;
@@ -464,25 +849,38 @@ int Host::print_domains(bool dump_structures)
         return success;
     }
 
-    Abstract::Domain * dom = NULL;
+    /* Walking the domain list is inherently serial.  With several worker
+     * threads, domains are collected and then decoded and printed
+     * concurrently, with log output buffered per domain so the log reads
+     * the same as a serial run.  Otherwise each domain is printed as soon
+     * as it is found. */
+    const bool concurrent = WorkerPool::threads() > 1;
+    DomainJob * job = NULL;
+    DomainWork * w = NULL;
     vaddr_t dom_ptr;
-    FILE * fd = NULL;
-    static char fname[32] = { 0 };
 
     try
     {
         const Abstract::PageTable & xenpt = this->get_xenpt();
 
+        job = new DomainJob(xenpt, dump_structures, concurrent);
+
         host.validate_xen_vaddr(domain_list);
         memory.read64_vaddr(xenpt, domain_list, dom_ptr);
         LOG_DEBUG("  Domain pointer = 0x%016"PRIx64"\n", dom_ptr);
 
         while ( dom_ptr )
         {
-            dom = new x86_64::Domain(xenpt);
+            job->work.push_back(NULL);
+            job->work.back() = w = new DomainWork();
+
+            if ( concurrent )
+                w->log.start();
+
+            w->dom = new x86_64::Domain(xenpt);
 
             host.validate_xen_vaddr(dom_ptr);
-            if ( ! dom->parse_basic(dom_ptr) )
+            if ( ! w->dom->parse_basic(dom_ptr) )
             {
                 LOG_WARN("  Failed to parse domain basics.  Cant continue with this domain\n");
                 break;
@@ -493,109 +891,157 @@ int Host::print_domains(bool dump_structures)
              * itself will be validated at the top of the next loop, so we get
              * a chance to print this information.
              */
-            dom_ptr = dom->next_domain_ptr;
-            LOG_INFO("  Found domain %"PRIu16"\n", dom->domain_id);
+            dom_ptr = w->dom->next_domain_ptr;
+            LOG_INFO("  Found domain %"PRIu16"\n", w->dom->domain_id);
+            w->ready = true;
 
-            snprintf(fname, sizeof fname, "dom%d.log", dom->domain_id);
-            if ( ! (fd = fopen_in_outdir(fname, "w")) )
+            if ( concurrent )
+                w->log.stop();
+            else
+                job->run(job->work.size() - 1);
+        }
+    }
+    catch ( const std::bad_alloc & )
+    {
+        LOG_ERROR("Bad Alloc exception.  Out of memory\n");
+    }
+    catch ( const CommonError & e )
+    {
+        e.log();
+    }
+
+    // Errors ending the walk are logged against the domain being walked.
+    if ( w && concurrent )
+        w->log.stop();
+
+    if ( job )
+    {
+        if ( concurrent )
+            WorkerPool::run(*job, job->work.size());
+
+        for ( size_t x = 0; x < job->work.size(); ++x )
+        {
+            job->work[x]->log.flush();
+            if ( job->work[x]->printed )
+                ++success;
+        }
+    }
+
+    SAFE_DELETE(job);
+
+    return success;
+}
+
+bool Host::print_domain(Abstract::Domain & dom, const Abstract::PageTable & xenpt,
+                        bool dump_structures)
+{
+    FILE * fd = NULL;
+    Writer * w = NULL;
+    char fname[32] = { 0 };
+    bool success = false;
+
+    try
+    {
+        snprintf(fname, sizeof fname, "dom%d.log", dom.domain_id);
+        if ( ! (fd = fopen_in_outdir(fname, "w")) )
+        {
+            LOG_ERROR("    Failed to open file '%s' in output directory\n",
+                      fname);
+            return false;
+        }
+        LOG_DEBUG("    Logging to '%s'\n", fname);
+
+        w = new Writer(fd);
+
+        /* As we have opened the file, might as well log errors to their
+         * relevant context.
+         */
+        set_additional_log(w);
+
+        if ( ! dom.parse_vcpus_basic() )
+        {
+            LOG_ERROR("    Failed to parse basic cpu information for domain %d\n",
+                      dom.domain_id);
+            goto out;
+        }
+
+        /* Try to match up this domains vcpus with vcpus running or idle on
+         * Xen's pcpus.  If so, take the up-to-date register state.
+         */
+        for ( uint32_t v = 0; v < dom.max_cpus; v++ )
+        {
+            unsigned int p; bool found;
+
+            if ( ! dom.vcpus[v]->is_online() )
             {
-                LOG_ERROR("    Failed to open file '%s' in output directory\n",
-                          fname);
-                goto loop_cont;
+                LOG_DEBUG("    Dom%"PRIu16" vcpu%"PRIu32" was not up\n", dom.domain_id, v);
+                continue;
             }
-            LOG_DEBUG("    Logging to '%s'\n", fname);
 
-            /* As we have opened the file, might as well log errors to their
-             * relevant context.
-             */
-            set_additional_log(fd);
+            for (p = 0, found = false; p < this->active_vcpus.size(); p++)
+                if ( this->active_vcpus[p].first == dom.vcpus[v]->vcpu_ptr )
+                {
+                    found = true;
+                    break;
+                }
 
-            if ( ! dom->parse_vcpus_basic() )
+            if ( found )
             {
-                LOG_ERROR("    Failed to parse basic cpu information for domain %d\n",
-                          dom->domain_id);
-                goto loop_cont;
+                LOG_DEBUG("    Dom%"PRIu16" vcpu%"PRIu32" was active on pcpu%u\n",
+                          dom.domain_id, v, p);
+                dom.vcpus[v]->copy_from_active(this->active_vcpus[p].second);
             }
-
-            /* Try to match up this domains vcpus with vcpus running or idle on
-             * Xen's pcpus.  If so, take the up-to-date register state.
-             */
-            for ( uint32_t v = 0; v < dom->max_cpus; v++ )
+            else
             {
-                unsigned int p; bool found;
+                LOG_DEBUG("    Dom%"PRIu16" vcpu%"PRIu32" was not active\n",
+                          dom.domain_id, v);
+                dom.vcpus[v]->runstate = Abstract::VCPU::RST_NONE;
+                dom.vcpus[v]->parse_extended(xenpt);
+            }
+        }
 
-                if ( ! dom->vcpus[v]->is_online() )
-                {
-                    LOG_DEBUG("    Dom%"PRIu16" vcpu%"PRIu32" was not up\n", dom->domain_id, v);
-                    continue;
-                }
+        try
+        {
+            dom.print_state(*w);
+            w->flush();
+        }
+        catch ( const filewrite & e )
+        {
+            e.log(fname);
+        }
 
-                for (p = 0, found = false; p < this->active_vcpus.size(); p++)
-                    if ( this->active_vcpus[p].first == dom->vcpus[v]->vcpu_ptr )
-                    {
-                        found = true;
-                        break;
-                    }
+        // We are going to dump the xen structures...
+        if ( dump_structures )
+        {
+            // so start off by cleaning up
+            set_additional_log(NULL);
+            SAFE_DELETE(w);
+            SAFE_FCLOSE(fd);
 
-                if ( found )
-                {
-                    LOG_DEBUG("    Dom%"PRIu16" vcpu%"PRIu32" was active on pcpu%u\n",
-                              dom->domain_id, v, p);
-                    dom->vcpus[v]->copy_from_active(this->active_vcpus[p].second);
-                }
-                else
-                {
-                    LOG_DEBUG("    Dom%"PRIu16" vcpu%"PRIu32" was not active\n",
-                              dom->domain_id, v);
-                    dom->vcpus[v]->runstate = Abstract::VCPU::RST_NONE;
-                    dom->vcpus[v]->parse_extended(xenpt);
-                }
+            // and open up some newer files
+            snprintf(fname, sizeof fname, "dom%d.structures.log", dom.domain_id);
+            if ( ! (fd = fopen_in_outdir(fname, "w")) )
+            {
+                LOG_ERROR("    Failed to open file '%s' in output directory\n",
+                          fname);
+                goto out;
             }
+            LOG_DEBUG("    Dumping structures to '%s'\n", fname);
+            w = new Writer(fd);
+            set_additional_log(w);
 
             try
             {
-                dom->print_state(fd);
+                dom.dump_structures(*w);
+                w->flush();
             }
             catch ( const filewrite & e )
             {
                 e.log(fname);
             }
-
-            // We are going to dump the xen structures...
-            if ( dump_structures )
-            {
-                // so start off by cleaning up
-                set_additional_log(NULL);
-                SAFE_FCLOSE(fd);
-
-                // and open up some newer files
-                snprintf(fname, sizeof fname, "dom%d.structures.log", dom->domain_id);
-                if ( ! (fd = fopen_in_outdir(fname, "w")) )
-                {
-                    LOG_ERROR("    Failed to open file '%s' in output directory\n",
-                              fname);
-                    goto loop_cont;
-                }
-                LOG_DEBUG("    Dumping structures to '%s'\n", fname);
-                set_additional_log(fd);
-
-                try
-                {
-                    dom->dump_structures(fd);
-                }
-                catch ( const filewrite & e )
-                {
-                    e.log(fname);
-                }
-            }
-
-            ++success;
-
-        loop_cont:
-            set_additional_log(NULL);
-            SAFE_FCLOSE(fd);
-            SAFE_DELETE(dom);
         }
+
+        success = true;
     }
     catch ( const std::bad_alloc & )
     {
@@ -606,9 +1052,10 @@ int Host::print_domains(bool dump_structures)
         e.log();
     }
 
+out:
     set_additional_log(NULL);
+    SAFE_DELETE(w);
     SAFE_FCLOSE(fd);
-    SAFE_DELETE(dom);
 
     return success;
 }
@@ -671,6 +1118,7 @@ bool Host::parse_vmcoreinfo(const ElfNote& note)
     try
     {
         CoreInfo info(note.name, note.name_size, note.desc, data_size);
+        info.build_index();
         // search for XEN in note name to see which vmcoreinfo we have
         if ( strcmp(info.vmcoreinfoName(), "VMCOREINFO_XEN") == 0 )
             this->xen_vmcoreinfo.transferOwnershipFrom(info);
@@ -18,13 +18,18 @@
  *  Copyright (c) 2011,2012 Citrix Inc.
  */
 
+#include "util/hex.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
+#include "util/worker-pool.hpp"
+#include "util/writer.hpp"
 #include "host.hpp"
 #include "memory.hpp"
 #include "system.hpp"
+#include "symbol-table.hpp"
 #include "abstract/elf.hpp"
 #include "abstract/xensyms.hpp"
+#include "arch/x86_64/pagetable-walk.hpp"
 
 #include <getopt.h>
 
@@ -40,6 +45,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <errno.h>
 
 /**
@@ -56,7 +62,7 @@ int verbosity = LOG_LEVEL_INFO;
 // Local variables
 
 /// Command line short options.
-const static char * short_options = "hc:o:x:d:qvs";
+const static char * short_options = "hc:o:x:d:qvsj:";
 /// Command line long options.
 const static struct option long_options[] =
 {
@@ -79,6 +85,14 @@ const static struct option long_options[] =
     // Additional debugging options
     { "dump-structures", no_argument, NULL, 0x101 },
 
+    // Performance tuning
+    { "memory-backend", required_argument, NULL, 0x102 },
+    { "cache-size", required_argument, NULL, 0x103 },
+    { "tlb-size", required_argument, NULL, 0x104 },
+    { "pt-cache-size", required_argument, NULL, 0x105 },
+    { "symbol-cache", required_argument, NULL, 0x106 },
+    { "jobs", required_argument, NULL, 'j' },
+
     // EoL
     { NULL, 0, NULL, 0 }
 };
@@ -96,12 +110,16 @@ static const char * log_path = "xen-crashdump-analyser.log";
 static const char * outdir_path = NULL;
 /// Output directory descriptor
 static int outdirfd = 0;
-/// Working directory descriptor
-static int workdirfd = 0;
 /// Log file descriptor
 static FILE * logfd = stderr;
 /// Should we dump the Xen structures ?
 static bool dump_structures = false;
+/// Backend to access the CORE crash file with.
+static Memory::Backend memory_backend = Memory::BACKEND_MMAP;
+/// Size of the memory frame cache, in bytes.
+static size_t cache_size = Memory::DEFAULT_CACHE_SIZE;
+/// Size of the pagetable page cache, in bytes.
+static size_t pt_cache_size = 2 << 20;
 
 /**
  * Convert a severity value to string
@@ -126,40 +144,94 @@ static const char * severity2str(int severity)
     }
 }
 
-/// Additional error file descriptor for logging.
-static FILE * additional_log = NULL;
-void set_additional_log(FILE * fd) { additional_log = fd; }
+/// Serialises writes to the log, and use of the message buffer.
+static Mutex log_lock;
+/// Additional writer for error logging, per thread.
+static __thread Writer * additional_log = NULL;
+void set_additional_log(Writer * w) { additional_log = w; }
+/// Stream to divert log file output into, per thread.
+static __thread FILE * log_capture = NULL;
+void set_log_capture(FILE * fd) { log_capture = fd; }
 
-void __log(int severity, const char * file, int line, const char * fnc, const char * fmt, ...)
+/**
+ * Deal with a failure to write to the log file.  Called with log_lock held.
+ * @param error errno from the failed write, or 0.
+ */
+static void log_write_failed(int error)
 {
-    static char buffer[256];
     static bool warn_once = true;
     static bool enospc_once = true;
+
+    // Warn directly to stderr on the first error writing to logfd
+    if ( warn_once && error )
+    {
+        warn_once = false;
+        fprintf(stderr, "Error writing to log file: %s\n", strerror(error));
+    }
+
+    /* In the case of ENOSPC, the chances are good that we still have
+       inodes free and the directory file still has space for entries,
+       so try and leave behind a 0-length file indicating that the
+       system is full, which a bugtool will pick up. */
+    if ( enospc_once && error == ENOSPC && outdirfd )
+    {
+        int tmp;
+        enospc_once = false;
+
+        // Poor mans `touch` in outdir, without any error checking.
+        tmp = openat(outdirfd, "fs-full", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if ( tmp != -1 )
+            close(tmp);
+    }
+}
+
+void __log(int severity, const char * file, int line, const char * fnc, const char * fmt, ...)
+{
+    char buffer[256];
     int log_write_error = 0;
     const char * sev_str = severity2str(severity);
     va_list vargs;
 
+    if ( severity > verbosity && severity != LOG_LEVEL_ERROR )
+        return;
+
+    // Format before taking the lock; the buffer is per call.
     va_start(vargs, fmt);
     vsnprintf(buffer, sizeof buffer - 1, fmt, vargs);
     va_end(vargs);
 
+    MutexLock guard(log_lock);
+
     if ( severity <= verbosity && logfd )
     {
+        FILE * out = log_capture ? log_capture : logfd;
+
         // Should we include __FILE__, __LINE__ and __fuct__ references?
         if ( verbosity >= LOG_LEVEL_DEBUG_EXTRA )
         {
-            if ( fprintf(logfd, "%s (%s:%d %s()) %s", sev_str, file, line, fnc, buffer) < 0 )
+            if ( fprintf(out, "%s (%s:%d %s()) %s", sev_str, file, line, fnc, buffer) < 0 )
                 log_write_error = errno;
-            if ( additional_log && severity <= LOG_LEVEL_WARN )
-                fprintf(additional_log, "%s (%s:%d %s()) %s", sev_str, file, line, fnc, buffer);
         }
         // or just the severity
         else
         {
-            if ( fprintf(logfd, "%s %s", sev_str, buffer) < 0 )
+            if ( fprintf(out, "%s %s", sev_str, buffer) < 0 )
                 log_write_error = errno;
-            if ( additional_log && severity <= LOG_LEVEL_WARN )
-                fprintf(additional_log, "%s %s", sev_str, buffer);
+        }
+
+        if ( additional_log && severity <= LOG_LEVEL_WARN )
+        {
+            // Write errors turn up again when the owner flushes the writer.
+            try
+            {
+                if ( verbosity >= LOG_LEVEL_DEBUG_EXTRA )
+                    additional_log->printf("%s (%s:%d %s()) %s", sev_str,
+                                           file, line, fnc, buffer);
+                else
+                    additional_log->printf("%s %s", sev_str, buffer);
+            }
+            catch ( const filewrite & )
+            {}
         }
     }
 
@@ -167,29 +239,15 @@ void __log(int severity, const char * file, int line, const char * fnc, const ch
     if ( severity == LOG_LEVEL_ERROR && (stderr != logfd))
         fprintf(stderr, "%s %s", sev_str, buffer);
 
-    // Warn directly to stderr on the first error writing to logfd
-    if ( warn_once && log_write_error )
-    {
-        warn_once = false;
-        fprintf(stderr, "Error writing to log file: %s\n", strerror(log_write_error));
-    }
+    log_write_failed(log_write_error);
+}
 
-    /* In the case of ENOSPC, the chances are good that we still have
-       inodes free and the directory file still has space for entries,
-       so try and leave behind a 0-length file indicating that the
-       system is full, which a bugtool will pick up. */
-    if ( enospc_once && log_write_error == ENOSPC && outdirfd && workdirfd )
-    {
-        FILE * tmp;
-        enospc_once = false;
+void write_log_capture(const char * data, size_t len)
+{
+    MutexLock guard(log_lock);
 
-        // Poor mans `touch` in outdir, without any error checking.
-        fchdir(outdirfd);
-        tmp = fopen("fs-full", "w");
-        if ( tmp )
-            fclose(tmp);
-        fchdir(workdirfd);
-    }
+    if ( logfd && len && fwrite(data, 1, len, logfd) != len )
+        log_write_failed(errno);
 }
 
 /// Atexit function to close the log file descriptor
@@ -208,27 +266,41 @@ void atexit_close_log( void )
 
 FILE * fopen_in_outdir(const char * path, const char * flags)
 {
-    FILE * fd = NULL;
-    int error;
+    FILE * stream;
+    int fd, oflags, error;
 
-    if ( -1 == fchdir( outdirfd ) )
+    /* Open relative to the output directory rather than changing into it,
+     * so files can be opened from several threads at once. */
+    switch ( flags[0] )
     {
-        LOG_ERROR("Failed to change to the output directory: %s\n",
-                  strerror(errno));
+    case 'r':
+        oflags = O_RDONLY;
+        break;
+    case 'w':
+        oflags = O_WRONLY | O_CREAT | O_TRUNC;
+        break;
+    case 'a':
+        oflags = O_WRONLY | O_CREAT | O_APPEND;
+        break;
+    default:
+        errno = EINVAL;
         return NULL;
     }
 
-    fd = fopen(path, flags);
-    error = errno;
+    if ( strchr(flags, '+') )
+        oflags = (oflags & ~O_ACCMODE) | O_RDWR;
+
+    if ( -1 == (fd = openat(outdirfd, path, oflags, 0666)) )
+        return NULL;
 
-    if ( -1 == fchdir( workdirfd ) )
+    if ( NULL == (stream = fdopen(fd, flags)) )
     {
-        LOG_ERROR("Failed to change to working directory: %s\n",
-                  strerror(errno));
+        error = errno;
+        close(fd);
+        errno = error;
     }
 
-    errno = error;
-    return fd;
+    return stream;
 }
 
 void fclose_failure(int err)
@@ -300,6 +372,15 @@ static void usage(char * argv0, FILE * stream = stdout)
     L_OPT("dump-structures", "Hex dump key structures.");
     putc('\n', stream);
 
+    fputs("Performance:\n", stream);
+    L_OPT("memory-backend", "Core file access, 'mmap' (default) or 'read'.");
+    L_OPT("cache-size", "Frame cache size in MiB for unmapped memory.  Defaults to 16.");
+    L_OPT("tlb-size", "Translations cached per pagetable.  Defaults to 64.");
+    L_OPT("pt-cache-size", "Pagetable page cache size in MiB for unmapped memory.  Defaults to 2.");
+    L_OPT("symbol-cache", "Directory to cache binary indexes of symbol files in.");
+    LS_OPT("jobs", 'j', "Worker threads, also used to parse symbol files, or 0 for one per cpu.  Defaults to 1.");
+    putc('\n', stream);
+
 #undef L_REQ
 #undef LS_REQ
 #undef L_OPT
@@ -308,6 +389,24 @@ static void usage(char * argv0, FILE * stream = stdout)
 /// @endcond
 }
 
+/**
+ * Parse a size in MiB.
+ * @param str String to parse.
+ * @param bytes Variable to fill with the size in bytes.
+ * @returns boolean indicating whether str was a valid size.
+ */
+static bool parse_mib(const char * str, size_t & bytes)
+{
+    char * end;
+    unsigned long mib = strtoul(str, &end, 10);
+
+    if ( *str == '\0' || *end != '\0' || mib > (SIZE_MAX >> 20) )
+        return false;
+
+    bytes = mib << 20;
+    return true;
+}
+
 /**
  * Parse the command line arguments.
  * @param argc Command line argument count
@@ -378,6 +477,62 @@ static bool parse_commandline(int argc, char ** argv)
             dump_structures = true;
             break;
 
+        case 0x102: // Memory backend
+            if ( ! Memory::parse_backend(optarg, memory_backend) )
+            {
+                printf("Unrecognised memory backend '%s'\n", optarg);
+                return false;
+            }
+            break;
+
+        case 0x103: // Frame cache size
+            if ( ! parse_mib(optarg, cache_size) )
+            {
+                printf("Invalid cache size '%s'\n", optarg);
+                return false;
+            }
+            break;
+
+        case 0x105: // Pagetable page cache size
+            if ( ! parse_mib(optarg, pt_cache_size) )
+            {
+                printf("Invalid pagetable cache size '%s'\n", optarg);
+                return false;
+            }
+            break;
+
+        case 0x104: // Pagetable translation cache size
+        {
+            char * end;
+            unsigned long entries = strtoul(optarg, &end, 10);
+
+            if ( *optarg == '\0' || *end != '\0' || entries > (1UL << 20) )
+            {
+                printf("Invalid TLB size '%s'\n", optarg);
+                return false;
+            }
+            Abstract::PageTable::set_tlb_size(entries);
+            break;
+        }
+
+        case 0x106: // Symbol index cache
+            SymbolTable::set_cache_dir(optarg);
+            break;
+
+        case 'j': // Worker threads
+        {
+            char * end;
+            unsigned long jobs = strtoul(optarg, &end, 10);
+
+            if ( *optarg == '\0' || *end != '\0' || jobs > 1024 )
+            {
+                printf("Invalid number of jobs '%s'\n", optarg);
+                return false;
+            }
+            WorkerPool::set_threads(jobs);
+            break;
+        }
+
         case 'h': // Help
         default: // Unrecognised
             usage(argv[0]);
@@ -440,14 +595,6 @@ int main(int argc, char ** argv)
             }
         }
 
-        // Get a handle to the current working directory
-        if ( 0 > (workdirfd = open(".", O_RDONLY )))
-        {
-            LOG_ERROR("Unable to open working directory \"%s\": %s\n",
-                      outdir_path, strerror(errno));
-            return EX_IOERR;
-        }
-
         // Get a handle to the output directory
         if ( 0 > (outdirfd = open( outdir_path, O_RDONLY )))
         {
@@ -492,6 +639,7 @@ int main(int argc, char ** argv)
 
         LOG_INFO("Xen Crashdump Analyser version %s\n", version_str);
         LOG_DEBUG("Opened log file '%s'\n", log_path);
+        LOG_DEBUG("Using %s hex formatting\n", hex_impl_name());
 
         // Log the output directory
         if ( NULL == ( path_buff = realpath( outdir_path, NULL )))
@@ -580,13 +728,15 @@ int main(int argc, char ** argv)
         }
 
         // Populate the memory regions
-        if ( ! memory.setup(core_path, elf) )
+        if ( ! memory.setup(core_path, elf, memory_backend, cache_size) )
         {
             LOG_ERROR("Failed to set up memory regions from crash file\n");
             SAFE_DELETE(elf);
             return EX_SOFTWARE;
         }
 
+        pagetable_walk_64_set_cache_size(pt_cache_size);
+
         // Set up the host structures
         if ( ! host.setup(elf) )
         {
@@ -622,6 +772,16 @@ int main(int argc, char ** argv)
         abort();
     }
 
+    memory.log_stats();
+    Abstract::PageTable::log_stats();
+    pagetable_walk_64_log_stats();
+    host.symtab.log_stats("Xen symbol lookup cache");
+    host.dom0_symtab.log_stats("Dom0 symbol lookup cache");
+
+    struct rusage usage;
+    if ( 0 == getrusage(RUSAGE_SELF, &usage) )
+        LOG_INFO("Peak RSS: %ld KiB\n", usage.ru_maxrss);
+
     LOG_INFO("COMPLETE\n");
     SAFE_FCLOSE(logfd);
     return EX_OK;
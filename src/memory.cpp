@@ -20,6 +20,7 @@
 
 #include "memory.hpp"
 #include "util/log.hpp"
+#include "util/macros.hpp"
 
 #ifndef _LARGEFILE64_SOURCE
 #define _LARGEFILE64_SOURCE
@@ -27,6 +28,11 @@
 
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <errno.h>
 
@@ -38,34 +44,292 @@
  * @author Andrew Cooper
  */
 
-/// Buffer size for intermediate operations on larger blocks
-static const ssize_t BUFFER_SIZE = 8192;
+/// Largest gap between file extents which read_many() will read through.
+static const uint64_t MERGE_GAP = 512;
+
+/// Maximum number of iovecs per preadv() from read_many().
+static const int MAX_IOVS = 64;
+
+/// Smallest extent which write_block_to_file() has the kernel copy.
+static const size_t KERNEL_COPY_MIN = 16 << 10;
+
+/**
+ * Part of a read_many() request which has to come from the core file.
+ */
+struct FileExtent
+{
+    /// Offset into the core file.
+    uint64_t offset;
+    /// Length of the extent.
+    size_t length;
+    /// Destination buffer.
+    char * dst;
+    /// Machine address, for error reporting.
+    maddr_t maddr;
+};
+
+/**
+ * Part of a read_many() request which comes from a single frame in the
+ * frame cache.
+ */
+struct FrameCopy
+{
+    /// Machine address of the frame.
+    maddr_t frame;
+    /// Offset of the frame in the core file.
+    uint64_t file_offset;
+    /// Offset of the piece into the frame.
+    size_t offset;
+    /// Length of the piece.
+    size_t length;
+    /// Destination buffer.
+    char * dst;
+    /// Cache buffer being filled for the frame, once claimed.
+    const char * src;
+};
+
+/**
+ * Comparison function for sorting FileExtents by file offset.
+ * @param lhs Left hand side.
+ * @param rhs Right hand side.
+ * @returns boolean.
+ */
+static bool extent_before(const FileExtent & lhs, const FileExtent & rhs)
+{
+    return lhs.offset < rhs.offset;
+}
+
+/**
+ * Comparison function for sorting FrameCopies by frame.
+ * @param lhs Left hand side.
+ * @param rhs Right hand side.
+ * @returns boolean.
+ */
+static bool copy_before(const FrameCopy & lhs, const FrameCopy & rhs)
+{
+    return lhs.frame < rhs.frame;
+}
+
+/**
+ * Read extents of the core file, sorted by file offset, merging adjacent
+ * or close extents into a single preadv().
+ * Throws memread if any read fails or is short.
+ * @param fd Core file descriptor.
+ * @param extents Extents to read.  Sorted in place.
+ */
+static void read_extents(const int fd, std::vector<FileExtent> & extents)
+{
+    std::sort(extents.begin(), extents.end(), extent_before);
+
+    // Scratch space for the gaps between extents.  Its contents are discarded.
+    char gap[MERGE_GAP];
+    struct iovec iov[MAX_IOVS];
+    size_t i = 0;
+
+    while ( i < extents.size() )
+    {
+        const FileExtent & first = extents[i];
+        uint64_t pos = first.offset;
+        ssize_t total = 0;
+        int nr_iov = 0;
+
+        /* Gather extents which are adjacent, or separated by a small gap, into
+         * a single preadv().  Overlapping extents start a new read. */
+        do
+        {
+            const FileExtent & e = extents[i];
+
+            if ( e.offset > pos )
+            {
+                iov[nr_iov].iov_base = gap;
+                iov[nr_iov].iov_len = e.offset - pos;
+                total += iov[nr_iov++].iov_len;
+            }
+
+            iov[nr_iov].iov_base = e.dst;
+            iov[nr_iov].iov_len = e.length;
+            total += iov[nr_iov++].iov_len;
+            pos = e.offset + e.length;
+            ++i;
+        } while ( i < extents.size() && nr_iov < MAX_IOVS - 1 &&
+                  extents[i].offset >= pos && extents[i].offset - pos <= MERGE_GAP );
+
+        ssize_t r = preadv64(fd, iov, nr_iov, first.offset);
+        if ( r == -1 || r != total )
+            throw memread(first.maddr, r, total, errno);
+    }
+}
+
+/**
+ * Read frames claimed in the frame cache, then copy the pending pieces out
+ * of them.  If the frames cannot be read, they are dropped from the cache
+ * and the pieces read directly, as Memory::read_cached() does.
+ * Throws memread if the direct reads fail.
+ * @param fd Core file descriptor.
+ * @param cache Frame cache holding the claimed frames.
+ * @param fills Extents reading each claimed frame.  Emptied.
+ * @param pending Pieces to copy out of the claimed frames.  Emptied.
+ */
+static void fill_frames(const int fd, FrameCache & cache, std::vector<FileExtent> & fills,
+                        std::vector<FrameCopy> & pending)
+{
+    if ( fills.empty() )
+        return;
+
+    try
+    {
+        read_extents(fd, fills);
+
+        for ( size_t x = 0; x < pending.size(); ++x )
+            std::memcpy(pending[x].dst, pending[x].src + pending[x].offset,
+                        pending[x].length);
+    }
+    catch ( const memread & )
+    {
+        std::vector<FileExtent> direct(pending.size());
+
+        for ( size_t x = 0; x < fills.size(); ++x )
+            cache.invalidate(fills[x].maddr / FrameCache::FRAME_SIZE);
+
+        for ( size_t x = 0; x < pending.size(); ++x )
+        {
+            direct[x].offset = pending[x].file_offset + pending[x].offset;
+            direct[x].length = pending[x].length;
+            direct[x].dst = pending[x].dst;
+            direct[x].maddr = pending[x].frame + pending[x].offset;
+        }
+
+        fills.clear();
+        pending.clear();
+        read_extents(fd, direct);
+        return;
+    }
+
+    fills.clear();
+    pending.clear();
+}
+
+MemRequest::MemRequest(const PageTable & pt, const vaddr_t & addr, void * dst, size_t len):
+    pt(&pt), addr(addr), dst(dst), len(len)
+{}
+
+MemView::MemView():
+    addr(0), data(NULL), length(0)
+{}
+
+bool MemView::covers(const vaddr_t & vaddr, const size_t n) const
+{
+    return vaddr >= this->addr && n <= this->length &&
+        vaddr - this->addr <= this->length - n;
+}
+
+const size_t MemSnapshot::INLINE_SIZE;
+
+MemSnapshot::MemSnapshot():
+    addr(0), size(0), data(NULL), heap(NULL), heap_size(0)
+{
+    this->data = this->storage;
+}
+
+MemSnapshot::~MemSnapshot()
+{
+    SAFE_DELETE_ARRAY(this->heap);
+}
+
+void MemSnapshot::read(const PageTable & pt, const vaddr_t & addr, const size_t size)
+{
+    this->size = 0;
+
+    if ( size <= INLINE_SIZE )
+        this->data = this->storage;
+    else
+    {
+        // Keep the largest buffer, so repeated use of one snapshot settles.
+        if ( size > this->heap_size )
+        {
+            SAFE_DELETE_ARRAY(this->heap);
+            this->heap_size = 0;
+            this->heap = new char[size];
+            this->heap_size = size;
+        }
+        this->data = this->heap;
+    }
+
+    memory.read_block_vaddr(pt, addr, this->data, size);
+    this->addr = addr;
+    this->size = size;
+}
+
+void MemSnapshot::get_block(const vaddr_t & offset, void * dst, const size_t n) const
+{
+    if ( offset > this->size || n > this->size - offset )
+        throw validate(this->addr + offset, "Field outside of structure snapshot");
+
+    std::memcpy(dst, this->data + offset, n);
+}
 
 MemRegion::MemRegion():
-    start(0), length(0), offset(0)
+    start(0), length(0), offset(0), map_base(NULL), map_length(0), data(NULL)
 {}
 
 MemRegion::MemRegion(const ElfProgHdr & hdr):
-    start(hdr.phys), length(hdr.size), offset(hdr.offset)
+    start(hdr.phys), length(hdr.size), offset(hdr.offset),
+    map_base(NULL), map_length(0), data(NULL)
 {}
 
 MemRegion::MemRegion(const MemRegion & rhs):
-    start(rhs.start), length(rhs.length), offset(rhs.offset)
+    start(rhs.start), length(rhs.length), offset(rhs.offset),
+    map_base(rhs.map_base), map_length(rhs.map_length), data(rhs.data)
 {}
 
+MemRegion & MemRegion::operator= (const MemRegion & rhs)
+{
+    this->start = rhs.start;
+    this->length = rhs.length;
+    this->offset = rhs.offset;
+    this->map_base = rhs.map_base;
+    this->map_length = rhs.map_length;
+    this->data = rhs.data;
+    return *this;
+}
+
 bool MemRegion::operator < (const MemRegion & rhs) const
 {
     return this->start < rhs.start;
 }
 
+/**
+ * Comparison function for looking up a machine address in the sorted
+ * vector of memory regions.
+ * @param addr Machine address.
+ * @param region Memory region.
+ * @returns boolean.
+ */
+static bool addr_before_region(const maddr_t & addr, const MemRegion & region)
+{
+    return addr < region.start;
+}
 
 
+
+const size_t Memory::DEFAULT_CACHE_SIZE;
+
 Memory::Memory():
-    regions(), finalised(false), fd(-1)
+    regions(), finalised(false), fd(-1), backend(BACKEND_READ), frame_cache(),
+    cache_lock()
 {}
 
 Memory::~Memory()
 {
+    for ( std::vector<MemRegion>::iterator it = this->regions.begin();
+          it != this->regions.end(); ++it )
+    {
+        if ( it->map_base && -1 == munmap(it->map_base, it->map_length) )
+            LOG_ERROR("munmap() failed: %s\n", strerror(errno));
+        it->map_base = NULL;
+        it->data = NULL;
+    }
+
     this -> regions . clear ( ) ;
 
     if ( this -> fd >= 0 )
@@ -76,8 +340,11 @@ Memory::~Memory()
     }
 }
 
-bool Memory::setup(const char * path, const Abstract::Elf * elf)
+bool Memory::setup(const char * path, const Abstract::Elf * elf, const Backend backend,
+                   const size_t cache_size)
 {
+    size_t nr_mapped = 0;
+
     if ( (this->fd = open(path, O_RDONLY, NULL)) == -1)
     {
         LOG_ERROR("open() failed: %s\n", strerror(errno));
@@ -92,6 +359,94 @@ bool Memory::setup(const char * path, const Abstract::Elf * elf)
 
     std::sort(this->regions.begin(), this->regions.end());
 
+    this->backend = backend;
+
+    if ( this->backend == BACKEND_MMAP )
+    {
+        struct stat64 st;
+        uint64_t file_size = -1ULL;
+
+        // Don't map beyond the end of a regular file, or we risk SIGBUS.
+        if ( 0 == fstat64(this->fd, &st) && S_ISREG(st.st_mode) )
+            file_size = st.st_size;
+
+        for ( std::vector<MemRegion>::iterator it = this->regions.begin();
+              it != this->regions.end(); ++it )
+            if ( this->map_region(*it, file_size) )
+                ++nr_mapped;
+
+        if ( nr_mapped == this->regions.size() )
+            LOG_INFO("Memory backend: mmap (all %zu regions mapped)\n", nr_mapped);
+        else
+            LOG_INFO("Memory backend: mmap (%zu of %zu regions mapped, "
+                     "falling back to read for the rest)\n",
+                     nr_mapped, this->regions.size());
+    }
+    else
+        LOG_INFO("Memory backend: read\n");
+
+    // The frame cache is only useful for regions we failed to map.
+    if ( nr_mapped < this->regions.size() && cache_size >= FrameCache::FRAME_SIZE )
+    {
+        if ( this->frame_cache.init(cache_size / FrameCache::FRAME_SIZE) )
+            LOG_INFO("Frame cache: %zu KiB\n",
+                     this->frame_cache.nr_frames * (FrameCache::FRAME_SIZE >> 10));
+        else
+            LOG_WARN("Unable to allocate %zu KiB frame cache.  Continuing without\n",
+                     cache_size >> 10);
+    }
+
+    return true;
+}
+
+void Memory::log_stats() const
+{
+    this->frame_cache.log_stats("Frame cache");
+}
+
+bool Memory::parse_backend(const char * name, Backend & backend)
+{
+    if ( ! std::strcmp(name, "read") )
+        backend = BACKEND_READ;
+    else if ( ! std::strcmp(name, "mmap") )
+        backend = BACKEND_MMAP;
+    else
+        return false;
+    return true;
+}
+
+bool Memory::map_region(MemRegion & region, const uint64_t file_size) const
+{
+    const uint64_t page_mask = (uint64_t)sysconf(_SC_PAGESIZE) - 1;
+
+    if ( ! region.length )
+        return false;
+
+    if ( region.offset > file_size || region.length > file_size - region.offset )
+    {
+        LOG_DEBUG("Region 0x%016"PRIx64"+0x%"PRIx64" extends beyond the end of "
+                  "the core file - not mapping\n", region.start, region.length);
+        return false;
+    }
+
+    // mmap() requires a page aligned file offset.
+    const uint64_t map_offset = region.offset & ~page_mask;
+    const uint64_t map_length = region.length + (region.offset - map_offset);
+
+    if ( map_length != (size_t)map_length )
+        return false;
+
+    void * base = mmap64(NULL, map_length, PROT_READ, MAP_PRIVATE, this->fd, map_offset);
+    if ( base == MAP_FAILED )
+    {
+        LOG_DEBUG("mmap() failed for region 0x%016"PRIx64"+0x%"PRIx64": %s\n",
+                  region.start, region.length, strerror(errno));
+        return false;
+    }
+
+    region.map_base = base;
+    region.map_length = map_length;
+    region.data = (const char *)base + (region.offset - map_offset);
     return true;
 }
 
@@ -101,12 +456,8 @@ ssize_t Memory::read_str(const maddr_t & addr, char * dst, ssize_t n) const
         return 0;
     dst[0] = 0;
 
-    this->seek(addr);
-
-    ssize_t num_read = read(this->fd, dst, n-1);
+    this->read_raw(addr, dst, n-1);
     dst[n] = 0;
-    if ( num_read == -1 || num_read != n-1)
-        throw memread(addr, num_read, n-1, errno);
     return strlen(dst);
 }
 
@@ -139,12 +490,136 @@ ssize_t Memory::read_str_vaddr(const PageTable & pt, const vaddr_t & vaddr, char
     }
 }
 
+void Memory::read_many(const MemRequest * reqs, const size_t nr) const
+{
+    std::vector<FileExtent> extents;
+    std::vector<FrameCopy> copies;
+    FileExtent ext;
+    FrameCopy copy;
+
+    for ( size_t x = 0; x < nr; ++x )
+    {
+        vaddr_t addr = reqs[x].addr;
+        char * dst = (char *)reqs[x].dst;
+        size_t n = reqs[x].len;
+
+        while ( n )
+        {
+            maddr_t maddr;
+            vaddr_t end;
+            reqs[x].pt->walk(addr, maddr, &end);
+
+            const size_t nr_bytes = std::min(n, (size_t)(end - addr + 1));
+            const MemRegion * region = this->lookup_region(maddr);
+
+            /* Pieces which have to come from the core file, directly or via
+             * the frame cache, are deferred.  Everything else (mapped, or an
+             * error) is read now. */
+            if ( ! region || region->data ||
+                 nr_bytes > region->length - (maddr - region->start) )
+            {
+                this->read_raw(maddr, dst, nr_bytes);
+                addr += nr_bytes; dst += nr_bytes; n -= nr_bytes;
+                continue;
+            }
+
+            for ( size_t done = 0; done < nr_bytes; )
+            {
+                const maddr_t cur = maddr + done;
+                const maddr_t frame = cur & ~(maddr_t)(FrameCache::FRAME_SIZE - 1);
+                const size_t len = std::min(nr_bytes - done,
+                                            (size_t)(frame + FrameCache::FRAME_SIZE - cur));
+
+                // Frames straddling the edge of a region are not cached.
+                if ( this->frame_cache.nr_frames && frame >= region->start &&
+                     frame + FrameCache::FRAME_SIZE <= region->start + region->length )
+                {
+                    copy.frame = frame;
+                    copy.file_offset = frame - region->start + region->offset;
+                    copy.offset = cur - frame;
+                    copy.length = len;
+                    copy.dst = dst + done;
+                    copy.src = NULL;
+                    copies.push_back(copy);
+                }
+                else
+                {
+                    ext.offset = cur - region->start + region->offset;
+                    ext.length = len;
+                    ext.dst = dst + done;
+                    ext.maddr = cur;
+                    extents.push_back(ext);
+                }
+
+                done += len;
+            }
+
+            addr += nr_bytes; dst += nr_bytes; n -= nr_bytes;
+        }
+    }
+
+    if ( ! copies.empty() )
+    {
+        std::vector<FileExtent> fills;
+        std::vector<FrameCopy> pending;
+        size_t touched = 0;
+
+        std::sort(copies.begin(), copies.end(), copy_before);
+
+        MutexLock guard(this->cache_lock);
+
+        for ( size_t x = 0; x < copies.size(); )
+        {
+            const maddr_t frame = copies[x].frame;
+            size_t y = x;
+
+            while ( y < copies.size() && copies[y].frame == frame )
+                ++y;
+
+            /* Claimed frames must not be evicted before they are filled.
+             * Eviction takes the least recently used frame, so is safe while
+             * fewer frames than the cache holds have been touched. */
+            if ( touched == this->frame_cache.nr_frames )
+            {
+                fill_frames(this->fd, this->frame_cache, fills, pending);
+                touched = 0;
+            }
+            ++touched;
+
+            const uint64_t mfn = frame / FrameCache::FRAME_SIZE;
+            const char * data = this->frame_cache.lookup(mfn);
+
+            if ( data )
+            {
+                for ( ; x < y; ++x )
+                    std::memcpy(copies[x].dst, data + copies[x].offset, copies[x].length);
+                continue;
+            }
+
+            char * fill = this->frame_cache.insert(mfn);
+
+            ext.offset = copies[x].file_offset;
+            ext.length = FrameCache::FRAME_SIZE;
+            ext.dst = fill;
+            ext.maddr = frame;
+            fills.push_back(ext);
+
+            for ( ; x < y; ++x )
+            {
+                copies[x].src = fill;
+                pending.push_back(copies[x]);
+            }
+        }
+
+        fill_frames(this->fd, this->frame_cache, fills, pending);
+    }
+
+    read_extents(this->fd, extents);
+}
+
 void Memory::read8(const maddr_t & addr, uint8_t & dst) const
 {
-    this->seek(addr);
-    ssize_t r = read(this->fd, &dst, 1);
-    if ( r == -1 || 1 != r )
-        throw memread(addr, r, 1, errno);
+    this->read_raw(addr, &dst, 1);
 }
 
 void Memory::read8_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint8_t & dst) const
@@ -157,10 +632,7 @@ void Memory::read8_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint8_t &
 
 void Memory::read16(const maddr_t & addr, uint16_t & dst) const
 {
-    this->seek(addr);
-    ssize_t r = read(this->fd, &dst, 2);
-    if ( r == -1 || 2 != r )
-        throw memread(addr, r, 2, errno);
+    this->read_raw(addr, &dst, 2);
 }
 
 void Memory::read16_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint16_t & dst) const
@@ -170,10 +642,7 @@ void Memory::read16_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint16_t
 
 void Memory::read32(const maddr_t & addr, uint32_t & dst) const
 {
-    this->seek(addr);
-    ssize_t r = read(this->fd, &dst, 4);
-    if ( r == -1 || 4 != r )
-        throw memread(addr, r, 4, errno);
+    this->read_raw(addr, &dst, 4);
 }
 
 void Memory::read32_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint32_t & dst) const
@@ -183,10 +652,7 @@ void Memory::read32_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint32_t
 
 void Memory::read64(const maddr_t & addr, uint64_t & dst) const
 {
-    this->seek(addr);
-    ssize_t r = read(this->fd, &dst, 8);
-    if ( r == -1 || 8 != r )
-        throw memread(addr, r, 8, errno);
+    this->read_raw(addr, &dst, 8);
 }
 
 void Memory::read64_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint64_t & dst) const
@@ -196,10 +662,7 @@ void Memory::read64_vaddr(const PageTable & pt, const vaddr_t & vaddr, uint64_t
 
 void Memory::read_block(const maddr_t & addr, char * dst, ssize_t n) const
 {
-    this->seek(addr);
-    ssize_t r = read(this->fd, dst, n);
-    if ( r == -1 || r != n )
-        throw memread(addr, r, n, errno);
+    this->read_raw(addr, dst, n);
 }
 
 void Memory::read_block_vaddr(const PageTable & pt, const vaddr_t & vaddr, char * dst, ssize_t n) const
@@ -231,98 +694,299 @@ void Memory::read_block_vaddr(const PageTable & pt, const vaddr_t & vaddr, char
 
 ssize_t Memory::write_block_to_file(const maddr_t & addr, FILE * file, ssize_t n) const
 {
-    ssize_t num_read, num_wrote, total_written = 0;
+    MemView view;
+    maddr_t cur = addr;
+    ssize_t total_written = 0;
+    bool kernel_copy = true;
 
-    if ( ! n )
-        return 0;
+    while ( n > 0 )
+    {
+        // Large extents are copied by the kernel, if it can.
+        if ( kernel_copy && n >= (ssize_t)KERNEL_COPY_MIN )
+        {
+            const MemRegion & region = this->find_region(cur);
+            const size_t length = (size_t)std::min((uint64_t)n,
+                                                   region.length - (cur - region.start));
+
+            // Anything already buffered by the stream must go first.
+            if ( length >= KERNEL_COPY_MIN && fflush(file) == 0 )
+            {
+                const size_t copied = this->copy_file(region, cur, fileno(file), length);
 
-    this->seek(addr);
+                total_written += copied;
+                n -= copied; cur += copied;
 
-    char * tmp = new char[BUFFER_SIZE];
+                if ( copied == length )
+                    continue;
 
-    while ( n > BUFFER_SIZE )
-    {
-        num_read = read(this->fd, tmp, BUFFER_SIZE);
-        if ( num_read == -1 || num_read != BUFFER_SIZE )
-        {
-            delete [] tmp;
-            throw memread(addr, num_read, BUFFER_SIZE, errno);
+                /* The kernel refused or fell short, so will likely do so
+                 * again.  Copy the rest through the stream. */
+                kernel_copy = false;
+            }
         }
 
-        num_wrote = fwrite(tmp, 1, num_read, file);
-        n -= num_wrote; total_written += num_wrote;
+        this->view_maddr(cur, n, view);
+
+        size_t num_wrote = fwrite(view.data, 1, view.length, file);
+        total_written += num_wrote;
+
+        if ( num_wrote != view.length )
+            break;
+
+        n -= num_wrote; cur += num_wrote;
+    }
+
+    return total_written;
+}
+
+ssize_t Memory::write_block_vaddr_to_file(const PageTable & pt, const vaddr_t & vaddr, FILE * file, ssize_t n) const
+{
+    vaddr_t cur = vaddr;
+    ssize_t total_written = 0;
 
-        if ( num_read != BUFFER_SIZE || num_wrote != num_read )
+    while ( n > 0 )
+    {
+        maddr_t maddr, next;
+        vaddr_t end;
+
+        pt.walk(cur, maddr, &end);
+        uint64_t length = std::min((uint64_t)n, end - cur + 1);
+
+        // Extend over following pages which are contiguous in machine memory.
+        try
         {
-            delete [] tmp;
-            return total_written;
+            while ( length < (uint64_t)n )
+            {
+                pt.walk(cur + length, next, &end);
+                if ( next != maddr + length )
+                    break;
+                length = std::min((uint64_t)n, end - cur + 1);
+            }
         }
+        catch ( const CommonError & )
+        {
+            // Raised again when the walk gets there.
+        }
+
+        ssize_t num_wrote = this->write_block_to_file(maddr, file, length);
+        total_written += num_wrote;
+
+        if ( num_wrote != (ssize_t)length )
+            break;
+
+        n -= num_wrote; cur += num_wrote;
     }
 
-    num_read = read(this->fd, tmp, n);
-    if ( num_read == -1 || num_read != n )
+    return total_written;
+}
+
+void Memory::view_maddr(const maddr_t & addr, const size_t n, MemView & view) const
+{
+    const MemRegion & region = this->find_region(addr);
+    const uint64_t roffset = addr - region.start;
+    size_t length = (size_t)std::min((uint64_t)n, region.length - roffset);
+
+    // Empty the view first, so it is left consistent if the read below throws.
+    view.length = 0;
+
+    if ( region.data )
+        view.data = region.data + roffset;
+    else
     {
-        delete [] tmp;
-        throw memread(addr, num_read, n, errno);
-    }
+        // Bounce a frame at a time, so cached frames are whole copies.
+        const size_t frame_left = FrameCache::FRAME_SIZE - (addr & (FrameCache::FRAME_SIZE - 1));
 
-    num_wrote = fwrite(tmp, 1, num_read, file);
-    n -= num_wrote; total_written += num_wrote;
+        length = std::min(length, frame_left);
+        this->read_raw(addr, view.bounce, length);
+        view.data = view.bounce;
+    }
 
-    delete [] tmp;
-    return total_written;
+    view.addr = addr;
+    view.length = length;
 }
 
-ssize_t Memory::write_block_vaddr_to_file(const PageTable & pt, const vaddr_t & vaddr, FILE * file, ssize_t n) const
+void Memory::view_vaddr(const PageTable & pt, const vaddr_t & vaddr, const size_t n, MemView & view) const
 {
     maddr_t maddr;
     vaddr_t end;
+
     pt.walk(vaddr, maddr, &end);
-    if ( vaddr + n - 1 <= end )
-        return this->write_block_to_file(maddr, file, n);
-    else
+    this->view_maddr(maddr, std::min((uint64_t)n, end - vaddr + 1), view);
+    view.addr = vaddr;
+}
+
+void Memory::read_view(MemView & view, const PageTable & pt, const vaddr_t & addr,
+                       void * dst, const size_t n, const vaddr_t & end) const
+{
+    if ( ! view.covers(addr, n) )
     {
-        LOG_DEBUG("Correcting for passing page boundary (vaddr %016"PRIx64", maddr %016"PRIx64
-                  ", end %016"PRIx64", n %zd)\n", vaddr, maddr, end, n);
-        vaddr_t addr = vaddr;
-        ssize_t index = 0;
-        do
+        this->view_vaddr(pt, addr, std::max((uint64_t)n, end - addr), view);
+
+        // The read straddles a page or region boundary.
+        if ( ! view.covers(addr, n) )
         {
-            ssize_t nr = std::min(n, (ssize_t)(end-addr+1));
-            LOG_DEBUG("Subwrite (vaddr %016"PRIx64", maddr %016"PRIx64", end %016"PRIx64
-                      ", index %zd, nr %zd, n %zd)\n", addr, maddr, end, index, nr, n);
-            ssize_t w = this->write_block_to_file(maddr, file, nr);
-            index += w;
-            if ( w != nr )
-                return index + w;
-            addr = end+1;
-            pt.walk(addr, maddr, &end);
-            n -= nr;
-        } while ( n );
-        return index;
+            this->read_block_vaddr(pt, addr, (char *)dst, n);
+            return;
+        }
     }
+
+    std::memcpy(dst, view.data + (addr - view.addr), n);
 }
 
-void Memory::seek(const maddr_t & addr) const
+const MemRegion * Memory::lookup_region(const maddr_t & addr) const
 {
-    for ( std::vector<MemRegion>::const_iterator it = this->regions.begin();
-          it != this->regions.end(); ++it)
+    // Find the last region starting at or below addr.
+    std::vector<MemRegion>::const_iterator it =
+        std::upper_bound(this->regions.begin(), this->regions.end(),
+                         addr, addr_before_region);
+
+    if ( it != this->regions.begin() )
     {
-        if ( it->start <= addr && addr < (it->start + it->length) )
+        --it;
+        if ( addr - it->start < it->length )
+            return &*it;
+    }
+
+    return NULL;
+}
+
+const MemRegion & Memory::find_region(const maddr_t & addr) const
+{
+    const MemRegion * region = this->lookup_region(addr);
+
+    if ( ! region )
+    {
+        LOG_WARN("Memory region for 0x%016"PRIx64" not found\n", addr);
+        throw memseek(addr, 0);
+    }
+
+    return *region;
+}
+
+const char * Memory::mapped_frame(const maddr_t & frame) const
+{
+    const MemRegion * region = this->lookup_region(frame);
+
+    if ( ! region || ! region->data ||
+         FrameCache::FRAME_SIZE > region->length - (frame - region->start) )
+        return NULL;
+
+    return region->data + (frame - region->start);
+}
+
+bool Memory::read_frame(const maddr_t & frame, char * dst) const
+{
+    const MemRegion * region = this->lookup_region(frame);
+
+    if ( ! region ||
+         FrameCache::FRAME_SIZE > region->length - (frame - region->start) )
+        return false;
+
+    return (ssize_t)FrameCache::FRAME_SIZE ==
+        pread64(this->fd, dst, FrameCache::FRAME_SIZE,
+                frame - region->start + region->offset);
+}
+
+void Memory::read_raw(const maddr_t & addr, void * dst, ssize_t n) const
+{
+    const MemRegion & region = this->find_region(addr);
+    const uint64_t roffset = addr - region.start;
+
+    /* Reads entirely within a region are a plain copy from the mapping or
+     * frame cache.  Anything else goes to the file, which matches the
+     * behaviour of the read backend. */
+    if ( (uint64_t)n <= region.length - roffset )
+    {
+        if ( region.data )
         {
-            int64_t foffset = addr - it->start + it->offset;
-            if ( (-(off64_t)1) == lseek64(this->fd, foffset, SEEK_SET) )
-            {
-                LOG_WARN("Failure to seek: maddr 0x%016"PRIx64", foffset 0x"PRIx64": %s\n",
-                         addr, foffset, strerror(errno));
-                throw memseek(addr, foffset);
-            }
+            std::memcpy(dst, region.data + roffset, n);
+            return;
+        }
+
+        if ( this->frame_cache.nr_frames )
+        {
+            this->read_cached(region, addr, (char *)dst, n);
             return;
         }
     }
 
-    LOG_WARN("Memory region for 0x%016"PRIx64" not found\n", addr);
-    throw memseek(addr, 0);
+    this->read_file(region, addr, dst, n);
+}
+
+void Memory::read_cached(const MemRegion & region, const maddr_t & addr, char * dst, ssize_t n) const
+{
+    MutexLock guard(this->cache_lock);
+    maddr_t cur = addr;
+
+    while ( n )
+    {
+        const maddr_t frame = cur & ~(maddr_t)(FrameCache::FRAME_SIZE - 1);
+        const ssize_t nr = std::min(n, (ssize_t)(frame + FrameCache::FRAME_SIZE - cur));
+        const char * data = this->get_frame(region, frame);
+
+        if ( data )
+            std::memcpy(dst, data + (cur - frame), nr);
+        else
+            this->read_file(region, cur, dst, nr);
+
+        cur += nr; dst += nr; n -= nr;
+    }
+}
+
+void Memory::read_file(const MemRegion & region, const maddr_t & addr, void * dst, ssize_t n) const
+{
+    ssize_t r = pread64(this->fd, dst, n, addr - region.start + region.offset);
+    if ( r == -1 || r != n )
+        throw memread(addr, r, n, errno);
+}
+
+size_t Memory::copy_file(const MemRegion & region, const maddr_t & addr, const int out,
+                         const size_t n) const
+{
+    off64_t offset = addr - region.start + region.offset;
+    size_t done = 0;
+    ssize_t r;
+
+#ifdef __NR_copy_file_range
+    while ( done < n &&
+            (r = syscall(__NR_copy_file_range, this->fd, &offset, out, NULL, n - done, 0)) > 0 )
+        done += r;
+
+    if ( done == n )
+        return done;
+#endif
+
+    // Older kernels, or files which copy_file_range() refuses.
+    while ( done < n && (r = sendfile64(out, this->fd, &offset, n - done)) > 0 )
+        done += r;
+
+    return done;
+}
+
+const char * Memory::get_frame(const MemRegion & region, const maddr_t & frame) const
+{
+    // Frames straddling the edge of a region are not cached.
+    if ( frame < region.start ||
+         frame + FrameCache::FRAME_SIZE > region.start + region.length )
+        return NULL;
+
+    const uint64_t mfn = frame / FrameCache::FRAME_SIZE;
+    const char * data = this->frame_cache.lookup(mfn);
+
+    if ( ! data )
+    {
+        char * fill = this->frame_cache.insert(mfn);
+        ssize_t r = pread64(this->fd, fill, FrameCache::FRAME_SIZE,
+                            frame - region.start + region.offset);
+        if ( r != (ssize_t)FrameCache::FRAME_SIZE )
+        {
+            this->frame_cache.invalidate(mfn);
+            return NULL;
+        }
+        data = fill;
+    }
+
+    return data;
 }
 
 /// Memory
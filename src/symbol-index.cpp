@@ -0,0 +1,422 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/symbol-index.cpp
+ * @author agent
+ *
+ * Binary symbol index.
+ *
+ * A parsed SymbolTable can be saved to a cache directory, keyed by a hash of
+ * the symbol file contents, and mapped back in on later runs against the
+ * same symbol file.  The index is a header followed by the arrays of the
+ * SymbolTable exactly as held in memory, which refer to each other by
+ * index.  Loading validates the arrays and points the table at them, with
+ * no parsing, sorting, hashing or copying.
+ *
+ * The index is written in native byte order, and is rejected by a build of
+ * the analyser with a different layout or set of xensyms.
+ */
+
+#include "symbol-table.hpp"
+#include "util/log.hpp"
+#include "util/misc.hpp"
+
+#include "util/xensym-common.hpp"
+#include "abstract/xensyms.hpp"
+#include "arch/x86_64/xensyms.hpp"
+
+#include <cstring>
+#include <cstdio>
+#include <climits>
+#include <new>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Magic at the start of an index.
+static const char INDEX_MAGIC[8] = { 'X', 'C', 'A', 'S', 'Y', 'M', 'I', 'X' };
+/// Index format version.
+static const uint32_t INDEX_VERSION = 2;
+/// Byte order marker.
+static const uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
+/// Binary index header.
+struct IndexHeader
+{
+    /// INDEX_MAGIC.
+    char magic[8];
+    /// INDEX_VERSION.
+    uint32_t version;
+    /// INDEX_BYTE_ORDER, as written.
+    uint32_t byte_order;
+    /// sizeof(IndexHeader).
+    uint32_t header_size;
+    /// Whether the symbol file was checked for offset symbols.
+    uint32_t offsets;
+    /// sizeof(Symbol).
+    uint32_t record_size;
+    /// sizeof(SymbolTable::NameSlot).
+    uint32_t slot_size;
+    /// Hash of the symbol file contents.
+    uint64_t source_hash;
+    /// Size of the symbol file.
+    uint64_t source_size;
+    /// Hash of the xensym names known to this build.
+    uint64_t xensym_sig;
+
+    /// Number of records.
+    uint64_t nr_records;
+    /// Number of code symbols.
+    uint64_t nr_text;
+    /// Number of name slots.
+    uint64_t nr_slots;
+    /// Number of xensym references.
+    uint64_t nr_xensyms;
+    /// Size of the name storage.
+    uint64_t arena_size;
+
+    /// Offset of the Symbol array.
+    uint64_t records_off;
+    /// Offset of the sorted code symbol record numbers.
+    uint64_t text_off;
+    /// Offset of the Eytzinger addresses.
+    uint64_t eytz_addr_off;
+    /// Offset of the Eytzinger ranks.
+    uint64_t eytz_rank_off;
+    /// Offset of the name index.
+    uint64_t names_off;
+    /// Offset of the xensym array.
+    uint64_t xensyms_off;
+    /// Offset of the name storage.
+    uint64_t arena_off;
+
+    /// value of '_stext' symbol.
+    uint64_t text_start;
+    /// value of '_etext' symbol.
+    uint64_t text_end;
+    /// value of '_sinittext' symbol.
+    uint64_t init_start;
+    /// value of '_einittext' symbol.
+    uint64_t init_end;
+    /// value of 'hypercall_page' symbol.
+    uint64_t hypercall_page;
+};
+
+/**
+ * Hash the names in a xensym list into a running hash.
+ * @param hash Running FNV-1a hash.
+ * @param xensyms Null terminated list of xensym containers.
+ * @returns Updated hash.
+ */
+static uint64_t hash_xensyms(uint64_t hash, const xensym_t * xensyms)
+{
+    // Include the terminators, so the boundaries between names count.
+    for ( const xensym_t * sym = &xensyms[0]; sym->name; ++sym )
+        hash = fnv1a(sym->name, std::strlen(sym->name) + 1, hash);
+    return hash;
+}
+
+/**
+ * Signature of the xensyms known to this build.  The index only records
+ * names which matched, so must be rebuilt if the lists change.
+ * @returns 64bit hash.
+ */
+static uint64_t xensym_signature()
+{
+    uint64_t hash = FNV1A_INIT;
+
+    hash = hash_xensyms(hash, Abstract::xensyms::xensyms);
+    hash = hash_xensyms(hash, x86_64::xensyms::xensyms);
+    return hash;
+}
+
+/**
+ * Check that an array lies within the index.
+ * @param size Size of the index.
+ * @param off Offset of the array.
+ * @param nr Number of elements.
+ * @param elem Size of an element.
+ * @returns boolean indicating whether the array is valid.
+ */
+static bool check_section(const uint64_t size, const uint64_t off,
+                          const uint64_t nr, const uint64_t elem)
+{
+    if ( off % 8 || off > size )
+        return false;
+    return nr <= (size - off) / elem;
+}
+
+/**
+ * Write bytes to an index, padded to 8 bytes.
+ * @param fd File descriptor.
+ * @param data Data to write.
+ * @param len Length of data.
+ * @returns boolean indicating success.
+ */
+static bool write_padded(int fd, const void * data, size_t len)
+{
+    static const char zeroes[8] = { 0 };
+    const char * ptr = static_cast<const char *>(data);
+    size_t pad = (8 - (len % 8)) % 8;
+
+    while ( len )
+    {
+        ssize_t r = write(fd, ptr, len);
+        if ( r < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return false;
+        }
+        ptr += r;
+        len -= r;
+    }
+
+    return pad == 0 || write(fd, zeroes, pad) == (ssize_t)pad;
+}
+
+/**
+ * Round a size up to 8 bytes.
+ * @param len Size.
+ * @returns Rounded size.
+ */
+static inline uint64_t align8(const uint64_t len)
+{
+    return (len + 7) & ~7ULL;
+}
+
+uint64_t SymbolTable::hash_contents(const char * data, const size_t size)
+{
+    // FNV-1a over 64bit words, as symbol files can be tens of megabytes.
+    uint64_t hash = FNV1A_INIT ^ size;
+    size_t x = 0;
+
+    for ( ; x + 8 <= size; x += 8 )
+    {
+        uint64_t word;
+        std::memcpy(&word, &data[x], 8);
+        hash ^= word;
+        hash *= FNV1A_PRIME;
+        hash ^= hash >> 29;
+    }
+
+    return fnv1a(&data[x], size - x, hash);
+}
+
+bool SymbolTable::load_index(const char * path, const uint64_t hash,
+                             const uint64_t size, const bool offsets)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if ( fd < 0 )
+        return false;
+
+    if ( fstat(fd, &st) || (uint64_t)st.st_size < sizeof(IndexHeader) )
+    {
+        close(fd);
+        return false;
+    }
+
+    void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( map == MAP_FAILED )
+        return false;
+
+    const char * base = static_cast<const char *>(map);
+    const uint64_t map_size = st.st_size;
+    const IndexHeader & hdr = *reinterpret_cast<const IndexHeader *>(base);
+
+    if ( std::memcmp(hdr.magic, INDEX_MAGIC, sizeof INDEX_MAGIC) ||
+         hdr.version != INDEX_VERSION ||
+         hdr.byte_order != INDEX_BYTE_ORDER ||
+         hdr.header_size != sizeof(IndexHeader) ||
+         hdr.record_size != sizeof(Symbol) ||
+         hdr.slot_size != sizeof(NameSlot) ||
+         hdr.offsets != (offsets ? 1U : 0U) ||
+         hdr.source_hash != hash ||
+         hdr.source_size != size ||
+         hdr.xensym_sig != xensym_signature() ||
+         hdr.nr_records > MAX_SYMBOLS ||
+         hdr.nr_text > hdr.nr_records ||
+         hdr.nr_slots == 0 ||
+         ( hdr.nr_slots & (hdr.nr_slots - 1) ) ||
+         hdr.nr_slots < 2 * hdr.nr_records ||
+         hdr.arena_size > 0xffffffffULL ||
+         ! check_section(map_size, hdr.records_off, hdr.nr_records, sizeof(Symbol)) ||
+         ! check_section(map_size, hdr.text_off, hdr.nr_text, sizeof(uint32_t)) ||
+         ! check_section(map_size, hdr.eytz_addr_off, hdr.nr_text + 1, sizeof(vaddr_t)) ||
+         ! check_section(map_size, hdr.eytz_rank_off, hdr.nr_text + 1, sizeof(uint32_t)) ||
+         ! check_section(map_size, hdr.names_off, hdr.nr_slots, sizeof(NameSlot)) ||
+         ! check_section(map_size, hdr.xensyms_off, hdr.nr_xensyms, sizeof(XensymRef)) ||
+         ! check_section(map_size, hdr.arena_off, hdr.arena_size, 1) )
+    {
+        munmap(map, map_size);
+        return false;
+    }
+
+    const Symbol * records = reinterpret_cast<const Symbol *>(base + hdr.records_off);
+    const uint32_t * text = reinterpret_cast<const uint32_t *>(base + hdr.text_off);
+    const uint32_t * eytz_rank = reinterpret_cast<const uint32_t *>(base + hdr.eytz_rank_off);
+    const NameSlot * names = reinterpret_cast<const NameSlot *>(base + hdr.names_off);
+    const XensymRef * xensyms = reinterpret_cast<const XensymRef *>(base + hdr.xensyms_off);
+    const char * arena = base + hdr.arena_off;
+    bool valid = hdr.arena_size == 0 || arena[hdr.arena_size - 1] == '\0';
+
+    // Everything refers to everything else by index, so check each one
+    // before anything is looked up.
+    for ( uint64_t x = 0; valid && x < hdr.nr_records; ++x )
+        valid = records[x].name < hdr.arena_size;
+    for ( uint64_t x = 0; valid && x < hdr.nr_text; ++x )
+        valid = text[x] < hdr.nr_records &&
+            ( x == 0 || records[text[x - 1]].address <= records[text[x]].address );
+    for ( uint64_t x = 1; valid && x <= hdr.nr_text; ++x )
+        valid = eytz_rank[x] < hdr.nr_text;
+    for ( uint64_t x = 0; valid && x < hdr.nr_slots; ++x )
+        valid = names[x].sym == NAME_EMPTY ||
+            (names[x].sym & ~NAME_AMBIGUOUS) < hdr.nr_records;
+    for ( uint64_t x = 0; valid && x < hdr.nr_xensyms; ++x )
+        valid = xensyms[x].name < hdr.arena_size;
+
+    if ( ! valid )
+    {
+        LOG_INFO("Ignoring corrupt symbol index %s\n", path);
+        munmap(map, map_size);
+        return false;
+    }
+
+    this->records = records;
+    this->nr_records = hdr.nr_records;
+    this->strings = arena;
+    this->strings_size = hdr.arena_size;
+    this->text = text;
+    this->nr_text = hdr.nr_text;
+    this->text_index = reinterpret_cast<const vaddr_t *>(base + hdr.eytz_addr_off);
+    this->text_rank = eytz_rank;
+    this->names = names;
+    this->nr_slots = hdr.nr_slots;
+
+    this->text_start = hdr.text_start;
+    this->text_end = hdr.text_end;
+    this->init_start = hdr.init_start;
+    this->init_end = hdr.init_end;
+    this->hypercall_page = hdr.hypercall_page;
+
+    // The table points into the mapping, so it lives as long as we do.
+    this->index_map = map;
+    this->index_map_size = map_size;
+
+    // Replay in file order, so duplicates are discarded as they were when
+    // the file was parsed.
+    const XensymIndex & index = xensym_index();
+    for ( uint64_t x = 0; x < hdr.nr_xensyms; ++x )
+    {
+        vaddr_t value = xensyms[x].value;
+        index.insert(&arena[xensyms[x].name], value);
+    }
+
+    return true;
+}
+
+bool SymbolTable::save_index(const char * path, const uint64_t hash,
+                             const uint64_t size, const bool offsets,
+                             const std::vector<XensymRef> & xensyms) const
+{
+    IndexHeader hdr;
+    char tmp_path[PATH_MAX];
+    bool ok;
+    int fd;
+
+    std::memset(&hdr, 0, sizeof hdr);
+    std::memcpy(hdr.magic, INDEX_MAGIC, sizeof INDEX_MAGIC);
+    hdr.version = INDEX_VERSION;
+    hdr.byte_order = INDEX_BYTE_ORDER;
+    hdr.header_size = sizeof hdr;
+    hdr.offsets = offsets ? 1 : 0;
+    hdr.record_size = sizeof(Symbol);
+    hdr.slot_size = sizeof(NameSlot);
+    hdr.source_hash = hash;
+    hdr.source_size = size;
+    hdr.xensym_sig = xensym_signature();
+
+    hdr.nr_records = this->nr_records;
+    hdr.nr_text = this->nr_text;
+    hdr.nr_slots = this->nr_slots;
+    hdr.nr_xensyms = xensyms.size();
+    hdr.arena_size = this->strings_size;
+
+    hdr.records_off = align8(sizeof hdr);
+    hdr.text_off = hdr.records_off + align8(this->nr_records * sizeof(Symbol));
+    hdr.eytz_addr_off = hdr.text_off + align8(this->nr_text * sizeof(uint32_t));
+    hdr.eytz_rank_off = hdr.eytz_addr_off + align8((this->nr_text + 1) * sizeof(vaddr_t));
+    hdr.names_off = hdr.eytz_rank_off + align8((this->nr_text + 1) * sizeof(uint32_t));
+    hdr.xensyms_off = hdr.names_off + align8(this->nr_slots * sizeof(NameSlot));
+    hdr.arena_off = hdr.xensyms_off + align8(xensyms.size() * sizeof(XensymRef));
+
+    hdr.text_start = this->text_start;
+    hdr.text_end = this->text_end;
+    hdr.init_start = this->init_start;
+    hdr.init_end = this->init_end;
+    hdr.hypercall_page = this->hypercall_page;
+
+    if ( 0 > mkdir(cache_dir, 0755) && errno != EEXIST )
+        return false;
+
+    // Write elsewhere and rename, so a concurrent run never maps half an index.
+    snprintf(tmp_path, sizeof tmp_path, "%s.%d", path, (int)getpid());
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+        return false;
+
+    ok = write_padded(fd, &hdr, sizeof hdr) &&
+        write_padded(fd, this->records, this->nr_records * sizeof(Symbol)) &&
+        write_padded(fd, this->text, this->nr_text * sizeof(uint32_t)) &&
+        write_padded(fd, this->text_index, (this->nr_text + 1) * sizeof(vaddr_t)) &&
+        write_padded(fd, this->text_rank, (this->nr_text + 1) * sizeof(uint32_t)) &&
+        write_padded(fd, this->names, this->nr_slots * sizeof(NameSlot)) &&
+        write_padded(fd, xensyms.empty() ? NULL : &xensyms[0],
+                     xensyms.size() * sizeof(XensymRef)) &&
+        write_padded(fd, this->strings, this->strings_size);
+
+    if ( close(fd) )
+        ok = false;
+
+    if ( ok && rename(tmp_path, path) )
+        ok = false;
+
+    if ( ! ok )
+        unlink(tmp_path);
+
+    return ok;
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -25,11 +25,18 @@
 #include "symbol-table.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
-#include "util/stdio-wrapper.hpp"
+#include "util/misc.hpp"
 
 #include <cstring>
 #include <cstdio>
 #include <algorithm>
+#include <new>
+#include <climits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "util/xensym-common.hpp"
 #include "abstract/xensyms.hpp"
@@ -107,101 +114,668 @@ static const char * hypercall_name(const unsigned int nr)
     return "out of range";
 }
 
-SymbolTable::SymbolTable():
-    can_print(false), has_hypercall(false), text_start(0), text_end(0), init_start(0),
-    init_end(0), hypercall_page(0), names(&SymbolTable::strcmp), symbols()
-{}
+/// Longest symbol name kept, as with the original "%127s" fscanf() parser.
+static const size_t MAX_NAME_LEN = 127;
+/// Smallest symbol file worth parsing on several threads.
+static const size_t PARALLEL_MIN_SIZE = 1 << 20;
+/// Smallest chunk of a symbol file worth handing to a thread.
+static const size_t PARALLEL_MIN_CHUNK = 256 << 10;
+/// Limit on the size of the string table, so names fit 32bit offsets.
+static const size_t MAX_STRINGS = 0xffffff00U;
 
-SymbolTable::~SymbolTable()
+/// Result of parsing part of a symbol file.
+enum ParseResult
+{
+    /// Parsed successfully.
+    PARSE_OK,
+    /// Malformed, as fscanf() would have found.
+    PARSE_BAD,
+    /// Not one symbol per line, so the chunk must be parsed serially.
+    PARSE_IRREGULAR,
+    /// Ran out of memory, so the file should be parsed serially.
+    PARSE_NOMEM
+};
+
+/// Chunk of a symbol file to be parsed, and its results.
+class ParseJob
+{
+public:
+    /// Constructor.
+    ParseJob():
+        start(NULL), end(NULL), strict(false), syms(), arena(), result(PARSE_OK)
+    {}
+
+    /// Start of the chunk.
+    const char * start;
+    /// End of the chunk.
+    const char * end;
+    /// Whether to insist on one symbol per line.
+    bool strict;
+    /// Symbols parsed, with names relative to arena.
+    std::vector<Symbol> syms;
+    /// Names parsed.
+    std::vector<char> arena;
+    /// Result.
+    ParseResult result;
+
+private:
+    // @cond EXCLUDE
+    ParseJob(const ParseJob &);
+    ParseJob & operator= (const ParseJob &);
+    // @endcond
+};
+
+/**
+ * Whitespace, as isspace() in the C locale.
+ * @param c Character.
+ * @returns boolean.
+ */
+static inline bool is_space(const char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Value of a hex digit.
+ * @param c Character.
+ * @returns Value, or -1 if c is not a hex digit.
+ */
+static inline int hex_value(const char c)
+{
+    if ( c >= '0' && c <= '9' )
+        return c - '0';
+    if ( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    if ( c >= 'A' && c <= 'F' )
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Skip whitespace between the fields of a symbol.
+ * @param p Position, updated.
+ * @param end End of the chunk.
+ * @param strict Whether a newline is irregular.
+ * @returns boolean indicating whether a newline was skipped when strict.
+ */
+static inline bool skip_field_space(const char *& p, const char * end, const bool strict)
+{
+    for ( ; p < end && is_space(*p); ++p )
+        if ( strict && *p == '\n' )
+            return false;
+    return true;
+}
+
+/**
+ * Parse a chunk of a symbol file.
+ *
+ * Without strict, this follows fscanf("%"SCNx64" %c %127s") exactly,
+ * treating the chunk as a stream of whitespace separated fields.  Running
+ * out of input part way through a symbol is the end of the file, while a
+ * bad address is an error.
+ *
+ * With strict, anything which isn't one symbol per line is reported as
+ * irregular, so that chunks which start at a line boundary parse to the
+ * same result as the stream as a whole would.
+ *
+ * @param job Chunk to parse.
+ * @returns Parse result, also stored in job.result.
+ */
+static ParseResult parse_chunk(ParseJob & job)
+{
+    const char * p = job.start, * end = job.end;
+    const ParseResult bad = job.strict ? PARSE_IRREGULAR : PARSE_BAD;
+    Symbol sym(0, 0, 0);
+
+    job.result = PARSE_OK;
+    job.syms.reserve((end - p) / 32);
+    job.arena.reserve((end - p) / 2);
+
+    while ( true )
+    {
+        while ( p < end && is_space(*p) )
+            ++p;
+        if ( p == end )
+            break;
+
+        bool negative = false;
+        if ( *p == '+' || *p == '-' )
+        {
+            negative = *p++ == '-';
+            if ( p == end )
+                break;
+        }
+        if ( end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+             hex_value(p[2]) >= 0 )
+            p += 2;
+
+        const char * digits = p;
+        bool overflow = false;
+        int d;
+        sym.address = 0;
+        for ( ; p < end && (d = hex_value(*p)) >= 0; ++p )
+        {
+            overflow |= sym.address >> 60;
+            sym.address = sym.address << 4 | d;
+        }
+
+        if ( p == digits )
+            return job.result = bad;
+        if ( overflow )
+            sym.address = -1ULL;
+        else if ( negative )
+            sym.address = -sym.address;
+
+        if ( ! skip_field_space(p, end, job.strict) )
+            return job.result = PARSE_IRREGULAR;
+        if ( p == end )
+            break;
+        sym.type = *p++;
+
+        if ( ! skip_field_space(p, end, job.strict) )
+            return job.result = PARSE_IRREGULAR;
+        if ( p == end )
+            break;
+
+        const char * name = p;
+        while ( p < end && ! is_space(*p) && (size_t)(p - name) < MAX_NAME_LEN )
+            ++p;
+
+        if ( job.strict )
+        {
+            // The rest of the line must be empty.
+            const char * q = p;
+            while ( q < end && is_space(*q) && *q != '\n' )
+                ++q;
+            if ( q < end && *q != '\n' )
+                return job.result = PARSE_IRREGULAR;
+        }
+
+        if ( job.arena.size() >= MAX_STRINGS )
+            return job.result = PARSE_BAD;
+
+        sym.name = (uint32_t)job.arena.size();
+        job.arena.insert(job.arena.end(), name, p);
+        job.arena.push_back(0);
+        job.syms.push_back(sym);
+    }
+
+    return job.result;
+}
+
+/**
+ * Parses the chunks of a symbol file on a WorkerPool.
+ */
+class ParseWork : public WorkerPool::Job
 {
-    for ( name_iter itt = this->names.begin();
-          itt != this->names.end(); ++itt)
-        delete itt->second;
-    this->names.clear();
-    this->symbols.clear();
+public:
+    /**
+     * Constructor.
+     * @param jobs Chunks to parse.
+     */
+    explicit ParseWork(ParseJob * jobs):
+        jobs(jobs)
+    {}
+
+    /**
+     * Parse a chunk.  Running out of memory is recorded in its result,
+     * as a worker must not throw.
+     * @param index Index into jobs.
+     */
+    virtual void run(const size_t index)
+    {
+        try
+        {
+            parse_chunk(this->jobs[index]);
+        }
+        catch ( const std::bad_alloc & )
+        {
+            this->jobs[index].result = PARSE_NOMEM;
+        }
+    }
+
+protected:
+    /// Chunks to parse.
+    ParseJob * jobs;
+
+private:
+    // @cond EXCLUDE
+    ParseWork(const ParseWork &);
+    ParseWork & operator= (const ParseWork &);
+    // @endcond
+};
+
+/**
+ * Parse a symbol file in line aligned chunks on several threads.
+ * @param data Symbol file contents.
+ * @param size Size of the symbol file.
+ * @param nr_threads Number of threads, at least 2.
+ * @param syms Symbols parsed.
+ * @param arena Names parsed.
+ * @returns boolean indicating whether the parallel parse worked.  If not,
+ * the file should be parsed serially.
+ */
+static bool parse_parallel(const char * data, const size_t size, const unsigned nr_threads,
+                           std::vector<Symbol> & syms, std::vector<char> & arena)
+{
+    ParseJob * jobs = NULL;
+    bool ok = true, nomem = false;
+
+    try
+    {
+        jobs = new ParseJob[nr_threads];
+
+        const char * end = data + size;
+        const char * start = data;
+
+        for ( unsigned x = 0; x < nr_threads; ++x )
+        {
+            const char * split = x == nr_threads - 1 ? end :
+                std::max(start, data + size / nr_threads * (x + 1));
+
+            while ( split < end && split[-1] != '\n' )
+                ++split;
+
+            jobs[x].start = start;
+            jobs[x].end = split;
+            jobs[x].strict = true;
+            start = split;
+        }
+
+        ParseWork work(jobs);
+        WorkerPool::run(work, nr_threads);
+
+        size_t nr_syms = 0, arena_size = 0;
+        for ( unsigned x = 0; x < nr_threads && ok; ++x )
+        {
+            nomem = jobs[x].result == PARSE_NOMEM;
+            ok = jobs[x].result == PARSE_OK;
+            nr_syms += jobs[x].syms.size();
+            arena_size += jobs[x].arena.size();
+        }
+
+        ok = ok && arena_size < MAX_STRINGS;
+
+        if ( ok )
+        {
+            syms.reserve(nr_syms);
+            arena.reserve(arena_size);
+
+            for ( unsigned x = 0; x < nr_threads; ++x )
+            {
+                const uint32_t base = (uint32_t)arena.size();
+
+                arena.insert(arena.end(), jobs[x].arena.begin(), jobs[x].arena.end());
+                for ( std::vector<Symbol>::iterator it = jobs[x].syms.begin();
+                      it != jobs[x].syms.end(); ++it )
+                {
+                    it->name += base;
+                    syms.push_back(*it);
+                }
+                // Give back each thread's memory as soon as it is merged.
+                std::vector<Symbol>().swap(jobs[x].syms);
+                std::vector<char>().swap(jobs[x].arena);
+            }
+        }
+    }
+    catch ( const std::bad_alloc & )
+    {
+        nomem = true;
+        ok = false;
+    }
+
+    if ( nomem )
+        LOG_WARN("Bad alloc parsing symbol file in parallel.  Trying serially\n");
+
+    if ( ! ok )
+    {
+        syms.clear();
+        arena.clear();
+    }
+
+    SAFE_DELETE_ARRAY(jobs);
+    return ok;
 }
 
-void SymbolTable::insert(Symbol * sym)
+/**
+ * Contents of a symbol file, mapped if possible and read otherwise.
+ */
+class FileContents
+{
+public:
+    /// Constructor.
+    FileContents():
+        data(NULL), size(0), map(NULL), buf()
+    {}
+
+    /// Destructor.
+    ~FileContents()
+    {
+        this->release();
+    }
+
+    /**
+     * Map or read a whole file.
+     * @param path Path of the file.
+     * @returns boolean indicating success.
+     */
+    bool open(const char * path)
+    {
+        struct stat st;
+        char tmp[65536];
+        ssize_t r;
+        int fd;
+
+        if ( -1 == (fd = ::open(path, O_RDONLY)) )
+            return false;
+
+        if ( 0 == fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0 )
+        {
+            void * m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if ( m != MAP_FAILED )
+            {
+                madvise(m, st.st_size, MADV_SEQUENTIAL);
+                close(fd);
+                this->map = m;
+                this->data = static_cast<const char *>(m);
+                this->size = st.st_size;
+                return true;
+            }
+        }
+
+        while ( (r = read(fd, tmp, sizeof tmp)) > 0 )
+            this->buf.insert(this->buf.end(), tmp, tmp + r);
+
+        close(fd);
+        this->data = this->buf.empty() ? NULL : &this->buf[0];
+        this->size = this->buf.size();
+        return r == 0;
+    }
+
+    /**
+     * Drop the contents, once parsed.
+     */
+    void release()
+    {
+        if ( this->map )
+            munmap(this->map, this->size);
+        this->map = NULL;
+        std::vector<char>().swap(this->buf);
+        this->data = NULL;
+    }
+
+    /// Contents.
+    const char * data;
+    /// Size of the contents.
+    size_t size;
+
+private:
+    /// Mapping, or NULL if the contents were read.
+    void * map;
+    /// Contents, if read.
+    std::vector<char> buf;
+
+    // @cond EXCLUDE
+    FileContents(const FileContents &);
+    FileContents & operator= (const FileContents &);
+    // @endcond
+};
+
+/// Sorts code symbol numbers by address, then by file order.
+class TextOrder
 {
-    if ( ! std::strcmp(sym->name, "_stext") )
-        this->text_start = sym->address;
-    else if ( ! std::strcmp(sym->name, "_etext") )
-        this->text_end = sym->address;
-    else if ( ! std::strcmp(sym->name, "_sinittext") )
-        this->init_start = sym->address;
-    else if ( ! std::strcmp(sym->name, "_einittext") )
-        this->init_end = sym->address;
-    else if ( ! std::strcmp(sym->name, "hypercall_page") )
-        this->hypercall_page = sym->address;
+public:
+    /**
+     * Constructor.
+     * @param records Symbols.
+     */
+    explicit TextOrder(const Symbol * records):
+        records(records)
+    {}
+
+    /**
+     * Comparison.
+     * @param lhs Left hand symbol number.
+     * @param rhs Right hand symbol number.
+     * @returns boolean.
+     */
+    bool operator() (const uint32_t lhs, const uint32_t rhs) const
+    {
+        if ( this->records[lhs].address != this->records[rhs].address )
+            return this->records[lhs].address < this->records[rhs].address;
+        return lhs < rhs;
+    }
 
-    if ( sym->type == 'T' ||
-         sym->type == 't' ||
-         sym->type == 'W' ||
-         sym->type == 'w' )
-        this->symbols.push_back(sym);
+private:
+    /// Symbols.
+    const Symbol * records;
+};
 
-    this->names.insert(name_pair(sym->name, sym));
+/**
+ * Pointer to the contents of a vector, or NULL if empty.
+ * @param vec Vector.
+ * @returns Pointer.
+ */
+template <typename T>
+static inline const T * vector_data(const std::vector<T> & vec)
+{
+    return vec.empty() ? NULL : &vec[0];
+}
+
+const uint32_t SymbolTable::NAME_EMPTY;
+const uint32_t SymbolTable::NAME_AMBIGUOUS;
+const uint32_t SymbolTable::MAX_SYMBOLS;
+const size_t SymbolTable::LOOKUP_CACHE_SIZE;
+const uint32_t SymbolTable::LOOKUP_EMPTY;
+const char * SymbolTable::cache_dir = NULL;
+
+SymbolTable::SymbolTable():
+    can_print(false), has_hypercall(false), text_start(0), text_end(0), init_start(0),
+    init_end(0), hypercall_page(0), records(NULL), nr_records(0), strings(NULL),
+    strings_size(0), text(NULL), nr_text(0), text_index(NULL), text_rank(NULL),
+    names(NULL), nr_slots(0), own_records(), own_strings(), own_text(),
+    own_text_index(), own_text_rank(), own_names(), lookup_cache(NULL), lookup_hits(0),
+    lookup_misses(0), lookup_lock(), index_map(NULL), index_map_size(0)
+{}
+
+SymbolTable::~SymbolTable()
+{
+    SAFE_DELETE_ARRAY(this->lookup_cache);
+
+    if ( this->index_map )
+        munmap(this->index_map, this->index_map_size);
 }
 
 const Symbol * SymbolTable::find(const char * name) const
 {
     // If we are asked for a symbol by name and more than one of said symbol
     // is present, give up.
-    if ( this->names.count(name) > 1 )
+    if ( ! this->nr_slots )
+        return NULL;
+
+    const NameSlot & slot = this->names[
+        this->name_slot(this->names, this->nr_slots, name, fnv1a_str(name))];
+
+    if ( slot.sym == NAME_EMPTY )
+        return NULL;
+
+    if ( slot.sym & NAME_AMBIGUOUS )
     {
         LOG_INFO("Found more than one symbol with name '%s'\n", name);
         return NULL;
     }
-    name_iter f = this->names.find(name);
-    return f == this->names.end() ? NULL : f->second;
+    return &this->records[slot.sym];
 }
 
 bool SymbolTable::parse(const char * file, bool offsets)
 {
-    FILE * fd = NULL;
-    vaddr_t addr;
-    char type;
-    char name[128];
-    int nr_read;
+    FileContents contents;
+    std::vector<XensymRef> xensyms;
+    unsigned nr_threads = WorkerPool::threads();
+    char index_path[PATH_MAX];
+    uint64_t hash = 0;
 
-    if ( NULL == (fd = fopen(file, "r")) )
+    if ( ! contents.open(file) )
         return false;
 
-    while ( true )
+    if ( cache_dir )
     {
-        nr_read = fscanf(fd, "%" SCNx64 " %c %127s", &addr, &type, name);
+        hash = hash_contents(contents.data, contents.size);
+        snprintf(index_path, sizeof index_path, "%s/%016"PRIx64"%s.symidx",
+                 cache_dir, hash, offsets ? "-offsets" : "");
 
-        if ( nr_read != 3 )
+        if ( this->load_index(index_path, hash, contents.size, offsets) )
         {
-            if ( feof(fd) )
-                break;
-            SAFE_FCLOSE(fd);
-            return false;
+            LOG_DEBUG("  Loaded %zu symbols from %s\n", this->nr_records, index_path);
+            this->finish_parse();
+            return true;
         }
+    }
 
-        if ( name[0] == '+' )
+    if ( contents.size < PARALLEL_MIN_SIZE )
+        nr_threads = 1;
+    nr_threads = std::min(nr_threads, (unsigned)(contents.size / PARALLEL_MIN_CHUNK) + 1);
+
+    if ( nr_threads < 2 ||
+         ! parse_parallel(contents.data, contents.size, nr_threads,
+                          this->own_records, this->own_strings) )
+    {
+        nr_threads = 1;
+        ParseJob job;
+        job.start = contents.data;
+        job.end = job.start + contents.size;
+        job.strict = false;
+        if ( parse_chunk(job) != PARSE_OK )
+            return false;
+        this->own_records.swap(job.syms);
+        this->own_strings.swap(job.arena);
+    }
+
+    const size_t source_size = contents.size;
+    contents.release();
+
+    LOG_DEBUG("  Parsed %zu symbols (%u thread%s)\n", this->own_records.size(),
+              nr_threads, nr_threads == 1 ? "" : "s");
+
+    if ( this->own_records.size() > MAX_SYMBOLS )
+    {
+        LOG_ERROR("Too many symbols in symbol file\n");
+        return false;
+    }
+
+    this->build(offsets, xensyms);
+
+    if ( cache_dir )
+    {
+        if ( this->save_index(index_path, hash, source_size, offsets, xensyms) )
+            LOG_DEBUG("  Saved symbol index %s\n", index_path);
+        else
+            LOG_INFO("Unable to save symbol index %s\n", index_path);
+    }
+
+    this->finish_parse();
+    return true;
+}
+
+void SymbolTable::build(const bool offsets, std::vector<XensymRef> & xensyms)
+{
+    const XensymIndex & index = xensym_index();
+    std::vector<Symbol> & recs = this->own_records;
+    size_t nr = 0;
+
+    // Note the xensyms, and drop the offsets, in file order.
+    for ( size_t x = 0; x < recs.size(); ++x )
+    {
+        const char * name = &this->own_strings[recs[x].name];
+        const bool offset = name[0] == '+';
+
+        if ( offsets )
         {
-            if ( offsets )
+            const char * xname = offset ? &name[1] : name;
+            vaddr_t value = recs[x].address;
+
+            if ( index.insert(xname, value) )
             {
-                insert_xensym(Abstract::xensyms::xensyms, &name[1], addr);
-                insert_xensym(x86_64::xensyms::xensyms, &name[1], addr);
+                XensymRef ref = { value, (uint32_t)(xname - &this->own_strings[0]), 0 };
+                xensyms.push_back(ref);
             }
         }
+
+        if ( offset )
+            continue;
+
+        if ( ! std::strcmp(name, "_stext") )
+            this->text_start = recs[x].address;
+        else if ( ! std::strcmp(name, "_etext") )
+            this->text_end = recs[x].address;
+        else if ( ! std::strcmp(name, "_sinittext") )
+            this->init_start = recs[x].address;
+        else if ( ! std::strcmp(name, "_einittext") )
+            this->init_end = recs[x].address;
+        else if ( ! std::strcmp(name, "hypercall_page") )
+            this->hypercall_page = recs[x].address;
+
+        recs[nr++] = recs[x];
+    }
+    recs.erase(recs.begin() + nr, recs.end());
+
+    // Code symbols, sorted by address.  Aliases keep their file order.
+    for ( size_t x = 0; x < recs.size(); ++x )
+        if ( recs[x].type == 'T' ||
+             recs[x].type == 't' ||
+             recs[x].type == 'W' ||
+             recs[x].type == 'w' )
+            this->own_text.push_back((uint32_t)x);
+
+    std::sort(this->own_text.begin(), this->own_text.end(), TextOrder(vector_data(recs)));
+
+    this->own_text_index.assign(this->own_text.size() + 1, 0);
+    this->own_text_rank.assign(this->own_text.size() + 1, 0);
+    this->fill_text_index(0, 1);
+
+    // Name index, kept at most half full.
+    size_t size = 1024;
+    while ( size < 2 * recs.size() )
+        size <<= 1;
+
+    NameSlot empty = { 0, NAME_EMPTY };
+    this->own_names.assign(size, empty);
+
+    this->attach_owned();
+
+    for ( size_t x = 0; x < recs.size(); ++x )
+    {
+        const char * name = &this->own_strings[recs[x].name];
+        const uint64_t hash = fnv1a_str(name);
+        NameSlot & slot = this->own_names[
+            this->name_slot(&this->own_names[0], size, name, hash)];
+
+        if ( slot.sym != NAME_EMPTY )
+            slot.sym |= NAME_AMBIGUOUS;
         else
         {
-            if ( offsets )
-            {
-                insert_xensym(Abstract::xensyms::xensyms, name, addr);
-                insert_xensym(x86_64::xensyms::xensyms, name, addr);
-            }
-            this->insert( new Symbol(addr, type, name) );
+            slot.hash = (uint32_t)hash;
+            slot.sym = (uint32_t)x;
         }
     }
+}
 
-    SAFE_FCLOSE(fd);
-
-    this->symbols.sort(&SymbolTable::addrcmp);
+void SymbolTable::attach_owned()
+{
+    this->records = vector_data(this->own_records);
+    this->nr_records = this->own_records.size();
+    this->strings = vector_data(this->own_strings);
+    this->strings_size = this->own_strings.size();
+    this->text = vector_data(this->own_text);
+    this->nr_text = this->own_text.size();
+    this->text_index = vector_data(this->own_text_index);
+    this->text_rank = vector_data(this->own_text_rank);
+    this->names = vector_data(this->own_names);
+    this->nr_slots = this->own_names.size();
+}
 
+void SymbolTable::finish_parse()
+{
     if ( this->text_start == 0 ||
          this->text_end == 0 ||
          this->init_start == 0 ||
@@ -227,104 +801,142 @@ bool SymbolTable::parse(const char * file, bool offsets)
         LOG_DEBUG("  hypercall page:      0x%016"PRIx64"->0x%016"PRIx64"\n",
                   this->hypercall_page, this->hypercall_page+4096);
     }
-
-    return true;
 }
 
-int SymbolTable::print_symbol64(FILE * o, const vaddr_t & addr, bool brackets) const
+int SymbolTable::print_symbol64(Writer & o, const vaddr_t & addr, bool brackets) const
 {
-    int len = 0;
+    const Symbol * before, * after;
 
-    if ( ! this->can_print )
+    if ( ! this->is_text_symbol(addr) )
         return 0;
 
-    if ( ! this->is_text_symbol(addr) )
+    if ( ! this->lookup_text_symbol(addr, before, after) )
         return 0;
 
-    SymbolTable::const_list_iter after
-        = std::upper_bound(this->symbols.begin(), this->symbols.end(), addr, &SymbolTable::symcmp);
+    return this->print_symbol(o, addr, before, after, brackets, 16);
+}
+
+int SymbolTable::print_symbol32(Writer & o, const vaddr_t & addr, bool brackets) const
+{
+    const Symbol * before, * after;
+
+    if ( ! this->is_text_symbol(addr) )
+        return 0;
 
-    if ( after == this->symbols.begin() ||
-         after == this->symbols.end() )
+    if ( ! this->lookup_text_symbol(addr, before, after) )
         return 0;
 
-    SymbolTable::const_list_iter before = after;
-    before--;
+    return this->print_symbol(o, addr, before, after, brackets, 8);
+}
 
-    if ( (*before)->address <= addr && (*after)->address > addr )
+int SymbolTable::print_symbols64(Writer & o, const vaddr_t * addrs, const size_t nr) const
+{
+    return this->print_symbols(o, addrs, nr, 16);
+}
+
+int SymbolTable::print_symbols32(Writer & o, const vaddr_t * addrs, const size_t nr) const
+{
+    return this->print_symbols(o, addrs, nr, 8);
+}
+
+int SymbolTable::print_symbol(Writer & o, const vaddr_t & addr, const Symbol * before,
+                              const Symbol * after, bool brackets, const int width) const
+{
+    int len = 0;
+
+    if ( before->address <= addr && after->address > addr )
     {
-        len += FPUTS("\t ", o);
-        if ( brackets )
-            len += FPRINTF(o, "[%016"PRIx64"]", addr);
-        else
-            len += FPRINTF(o, " %016"PRIx64" ", addr);
+        len += o.puts("\t ");
+        len += o.putc(brackets ? '[' : ' ');
+        len += o.hex(addr, width);
+        len += o.putc(brackets ? ']' : ' ');
 
-        len += FPRINTF(o, " %s+%#"PRIx64"/%#"PRIx64,
-                       (*before)->name,
-                       addr - (*before)->address,
-                       (*after)->address - (*before)->address );
+        len += o.putc(' ');
+        len += o.puts(this->name(before));
+        len += o.putc('+');
+        len += o.hex_prefixed(addr - before->address);
+        len += o.putc('/');
+        len += o.hex_prefixed(after->address - before->address);
 
-        if ( ! std::strcmp((*before)->name, "hypercall_page") )
+        if ( ! std::strcmp(this->name(before), "hypercall_page") )
         {
-            unsigned int nr = (unsigned int)((addr - (*before)->address)/32);
-            len += FPRINTF(o, " (%d, %s)", nr, hypercall_name(nr));
+            unsigned int nr = (unsigned int)((addr - before->address)/32);
+            len += o.printf(" (%d, %s)", nr, hypercall_name(nr));
         }
 
-        len += FPUTS("\n", o);
+        len += o.putc('\n');
     }
     else
         LOG_WARN("Strange resulting iterators printing symbol 0x%016"PRIx64"\n", addr);
 
     return len;
 }
-int SymbolTable::print_symbol32(FILE * o, const vaddr_t & addr, bool brackets) const
+
+int SymbolTable::print_symbols(Writer & o, const vaddr_t * addrs, const size_t nr,
+                               const int width) const
 {
+    std::vector<std::pair<vaddr_t, size_t> > order;
+    std::vector<uint32_t> ranks;
     int len = 0;
 
-    if ( ! this->can_print )
-        return 0;
+    ranks.assign(nr, 0);
 
-    if ( ! this->is_text_symbol(addr) )
-        return 0;
+    // Most words on a stack aren't code addresses, and most of those which
+    // are have been seen on other stacks.
+    for ( size_t x = 0; x < nr; ++x )
+    {
+        size_t rank;
 
-    SymbolTable::const_list_iter after
-        = std::upper_bound(this->symbols.begin(), this->symbols.end(), addr, &SymbolTable::symcmp);
+        if ( ! this->is_text_symbol(addrs[x]) )
+            continue;
 
-    if ( after == this->symbols.begin() ||
-         after == this->symbols.end() )
-        return 0;
+        if ( this->cache_lookup(addrs[x], rank) )
+        {
+            if ( rank > 0 && rank < this->nr_text )
+                ranks[x] = (uint32_t)rank;
+        }
+        else
+            order.push_back(std::make_pair(addrs[x], x));
+    }
 
-    SymbolTable::const_list_iter before = after;
-    before--;
+    std::sort(order.begin(), order.end());
 
-    if ( (*before)->address <= addr && (*after)->address > addr )
+    // Merge the sorted addresses against the sorted code symbols.  Walk
+    // forwards from the previous result while that is quick, and search
+    // afresh across large gaps.
+    size_t rank = order.empty() ? 0 : this->upper_rank(order[0].first);
+    for ( size_t x = 0; x < order.size(); ++x )
     {
-        len += FPUTS("\t ", o);
-        if ( brackets )
-            len += FPRINTF(o, "[%08"PRIx64"]", addr);
-        else
-            len += FPRINTF(o, " %08"PRIx64" ", addr);
-
-        len += FPRINTF(o, " %s+%#"PRIx64"/%#"PRIx64,
-                       (*before)->name,
-                       addr - (*before)->address,
-                       (*after)->address - (*before)->address );
+        const vaddr_t addr = order[x].first;
+        unsigned steps = 0;
 
-        if ( ! std::strcmp((*before)->name, "hypercall_page") )
+        while ( rank < this->nr_text &&
+                this->records[this->text[rank]].address <= addr )
         {
-            unsigned int nr = (unsigned int)((addr - (*before)->address)/32);
-            len += FPRINTF(o, " (%d, %s)", nr, hypercall_name(nr));
+            if ( ++steps > 16 )
+            {
+                rank = this->upper_rank(addr);
+                break;
+            }
+            ++rank;
         }
 
-        len += FPUTS("\n", o);
+        this->cache_insert(addr, rank);
+
+        // 0 marks no symbol either side.
+        if ( rank > 0 && rank < this->nr_text )
+            ranks[order[x].second] = (uint32_t)rank;
     }
-    else
-        LOG_WARN("Strange resulting iterators printing symbol 0x%016"PRIx64"\n", addr);
+
+    for ( size_t x = 0; x < nr; ++x )
+        if ( ranks[x] )
+            len += this->print_symbol(o, addrs[x], &this->records[this->text[ranks[x] - 1]],
+                                      &this->records[this->text[ranks[x]]], false, width);
 
     return len;
 }
 
-int SymbolTable::print_text_symbol(FILE * o, const vaddr_t & addr) const
+int SymbolTable::print_text_symbol(Writer & o, const vaddr_t & addr) const
 {
     int len = 0;
 
@@ -334,22 +946,18 @@ int SymbolTable::print_text_symbol(FILE * o, const vaddr_t & addr) const
     if ( ! this->is_text_symbol(addr) )
         return 0;
 
-    SymbolTable::const_list_iter after
-        = std::upper_bound(this->symbols.begin(), this->symbols.end(), addr, &SymbolTable::symcmp);
+    const Symbol * before, * after;
 
-    if ( after == this->symbols.begin() ||
-         after == this->symbols.end() )
+    if ( ! this->lookup_text_symbol(addr, before, after) )
         return 0;
 
-    SymbolTable::const_list_iter before = after;
-    before--;
-
-    if ( (*before)->address <= addr && (*after)->address > addr )
+    if ( before->address <= addr && after->address > addr )
     {
-        len += FPRINTF(o, "%s+%#"PRIx64"/%#"PRIx64,
-                       (*before)->name,
-                       addr - (*before)->address,
-                       (*after)->address - (*before)->address );
+        len += o.puts(this->name(before));
+        len += o.putc('+');
+        len += o.hex_prefixed(addr - before->address);
+        len += o.putc('/');
+        len += o.hex_prefixed(after->address - before->address);
     }
     else
         LOG_WARN("Strange resulting iterators printing symbol 0x%016"PRIx64"\n", addr);
@@ -378,19 +986,176 @@ bool SymbolTable::is_text_symbol(const vaddr_t & addr) const
     return false;
 }
 
-bool SymbolTable::strcmp(const char * lhs, const char * rhs)
+void SymbolTable::add_text_ranges(StackScanner & scan) const
+{
+    // Must match is_text_symbol().
+    if ( ! this->can_print )
+        return;
+
+    scan.add_range(this->text_start, this->text_end, StackScanner::TEXT);
+    scan.add_range(this->init_start, this->init_end, StackScanner::TEXT);
+
+    if ( this->has_hypercall )
+        scan.add_range(this->hypercall_page, this->hypercall_page + 4096ULL,
+                       StackScanner::TEXT);
+}
+
+void SymbolTable::set_cache_dir(const char * dir)
+{
+    cache_dir = dir;
+}
+
+const XensymIndex & SymbolTable::xensym_index()
+{
+    static XensymIndex index;
+    static bool built = false;
+
+    if ( ! built )
+    {
+        index.add(Abstract::xensyms::xensyms);
+        index.add(x86_64::xensyms::xensyms);
+        built = true;
+    }
+    return index;
+}
+
+size_t SymbolTable::name_slot(const NameSlot * slots, const size_t nr_slots,
+                              const char * name, const uint64_t hash) const
+{
+    const size_t mask = nr_slots - 1;
+    size_t x = hash & mask;
+
+    while ( slots[x].sym != NAME_EMPTY &&
+            ( slots[x].hash != (uint32_t)hash ||
+              std::strcmp(this->name(&this->records[slots[x].sym & ~NAME_AMBIGUOUS]),
+                          name) ) )
+        x = (x + 1) & mask;
+
+    return x;
+}
+
+size_t SymbolTable::fill_text_index(size_t next, const size_t k)
+{
+    if ( k < this->own_text_index.size() )
+    {
+        next = this->fill_text_index(next, 2 * k);
+        this->own_text_index[k] = this->own_records[this->own_text[next]].address;
+        this->own_text_rank[k] = (uint32_t)next++;
+        next = this->fill_text_index(next, 2 * k + 1);
+    }
+    return next;
+}
+
+size_t SymbolTable::upper_rank(const vaddr_t & addr) const
+{
+    const size_t nr = this->nr_text + 1;
+    size_t k = 1;
+
+    if ( ! this->text_index )
+        return this->nr_text;
+
+    // Descend to a leaf, going right whenever the node is not above addr.
+    while ( k < nr )
+        k = 2 * k + (this->text_index[k] <= addr);
+
+    // Undo the right turns since the last left turn, which was at the
+    // first node above addr.  k becomes 0 if there is no such node.
+    k >>= __builtin_ffsl(~k);
+
+    return k ? this->text_rank[k] : this->nr_text;
+}
+
+bool SymbolTable::lookup_text_symbol(const vaddr_t & addr, const Symbol *& before,
+                                     const Symbol *& after) const
+{
+    size_t rank;
+
+    if ( ! this->cache_lookup(addr, rank) )
+    {
+        rank = this->upper_rank(addr);
+        this->cache_insert(addr, rank);
+    }
+
+    if ( rank == 0 || rank >= this->nr_text )
+        return false;
+
+    before = &this->records[this->text[rank - 1]];
+    after = &this->records[this->text[rank]];
+    return true;
+}
+
+bool SymbolTable::cache_lookup(const vaddr_t & addr, size_t & rank) const
+{
+    MutexLock guard(this->lookup_lock);
+
+    if ( ! this->lookup_cache )
+    {
+        // If we can't allocate the cache, look up uncached.
+        this->lookup_cache = new (std::nothrow) LookupEntry[LOOKUP_CACHE_SIZE];
+        if ( ! this->lookup_cache )
+            return false;
+
+        for ( size_t x = 0; x < LOOKUP_CACHE_SIZE; ++x )
+            this->lookup_cache[x].rank = LOOKUP_EMPTY;
+    }
+
+    const LookupEntry & e = this->lookup_cache[
+        (addr * 0x9E3779B97F4A7C15ULL) >> 32 & (LOOKUP_CACHE_SIZE - 1)];
+
+    if ( e.rank != LOOKUP_EMPTY && e.addr == addr )
+    {
+        ++this->lookup_hits;
+        rank = e.rank;
+        return true;
+    }
+
+    ++this->lookup_misses;
+    return false;
+}
+
+void SymbolTable::cache_insert(const vaddr_t & addr, const size_t rank) const
 {
-    return std::strcmp(lhs, rhs) < 0;
+    MutexLock guard(this->lookup_lock);
+
+    if ( ! this->lookup_cache )
+        return;
+
+    LookupEntry & e = this->lookup_cache[
+        (addr * 0x9E3779B97F4A7C15ULL) >> 32 & (LOOKUP_CACHE_SIZE - 1)];
+
+    e.addr = addr;
+    e.rank = (uint32_t)rank;
 }
 
-bool SymbolTable::addrcmp(const Symbol * lhs, const Symbol * rhs)
+void SymbolTable::log_stats(const char * name) const
 {
-    return lhs->address < rhs->address;
+    if ( ! this->lookup_cache )
+        return;
+
+    LOG_INFO("%s: %"PRIu64" hits, %"PRIu64" misses\n",
+             name, this->lookup_hits, this->lookup_misses);
 }
 
-bool SymbolTable::symcmp(const vaddr_t & addr, const Symbol * sym)
+const size_t SymbolBatch::BATCH_SIZE;
+
+SymbolBatch::SymbolBatch(const SymbolTable & symtab, Writer & stream, bool wide):
+    symtab(symtab), stream(stream), wide(wide), nr(0)
+{}
+
+int SymbolBatch::add(const vaddr_t & addr)
 {
-    return addr < sym->address;
+    this->addrs[this->nr++] = addr;
+    return this->nr == BATCH_SIZE ? this->flush() : 0;
+}
+
+int SymbolBatch::flush()
+{
+    const size_t nr = this->nr;
+
+    this->nr = 0;
+    if ( this->wide )
+        return this->symtab.print_symbols64(this->stream, this->addrs, nr);
+    return this->symtab.print_symbols32(this->stream, this->addrs, nr);
 }
 
 /*
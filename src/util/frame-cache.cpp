@@ -0,0 +1,211 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+#include "util/frame-cache.hpp"
+#include "util/log.hpp"
+#include "util/macros.hpp"
+
+#include <new>
+
+/**
+ * @file src/util/frame-cache.cpp
+ * @author agent
+ */
+
+const size_t FrameCache::FRAME_SIZE;
+const uint32_t FrameCache::NONE;
+
+FrameCache::FrameCache():
+    nr_frames(0), hits(0), misses(0), evictions(0),
+    slots(NULL), data(NULL), buckets(NULL), nr_buckets(0),
+    nr_used(0), free_head(NONE), lru_head(NONE), lru_tail(NONE)
+{}
+
+FrameCache::~FrameCache()
+{
+    SAFE_DELETE_ARRAY(this->slots);
+    SAFE_DELETE_ARRAY(this->data);
+    SAFE_DELETE_ARRAY(this->buckets);
+}
+
+bool FrameCache::init(const size_t nr_frames)
+{
+    if ( ! nr_frames || nr_frames >= NONE )
+        return false;
+
+    this->nr_buckets = 1;
+    while ( this->nr_buckets < nr_frames )
+        this->nr_buckets <<= 1;
+
+    this->slots = new (std::nothrow) Slot[nr_frames];
+    this->data = new (std::nothrow) char[nr_frames * FRAME_SIZE];
+    this->buckets = new (std::nothrow) uint32_t[this->nr_buckets];
+
+    if ( ! this->slots || ! this->data || ! this->buckets )
+    {
+        SAFE_DELETE_ARRAY(this->slots);
+        SAFE_DELETE_ARRAY(this->data);
+        SAFE_DELETE_ARRAY(this->buckets);
+        this->nr_buckets = 0;
+        return false;
+    }
+
+    for ( uint32_t x = 0; x < this->nr_buckets; ++x )
+        this->buckets[x] = NONE;
+
+    this->nr_frames = nr_frames;
+    return true;
+}
+
+const char * FrameCache::lookup(const uint64_t & key)
+{
+    if ( ! this->nr_frames )
+        return NULL;
+
+    for ( uint32_t s = this->buckets[this->bucket(key)]; s != NONE;
+          s = this->slots[s].hash_next )
+    {
+        if ( this->slots[s].key == key )
+        {
+            ++this->hits;
+            if ( s != this->lru_head )
+            {
+                this->lru_remove(s);
+                this->lru_push(s);
+            }
+            return &this->data[s * FRAME_SIZE];
+        }
+    }
+
+    ++this->misses;
+    return NULL;
+}
+
+char * FrameCache::insert(const uint64_t & key)
+{
+    uint32_t s;
+
+    if ( ! this->nr_frames )
+        return NULL;
+
+    if ( this->free_head != NONE )
+    {
+        s = this->free_head;
+        this->free_head = this->slots[s].hash_next;
+    }
+    else if ( this->nr_used < this->nr_frames )
+        s = this->nr_used++;
+    else
+    {
+        s = this->lru_tail;
+        this->lru_remove(s);
+        this->unhash(s);
+        ++this->evictions;
+    }
+
+    uint32_t b = this->bucket(key);
+    this->slots[s].key = key;
+    this->slots[s].hash_next = this->buckets[b];
+    this->buckets[b] = s;
+    this->lru_push(s);
+
+    return &this->data[s * FRAME_SIZE];
+}
+
+void FrameCache::invalidate(const uint64_t & key)
+{
+    if ( ! this->nr_frames )
+        return;
+
+    for ( uint32_t s = this->buckets[this->bucket(key)]; s != NONE;
+          s = this->slots[s].hash_next )
+    {
+        if ( this->slots[s].key == key )
+        {
+            this->lru_remove(s);
+            this->unhash(s);
+            this->slots[s].hash_next = this->free_head;
+            this->free_head = s;
+            return;
+        }
+    }
+}
+
+void FrameCache::log_stats(const char * name) const
+{
+    if ( ! this->nr_frames )
+        return;
+
+    LOG_INFO("%s: %zu frames, %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" evictions\n",
+             name, this->nr_frames, this->hits, this->misses, this->evictions);
+}
+
+uint32_t FrameCache::bucket(const uint64_t & key) const
+{
+    // Fibonacci hashing.  Frame numbers tend to be clustered.
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (this->nr_buckets - 1);
+}
+
+void FrameCache::unhash(const uint32_t slot)
+{
+    uint32_t * link = &this->buckets[this->bucket(this->slots[slot].key)];
+
+    while ( *link != slot )
+        link = &this->slots[*link].hash_next;
+    *link = this->slots[slot].hash_next;
+}
+
+void FrameCache::lru_remove(const uint32_t slot)
+{
+    Slot & s = this->slots[slot];
+
+    if ( s.lru_prev != NONE )
+        this->slots[s.lru_prev].lru_next = s.lru_next;
+    else
+        this->lru_head = s.lru_next;
+
+    if ( s.lru_next != NONE )
+        this->slots[s.lru_next].lru_prev = s.lru_prev;
+    else
+        this->lru_tail = s.lru_prev;
+}
+
+void FrameCache::lru_push(const uint32_t slot)
+{
+    Slot & s = this->slots[slot];
+
+    s.lru_prev = NONE;
+    s.lru_next = this->lru_head;
+    if ( this->lru_head != NONE )
+        this->slots[this->lru_head].lru_prev = slot;
+    else
+        this->lru_tail = slot;
+    this->lru_head = slot;
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
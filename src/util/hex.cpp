@@ -0,0 +1,360 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/util/hex.cpp
+ * @author agent
+ */
+
+#include "util/hex.hpp"
+
+#if defined(__x86_64__) && defined(__SSE2__)
+/// SSE2 is architectural on x86_64.
+#define HEX_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(HEX_SSE2) && defined(__GNUC__) && !defined(__clang__) &&    \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+/// AVX2 functions can be built without -mavx2, and are chosen at runtime.
+#define HEX_AVX2
+#include <immintrin.h>
+#endif
+
+/// Lower case hex digits.
+static const char hex_digits[] = "0123456789abcdef";
+
+/// A set of formatting functions.
+struct HexImpl
+{
+    /// Name, for hex_impl_name().
+    const char * name;
+    /// hex_words64() implementation.
+    void (*words64)(char *, const uint64_t *, const size_t);
+    /// hex_words32() implementation.
+    void (*words32)(char *, const uint32_t *, const size_t);
+    /// hex_bytes() implementation.
+    void (*bytes)(char *, const uint8_t *, const size_t);
+};
+
+/**
+ * Format a value as hex digits, most significant first.
+ * @param out Buffer for nr characters.
+ * @param val Value.
+ * @param nr Number of digits.
+ */
+static inline void scalar_digits(char * out, uint64_t val, const int nr)
+{
+    for ( int i = nr - 1; i >= 0; --i )
+    {
+        out[i] = hex_digits[val & 0xf];
+        val >>= 4;
+    }
+}
+
+/// Plain C++ hex_words64().
+static void scalar_words64(char * out, const uint64_t * vals, const size_t nr)
+{
+    for ( size_t i = 0; i < nr; ++i, out += HEX_WORD64_LEN )
+    {
+        out[0] = ' ';
+        scalar_digits(&out[1], vals[i], 16);
+    }
+}
+
+/// Plain C++ hex_words32().
+static void scalar_words32(char * out, const uint32_t * vals, const size_t nr)
+{
+    for ( size_t i = 0; i < nr; ++i, out += HEX_WORD32_LEN )
+    {
+        out[0] = ' ';
+        scalar_digits(&out[1], vals[i], 8);
+    }
+}
+
+/// Plain C++ hex_bytes().
+static void scalar_bytes(char * out, const uint8_t * data, const size_t nr)
+{
+    for ( size_t i = 0; i < nr; ++i, out += HEX_BYTE_LEN )
+    {
+        out[0] = hex_digits[data[i] >> 4];
+        out[1] = hex_digits[data[i] & 0xf];
+        out[2] = ' ';
+    }
+}
+
+/// Plain C++ implementation.
+static const HexImpl scalar_impl =
+{ "scalar", scalar_words64, scalar_words32, scalar_bytes };
+
+#ifdef HEX_SSE2
+
+/**
+ * Convert nibbles, one per byte, to hex digits.
+ * @param n Nibbles.
+ * @returns Hex digits.
+ */
+static inline __m128i sse2_ascii(const __m128i n)
+{
+    const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+                                        _mm_set1_epi8('a' - '0' - 10));
+
+    return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), alpha);
+}
+
+/**
+ * Convert bytes to hex digits.
+ * @param x Bytes, in the order their digits are wanted.
+ * @param lo Set to the digits of the low 8 bytes.
+ * @param hi Set to the digits of the high 8 bytes.
+ */
+static inline void sse2_digits(const __m128i x, __m128i & lo, __m128i & hi)
+{
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i low = _mm_and_si128(x, mask);
+    const __m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+
+    lo = sse2_ascii(_mm_unpacklo_epi8(high, low));
+    hi = sse2_ascii(_mm_unpackhi_epi8(high, low));
+}
+
+/// SSE2 hex_words64().
+static void sse2_words64(char * out, const uint64_t * vals, const size_t nr)
+{
+    __m128i lo, hi;
+    size_t i;
+
+    for ( i = 0; i + 2 <= nr; i += 2, out += 2 * HEX_WORD64_LEN )
+    {
+        sse2_digits(_mm_set_epi64x(__builtin_bswap64(vals[i + 1]),
+                                   __builtin_bswap64(vals[i])), lo, hi);
+        out[0] = ' ';
+        _mm_storeu_si128((__m128i *)&out[1], lo);
+        out[HEX_WORD64_LEN] = ' ';
+        _mm_storeu_si128((__m128i *)&out[HEX_WORD64_LEN + 1], hi);
+    }
+
+    if ( i < nr )
+    {
+        sse2_digits(_mm_cvtsi64_si128(__builtin_bswap64(vals[i])), lo, hi);
+        out[0] = ' ';
+        _mm_storeu_si128((__m128i *)&out[1], lo);
+    }
+}
+
+/// SSE2 hex_words32().
+static void sse2_words32(char * out, const uint32_t * vals, const size_t nr)
+{
+    __m128i lo, hi;
+    size_t i;
+
+    for ( i = 0; i + 4 <= nr; i += 4, out += 4 * HEX_WORD32_LEN )
+    {
+        sse2_digits(_mm_set_epi32(__builtin_bswap32(vals[i + 3]),
+                                  __builtin_bswap32(vals[i + 2]),
+                                  __builtin_bswap32(vals[i + 1]),
+                                  __builtin_bswap32(vals[i])), lo, hi);
+        out[0] = ' ';
+        _mm_storel_epi64((__m128i *)&out[1], lo);
+        out[HEX_WORD32_LEN] = ' ';
+        _mm_storel_epi64((__m128i *)&out[HEX_WORD32_LEN + 1], _mm_unpackhi_epi64(lo, lo));
+        out[2 * HEX_WORD32_LEN] = ' ';
+        _mm_storel_epi64((__m128i *)&out[2 * HEX_WORD32_LEN + 1], hi);
+        out[3 * HEX_WORD32_LEN] = ' ';
+        _mm_storel_epi64((__m128i *)&out[3 * HEX_WORD32_LEN + 1], _mm_unpackhi_epi64(hi, hi));
+    }
+
+    scalar_words32(out, &vals[i], nr - i);
+}
+
+/// SSE2 hex_bytes().
+static void sse2_bytes(char * out, const uint8_t * data, const size_t nr)
+{
+    char digits[32];
+    __m128i lo, hi;
+    size_t i;
+
+    for ( i = 0; i + 16 <= nr; i += 16 )
+    {
+        sse2_digits(_mm_loadu_si128((const __m128i *)&data[i]), lo, hi);
+        _mm_storeu_si128((__m128i *)&digits[0], lo);
+        _mm_storeu_si128((__m128i *)&digits[16], hi);
+
+        for ( size_t j = 0; j < 16; ++j, out += HEX_BYTE_LEN )
+        {
+            out[0] = digits[2 * j];
+            out[1] = digits[2 * j + 1];
+            out[2] = ' ';
+        }
+    }
+
+    scalar_bytes(out, &data[i], nr - i);
+}
+
+/// SSE2 implementation.
+static const HexImpl sse2_impl =
+{ "sse2", sse2_words64, sse2_words32, sse2_bytes };
+
+#endif /* HEX_SSE2 */
+
+#ifdef HEX_AVX2
+
+/**
+ * Convert 16 bytes to hex digits.
+ * @param x Bytes, in the order their digits are wanted.
+ * @returns Digits of the low 8 bytes in the low lane, and of the high 8
+ * bytes in the high lane.
+ */
+__attribute__((target("avx2")))
+static inline __m256i avx2_digits(const __m128i x)
+{
+    const __m256i table = _mm256_setr_epi8(
+        '0', '1', '2', '3', '4', '5', '6', '7',
+        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+        '0', '1', '2', '3', '4', '5', '6', '7',
+        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    // One byte per 16bit lane, split into its high then low nibble.
+    const __m256i w = _mm256_cvtepu8_epi16(x);
+    const __m256i n = _mm256_or_si256(
+        _mm256_srli_epi16(w, 4),
+        _mm256_slli_epi16(_mm256_and_si256(w, _mm256_set1_epi16(0x0f)), 8));
+
+    return _mm256_shuffle_epi8(table, n);
+}
+
+/// AVX2 hex_words64().
+__attribute__((target("avx2")))
+static void avx2_words64(char * out, const uint64_t * vals, const size_t nr)
+{
+    const __m128i bswap = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                        15, 14, 13, 12, 11, 10, 9, 8);
+    size_t i;
+
+    for ( i = 0; i + 2 <= nr; i += 2, out += 2 * HEX_WORD64_LEN )
+    {
+        const __m256i d = avx2_digits(
+            _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&vals[i]), bswap));
+
+        out[0] = ' ';
+        _mm_storeu_si128((__m128i *)&out[1], _mm256_castsi256_si128(d));
+        out[HEX_WORD64_LEN] = ' ';
+        _mm_storeu_si128((__m128i *)&out[HEX_WORD64_LEN + 1],
+                         _mm256_extracti128_si256(d, 1));
+    }
+
+    sse2_words64(out, &vals[i], nr - i);
+}
+
+/// AVX2 hex_words32().
+__attribute__((target("avx2")))
+static void avx2_words32(char * out, const uint32_t * vals, const size_t nr)
+{
+    const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                        11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i;
+
+    for ( i = 0; i + 4 <= nr; i += 4, out += 4 * HEX_WORD32_LEN )
+    {
+        const __m256i d = avx2_digits(
+            _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&vals[i]), bswap));
+        const __m128i lo = _mm256_castsi256_si128(d);
+        const __m128i hi = _mm256_extracti128_si256(d, 1);
+
+        out[0] = ' ';
+        _mm_storel_epi64((__m128i *)&out[1], lo);
+        out[HEX_WORD32_LEN] = ' ';
+        _mm_storel_epi64((__m128i *)&out[HEX_WORD32_LEN + 1], _mm_unpackhi_epi64(lo, lo));
+        out[2 * HEX_WORD32_LEN] = ' ';
+        _mm_storel_epi64((__m128i *)&out[2 * HEX_WORD32_LEN + 1], hi);
+        out[3 * HEX_WORD32_LEN] = ' ';
+        _mm_storel_epi64((__m128i *)&out[3 * HEX_WORD32_LEN + 1], _mm_unpackhi_epi64(hi, hi));
+    }
+
+    scalar_words32(out, &vals[i], nr - i);
+}
+
+/// AVX2 implementation.  Interleaving spaces into hex_bytes() output
+/// doesn't suit whole vectors, so that is left to SSE2.
+static const HexImpl avx2_impl =
+{ "avx2", avx2_words64, avx2_words32, sse2_bytes };
+
+#endif /* HEX_AVX2 */
+
+/**
+ * Choose the best implementation the CPU supports.
+ * @returns Implementation.
+ */
+static const HexImpl * select_impl()
+{
+#ifdef HEX_AVX2
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+        return &avx2_impl;
+#endif
+#ifdef HEX_SSE2
+    return &sse2_impl;
+#endif
+    return &scalar_impl;
+}
+
+/// Implementation in use.
+static const HexImpl * const impl = select_impl();
+
+void hex_64(char * out, const uint64_t val)
+{
+#ifdef HEX_SSE2
+    __m128i lo, hi;
+
+    sse2_digits(_mm_cvtsi64_si128(__builtin_bswap64(val)), lo, hi);
+    _mm_storeu_si128((__m128i *)out, lo);
+#else
+    scalar_digits(out, val, 16);
+#endif
+}
+
+void hex_words64(char * out, const uint64_t * vals, const size_t nr)
+{
+    impl->words64(out, vals, nr);
+}
+
+void hex_words32(char * out, const uint32_t * vals, const size_t nr)
+{
+    impl->words32(out, vals, nr);
+}
+
+void hex_bytes(char * out, const uint8_t * data, const size_t nr)
+{
+    impl->bytes(out, data, nr);
+}
+
+const char * hex_impl_name()
+{
+    return impl->name;
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
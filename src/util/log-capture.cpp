@@ -0,0 +1,91 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/util/log-capture.cpp
+ * @author agent
+ */
+
+#include "util/log-capture.hpp"
+
+#include "util/log.hpp"
+
+#include <cstdlib>
+
+LogCapture::LogCapture():
+    stream(NULL), data(NULL), size(0)
+{}
+
+LogCapture::~LogCapture()
+{
+    this->flush();
+}
+
+void LogCapture::start()
+{
+    if ( ! this->stream )
+        this->stream = open_memstream(&this->data, &this->size);
+
+    set_log_capture(this->stream);
+}
+
+void LogCapture::stop()
+{
+    set_log_capture(NULL);
+}
+
+void LogCapture::flush()
+{
+    if ( ! this->stream )
+        return;
+
+    // Closing the stream finalises data and size.
+    fclose(this->stream);
+    this->stream = NULL;
+
+    write_log_capture(this->data, this->size);
+
+    free(this->data);
+    this->data = NULL;
+    this->size = 0;
+}
+
+void LogCapture::discard()
+{
+    if ( ! this->stream )
+        return;
+
+    fclose(this->stream);
+    this->stream = NULL;
+
+    free(this->data);
+    this->data = NULL;
+    this->size = 0;
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -25,14 +25,84 @@
  * @author Andrew Cooper
  */
 
+#if defined(__x86_64__) && defined(__SSE2__)
+/// SSE2 is architectural on x86_64.
+#define ZERO_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * Length of the run of zero bytes at the start of a buffer.
+ * @param data Buffer.
+ * @param len Length of the buffer.
+ * @return Number of leading zero bytes.
+ */
+static size_t zero_prefix(const char * data, const size_t len)
+{
+    size_t i = 0;
+
+#ifdef ZERO_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    // Skip whole cachelines of zeroes...
+    for ( ; i + 64 <= len; i += 64 )
+    {
+        const __m128i v = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)&data[i]),
+                         _mm_loadu_si128((const __m128i *)&data[i + 16])),
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)&data[i + 32]),
+                         _mm_loadu_si128((const __m128i *)&data[i + 48])));
+
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff )
+            break;
+    }
+
+    // ...then find the first non-zero byte 16 at a time.
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        const int mask = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&data[i]), zero));
+
+        if ( mask != 0xffff )
+            return i + __builtin_ctz(~mask);
+    }
+#endif
+
+    for ( ; i < len && !data[i]; ++i );
+    return i;
+}
+
 bool is_zeroes(const char * buffer, const size_t size)
 {
-    size_t i;
+    return zero_prefix(buffer, size) == size;
+}
+
+size_t zero_run_length(const uint64_t * words, const size_t nr)
+{
+    return zero_prefix((const char *)words, nr * sizeof *words) / sizeof *words;
+}
+
+uint64_t fnv1a(const void * data, const size_t len, uint64_t hash)
+{
+    const unsigned char * ptr = static_cast<const unsigned char *>(data);
 
-    for ( i = 0; i < size && !buffer[i]; ++i );
-    return i == size;
+    for ( size_t x = 0; x < len; ++x )
+    {
+        hash ^= ptr[x];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
 }
 
+uint64_t fnv1a_str(const char * str, uint64_t hash)
+{
+    for ( ; *str; ++str )
+    {
+        hash ^= (unsigned char)*str;
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
 
 /*
  * Local variables:
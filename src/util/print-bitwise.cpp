@@ -25,16 +25,14 @@
 
 #include "util/print-bitwise.hpp"
 
-#include "util/stdio-wrapper.hpp"
-
 /**
  * Macro to help with bitwise decoding of registers.
  * @param b Bit number of the register.
  * @param n Symbolic name of the specified bit.
  */
-#define BIT(b, n) do { if (reg & (1<<(b))) len+=FPUTS(" "#n, o); } while(0)
+#define BIT(b, n) do { if (reg & (1<<(b))) len+=o.puts(" "#n); } while(0)
 
-int print_cr0(FILE * o, const uint64_t & reg)
+int print_cr0(Writer & o, const uint64_t & reg)
 {
     int len = 0;
 
@@ -53,7 +51,7 @@ int print_cr0(FILE * o, const uint64_t & reg)
     return len;
 }
 
-int print_cr4(FILE * o, const uint64_t & reg)
+int print_cr4(Writer & o, const uint64_t & reg)
 {
     int len = 0;
 
@@ -80,7 +78,7 @@ int print_cr4(FILE * o, const uint64_t & reg)
     return len;
 }
 
-int print_rflags(FILE * o, const uint64_t & reg)
+int print_rflags(Writer & o, const uint64_t & reg)
 {
     int len = 0;
 
@@ -94,7 +92,9 @@ int print_rflags(FILE * o, const uint64_t & reg)
     BIT(14, NT); // Nested Task
 
     // Bits 12 and 13 are IOPL
-    len += FPRINTF(o, " IOPL%"PRIu64"  ", reg & (3<<12));
+    len += o.puts(" IOPL");
+    len += o.dec(reg & (3<<12));
+    len += o.puts("  ");
 
     BIT(11, OF); // Overflow flag
     BIT(10, DF); // Direction flag
@@ -112,7 +112,7 @@ int print_rflags(FILE * o, const uint64_t & reg)
     return len;
 }
 
-int print_pause_flags(FILE * o, const uint32_t & reg)
+int print_pause_flags(Writer & o, const uint32_t & reg)
 {
     int len = 0;
 
@@ -125,12 +125,12 @@ int print_pause_flags(FILE * o, const uint32_t & reg)
     return len;
 }
 
-int print_paging_mode(FILE * o, const uint32_t & reg)
+int print_paging_mode(Writer & o, const uint32_t & reg)
 {
     int len = 0;
 
     if ( reg == 0 )
-        return len + FPUTS("None", o);
+        return len + o.puts("None");
 
     BIT(21, HAP);
     BIT(20, Shadow);
@@ -26,14 +26,14 @@
 #include "Xen.h"
 #include "types.hpp"
 #include "util/print-structures.hpp"
+#include "util/hex.hpp"
 #include "util/log.hpp"
 #include "util/macros.hpp"
-#include "util/stdio-wrapper.hpp"
 #include "memory.hpp"
 
 #include <limits.h>
 
-int print_64bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
+int print_64bit_stack(Writer & o, const PageTable & pt, const vaddr_t & rsp,
                       const size_t count)
 {
     int len = 0;
@@ -41,13 +41,15 @@ int print_64bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
     const int WPL = 4; // Words per line
     const int mask = WS*WPL -1;
 
-    uint64_t val;
+    MemView view;
+    uint64_t vals[WPL];
+    size_t nr = 0;
     uint64_t sp = rsp;
     uint64_t end;
     uint64_t align;
 
     if ( rsp & (WS-1) )
-        return len + FPUTS("\n\t  Stack pointer mis-aligned\n", o);
+        return len + o.puts("\n\t  Stack pointer mis-aligned\n");
 
     if ( ! count )
         end = ((rsp | (PAGE_SIZE-1))+1);
@@ -57,9 +59,10 @@ int print_64bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
     align = (sp & mask)/WS;
     if ( align )
     {
-        len += FPRINTF(o, "\n\t  %016"PRIx64":", sp & ~mask);
-        while ( align-- )
-            len += FPRINTF(o, " %16s", "");
+        len += o.puts("\n\t  ");
+        len += o.hex(sp & ~mask, 16);
+        len += o.putc(':');
+        len += o.pad(align * 17);
     }
 
     try
@@ -67,21 +70,30 @@ int print_64bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
         for ( ; sp < end; sp += WS )
         {
             if ( !(sp & mask) )
-                len += FPRINTF(o, "\n\t  %016"PRIx64":", sp);
-            memory.read64_vaddr(pt, sp, val);
-            len += FPRINTF(o, " %016"PRIx64, val);
+            {
+                len += o.hex_words(vals, nr);
+                nr = 0;
+                len += o.puts("\n\t  ");
+                len += o.hex(sp, 16);
+                len += o.putc(':');
+            }
+            memory.read_view(view, pt, sp, vals[nr], end);
+            ++nr;
         }
+        len += o.hex_words(vals, nr);
     }
     catch ( const CommonError & e )
     {
+        // Print what was read of this line before the error.
+        len += o.hex_words(vals, nr);
         e.log();
     }
 
-    len += FPUTS("\n", o);
+    len += o.puts("\n");
     return len;
 }
 
-int print_32bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
+int print_32bit_stack(Writer & o, const PageTable & pt, const vaddr_t & rsp,
                       const size_t count)
 {
     int len = 0;
@@ -89,13 +101,15 @@ int print_32bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
     const int WPL = 8; // Words per line
     const int mask = WS*WPL -1;
 
-    uint32_t val;
+    MemView view;
+    uint32_t vals[WPL];
+    size_t nr = 0;
     uint64_t sp = rsp;
     uint64_t end;
     uint64_t align;
 
     if ( rsp & (WS-1) )
-        return len + FPUTS("\t  Stack pointer mis-aligned\n", o);
+        return len + o.puts("\t  Stack pointer mis-aligned\n");
 
     if ( ! count )
         end = ((rsp | (PAGE_SIZE-1))+1);
@@ -104,18 +118,18 @@ int print_32bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
 
     if ( ((rsp | sp | end) & 0xffffffff00000000ULL) )
     {
-        len += FPRINTF(o, "%016"PRIx64" %016"PRIx64" %016"PRIx64"\n", rsp, sp, end);
-        return len + FPUTS("\t Stack pointer out of range for 32bit "
-                           "Virtual Address space\n", o);
+        len += o.printf("%016"PRIx64" %016"PRIx64" %016"PRIx64"\n", rsp, sp, end);
+        return len + o.puts("\t Stack pointer out of range for 32bit "
+                            "Virtual Address space\n");
     }
 
     align = (sp & mask)/WS;
     if ( align )
     {
-        len += FPRINTF(o, "\n\t  %08"PRIx64":", sp & ~mask);
-        while ( align-- )
-            len += FPRINTF(o, " %8s", "");
-
+        len += o.puts("\n\t  ");
+        len += o.hex(sp & ~mask, 8);
+        len += o.putc(':');
+        len += o.pad(align * 9);
     }
 
     try
@@ -123,45 +137,84 @@ int print_32bit_stack(FILE * o, const PageTable & pt, const vaddr_t & rsp,
         for ( ; sp < end; sp += WS )
         {
             if ( !(sp & mask) )
-                len += FPRINTF(o, "\n\t  %08"PRIx64":", sp);
-            memory.read32_vaddr(pt, sp, val);
-            len += FPRINTF(o, " %08"PRIx32, val);
+            {
+                len += o.hex_words(vals, nr);
+                nr = 0;
+                len += o.puts("\n\t  ");
+                len += o.hex(sp, 8);
+                len += o.putc(':');
+            }
+            memory.read_view(view, pt, sp, vals[nr], end);
+            ++nr;
         }
+        len += o.hex_words(vals, nr);
     }
     catch ( const CommonError & e )
     {
+        // Print what was read of this line before the error.
+        len += o.hex_words(vals, nr);
         e.log();
     }
 
-    len += FPUTS("\n", o);
+    len += o.puts("\n");
     return len;
 }
 
-int print_code(FILE * o, const PageTable & pt, const vaddr_t & rip)
+/**
+ * Print code bytes, separated by spaces, with the byte at rip (index 15)
+ * in angle brackets.
+ * @param o Writer to print to.
+ * @param code Code bytes, starting 15 bytes before rip.
+ * @param nr Number of bytes, at most 32.
+ * @returns Number of characters printed.
+ */
+static int print_code_bytes(Writer & o, const uint8_t * code, const size_t nr)
 {
     int len = 0;
-    vaddr_t ip = rip - 15;
-    uint8_t d;
+    // Leading space, then "%02x " per byte.  The trailing space is dropped.
+    char text[1 + 32 * HEX_BYTE_LEN];
+
+    text[0] = ' ';
+    hex_bytes(&text[1], code, nr);
 
-    len += FPUTS("\t  ", o);
+    if ( nr > 15 )
+    {
+        len += o.write(text, 15 * HEX_BYTE_LEN + 1);
+        len += o.putc('<');
+        len += o.write(&text[15 * HEX_BYTE_LEN + 1], 2);
+        len += o.putc('>');
+        len += o.write(&text[16 * HEX_BYTE_LEN], (nr - 16) * HEX_BYTE_LEN);
+    }
+    else
+        len += o.write(text, nr * HEX_BYTE_LEN);
+
+    return len;
+}
+
+int print_code(Writer & o, const PageTable & pt, const vaddr_t & rip)
+{
+    int len = 0;
+    MemView view;
+    const vaddr_t ip = rip - 15;
+    uint8_t code[32];
+    size_t nr = 0;
+
+    len += o.puts("\t  ");
 
     try
     {
-        for ( int i = 0; i < 32; ++i )
-        {
-            memory.read8_vaddr(pt, ip + i, d);
-            if ( (ip + i) == rip )
-                len += FPRINTF(o, " <%02"PRIx8">", d);
-            else
-                len += FPRINTF(o, " %02"PRIx8, d);
-        }
+        for ( ; nr < sizeof code; ++nr )
+            memory.read_view(view, pt, ip + nr, code[nr], ip + sizeof code);
+        len += print_code_bytes(o, code, nr);
     }
     catch ( const CommonError & e )
     {
+        // Print what was read before the error.
+        len += print_code_bytes(o, code, nr);
         e.log();
     }
 
-    len += FPUTS("\n", o);
+    len += o.puts("\n");
 
     return len;
 }
@@ -255,7 +308,7 @@ static const char * log_level_str(uint8_t level)
     }
 }
 
-int print_console_ring_3x(FILE * o, const PageTable & pt,
+int print_console_ring_3x(Writer & o, const PageTable & pt,
                           const vaddr_t log_buf, const uint64_t log_buf_len,
                           const uint64_t log_first_idx, const uint64_t log_next_idx)
 {
@@ -300,14 +353,14 @@ int print_console_ring_3x(FILE * o, const PageTable & pt,
             memory.read8_vaddr(pt, logptr + 15, flags.flag_int);
             ts_sec = ts_nsec / 1000000000;
             ts_frac = (ts_nsec % 1000000000) / 1000; /* microseconds */
-            len += FPRINTF(o, "[%7"PRIu64".%.6"PRIu64"] %s: ", ts_sec, ts_frac,
-                           log_level_str(flags.flag_struct.level));
+            len += o.printf("[%7"PRIu64".%.6"PRIu64"] %s: ", ts_sec, ts_frac,
+                            log_level_str(flags.flag_struct.level));
 
             memory.read16_vaddr(pt, txtlen_addr, txtlen);
             text_length = txtlen;
-            written = memory.write_block_vaddr_to_file(pt, text_addr, o, text_length);
+            written = memory.write_block_vaddr_to_file(pt, text_addr, o.file(), text_length);
             len += written;
-            len += FPUTS("\n", o);
+            len += o.puts("\n");
 
             if ( written != text_length )
                 LOG_INFO("Mismatch writing console ring to file. Written %zu bytes "
@@ -316,8 +369,8 @@ int print_console_ring_3x(FILE * o, const PageTable & pt,
             idx = log_next(pt, idx, log_buf);
             if ( idx >= log_buf_len )
             {
-                len += FPRINTF(o, "\tidx of 0x%"PRIx64" bad. >= 0x%"PRIx64".\n",
-                               idx, log_buf_len);
+                len += o.printf("\tidx of 0x%"PRIx64" bad. >= 0x%"PRIx64".\n",
+                                idx, log_buf_len);
                 break;
             }
         }
@@ -330,7 +383,7 @@ int print_console_ring_3x(FILE * o, const PageTable & pt,
     return len;
 }
 
-int print_console_ring(FILE * o, const PageTable & pt,
+int print_console_ring(Writer & o, const PageTable & pt,
                        const vaddr_t & ring, const uint64_t & _length,
                        const uint64_t & producer, const uint64_t & consumer)
 {
@@ -339,8 +392,8 @@ int print_console_ring(FILE * o, const PageTable & pt,
     ssize_t written;
 
     if ( _length > SSIZE_MAX )
-        return len + FPRINTF(o, "Length(%"PRIu64") exceeds SSIZE_MAX(%zd)\n",
-                             _length, (ssize_t)SSIZE_MAX);
+        return len + o.printf("Length(%"PRIu64") exceeds SSIZE_MAX(%zd)\n",
+                              _length, (ssize_t)SSIZE_MAX);
 
     if ( (length & (length-1)) == 0 )
     {
@@ -349,21 +402,21 @@ int print_console_ring(FILE * o, const PageTable & pt,
     }
 
     if ( prod > length )
-        return len + FPRINTF(o, "Producer index %"PRIu64" outside ring length %"PRIu64"\n",
-                             prod, length);
+        return len + o.printf("Producer index %"PRIu64" outside ring length %"PRIu64"\n",
+                              prod, length);
 
     if ( cons > length )
-        return len + FPRINTF(o, "Consumer index %"PRIu64" outside ring length %"PRIu64"\n",
-                             cons, length);
+        return len + o.printf("Consumer index %"PRIu64" outside ring length %"PRIu64"\n",
+                              cons, length);
 
-    len += FPUTS("\n", o);
+    len += o.puts("\n");
 
     try
     {
         if ( cons == 0 && prod == 0 )
         {
             LOG_DEBUG("Console ring: %"PRIu64" bytes at 0x%016"PRIx64"\n", length, ring);
-            written = memory.write_block_vaddr_to_file(pt, ring, o, length);
+            written = memory.write_block_vaddr_to_file(pt, ring, o.file(), length);
             len += written;
 
             if ( written != length )
@@ -377,7 +430,7 @@ int print_console_ring(FILE * o, const PageTable & pt,
             if ( cons >= prod )
             {
                 written = memory.write_block_vaddr_to_file(pt, ring + cons,
-                                                           o, length - cons);
+                                                           o.file(), length - cons);
                 len += written;
 
                 if ( (length - cons) != written )
@@ -388,7 +441,7 @@ int print_console_ring(FILE * o, const PageTable & pt,
                 else
                 {
 
-                    written = memory.write_block_vaddr_to_file(pt, ring, o, prod);
+                    written = memory.write_block_vaddr_to_file(pt, ring, o.file(), prod);
                     len += written;
 
                     if ( prod != written )
@@ -398,7 +451,7 @@ int print_console_ring(FILE * o, const PageTable & pt,
             }
             else
             {
-                written = memory.write_block_vaddr_to_file(pt, ring + cons, o, prod - cons);
+                written = memory.write_block_vaddr_to_file(pt, ring + cons, o.file(), prod - cons);
                 len += written;
 
                 if ( (prod - cons) != written )
@@ -412,14 +465,15 @@ int print_console_ring(FILE * o, const PageTable & pt,
         e.log();
     }
 
-    len += FPUTS("\n", o);
+    len += o.puts("\n");
     return len;
 }
 
-int dump_data(FILE * o, size_t ws, const PageTable & pt, const vaddr_t & start,
+int dump_data(Writer & o, size_t ws, const PageTable & pt, const vaddr_t & start,
               const uint64_t & length)
 {
     int len = 0;
+    MemView view;
 
     // Only support 32 and 64 bit dumps at the moment
     if ( ! ( ws == 4 || ws == 8 ) )
@@ -430,54 +484,57 @@ int dump_data(FILE * o, size_t ws, const PageTable & pt, const vaddr_t & start,
 
     // Verify that start + length does not overflow
     if ( ((-(uint64_t)1) - start) < length )
-        return len + FPRINTF(o, "dump_data(): start (0x%016"PRIx64") and length "
-                             "(0x%016"PRIx64") overflow the address space.\n",
-                             start, length);
+        return len + o.printf("dump_data(): start (0x%016"PRIx64") and length "
+                              "(0x%016"PRIx64") overflow the address space.\n",
+                              start, length);
 
 
     for ( vaddr_t addr = start; addr < (start+length); addr += ws * 2 )
     {
         try
         {
-            len += FPRINTF(o, "%04"PRIx64": ", addr - start);
+            len += o.hex(addr - start, 4);
+            len += o.puts(": ");
 
             if ( ws == 4 )
             {
-                union { uint32_t _32; unsigned char _8 [sizeof (uint32_t)]; } data[2];
+                union { uint32_t _32; uint8_t _8 [sizeof (uint32_t)]; } data[2];
 
-                memory.read32_vaddr(pt, addr, data[0]._32);
+                memory.read_view(view, pt, addr, data[0]._32, start + length);
 
-                for ( size_t x = 0; x < sizeof data[0]._8; ++x )
-                    len += FPRINTF(o, "%02x ", data[0]._8[x]);
-                len += FPUTS(" ", o);
+                len += o.hex_bytes(data[0]._8, sizeof data[0]._8);
+                len += o.putc(' ');
 
-                memory.read32_vaddr(pt, addr+ws, data[1]._32);
+                memory.read_view(view, pt, addr+ws, data[1]._32, start + length);
 
-                for ( size_t x = 0; x < sizeof data[1]._8; ++x )
-                    len += FPRINTF(o, "%02x ", data[1]._8[x]);
-                len += FPUTS(" ", o);
+                len += o.hex_bytes(data[1]._8, sizeof data[1]._8);
+                len += o.putc(' ');
 
-                len += FPRINTF(o, "0x%08"PRIx32" 0x%08"PRIx32"\n",
-                               data[0]._32, data[1]._32);
+                len += o.puts("0x");
+                len += o.hex(data[0]._32, 8);
+                len += o.puts(" 0x");
+                len += o.hex(data[1]._32, 8);
+                len += o.putc('\n');
             }
             else
             {
-                union { uint64_t _64; unsigned char _8 [sizeof (uint64_t)]; } data[2];
+                union { uint64_t _64; uint8_t _8 [sizeof (uint64_t)]; } data[2];
 
-                memory.read64_vaddr(pt, addr, data[0]._64);
+                memory.read_view(view, pt, addr, data[0]._64, start + length);
 
-                for ( size_t x = 0; x < sizeof data[0]._8; ++x )
-                    len += FPRINTF(o, "%02x ", data[0]._8[x]);
-                len += FPUTS(" ", o);
+                len += o.hex_bytes(data[0]._8, sizeof data[0]._8);
+                len += o.putc(' ');
 
-                memory.read64_vaddr(pt, addr+ws, data[1]._64);
+                memory.read_view(view, pt, addr+ws, data[1]._64, start + length);
 
-                for ( size_t x = 0; x < sizeof data[1]._8; ++x )
-                    len += FPRINTF(o, "%02x ", data[1]._8[x]);
-                len += FPUTS(" ", o);
+                len += o.hex_bytes(data[1]._8, sizeof data[1]._8);
+                len += o.putc(' ');
 
-                len += FPRINTF(o, "0x%016"PRIx64" 0x%016"PRIx64"\n",
-                               data[0]._64, data[1]._64);
+                len += o.puts("0x");
+                len += o.hex(data[0]._64, 16);
+                len += o.puts(" 0x");
+                len += o.hex(data[1]._64, 16);
+                len += o.putc('\n');
             }
         }
         catch ( const CommonError & e )
@@ -0,0 +1,189 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/util/stack-scan.cpp
+ * @author agent
+ */
+
+#include "util/stack-scan.hpp"
+#include "exceptions.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+/// AVX2 functions can be built without -mavx2, and are chosen at runtime.
+#define SCAN_AVX2
+#include <immintrin.h>
+#endif
+
+/// Classification function.
+typedef void (*classify_fn)(const uint64_t * words, uint8_t * flags, const size_t nr,
+                            const vaddr_t * start, const vaddr_t * end,
+                            const uint8_t * flag, const size_t nr_ranges);
+
+/// Plain C++ classification.
+static void scalar_classify(const uint64_t * words, uint8_t * flags, const size_t nr,
+                            const vaddr_t * start, const vaddr_t * end,
+                            const uint8_t * flag, const size_t nr_ranges)
+{
+    for ( size_t i = 0; i < nr; ++i )
+    {
+        uint8_t f = words[i] ? 0 : StackScanner::ZERO;
+
+        for ( size_t r = 0; r < nr_ranges; ++r )
+            if ( words[i] >= start[r] && words[i] <= end[r] )
+                f |= flag[r];
+
+        flags[i] = f;
+    }
+}
+
+#ifdef SCAN_AVX2
+
+/// Four bit mask to four bytes of 0xff or 0, one per bit.
+static const uint32_t spread[16] =
+{
+    0x00000000, 0x000000ff, 0x0000ff00, 0x0000ffff,
+    0x00ff0000, 0x00ff00ff, 0x00ffff00, 0x00ffffff,
+    0xff000000, 0xff0000ff, 0xff00ff00, 0xff00ffff,
+    0xffff0000, 0xffff00ff, 0xffffff00, 0xffffffff,
+};
+
+/**
+ * AVX2 classification, four words at a time.  AVX2 only has signed 64bit
+ * compares, so words and ranges are biased by 2^63 to compare unsigned.
+ */
+__attribute__((target("avx2")))
+static void avx2_classify(const uint64_t * words, uint8_t * flags, const size_t nr,
+                          const vaddr_t * start, const vaddr_t * end,
+                          const uint8_t * flag, const size_t nr_ranges)
+{
+    const __m256i bias = _mm256_set1_epi64x((int64_t)(1ULL << 63));
+    __m256i lo[StackScanner::MAX_RANGES], hi[StackScanner::MAX_RANGES];
+    uint32_t fill[StackScanner::MAX_RANGES];
+    size_t i;
+
+    for ( size_t r = 0; r < nr_ranges; ++r )
+    {
+        lo[r] = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)start[r]), bias);
+        hi[r] = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)end[r]), bias);
+        fill[r] = flag[r] * 0x01010101U;
+    }
+
+    for ( i = 0; i + 4 <= nr; i += 4 )
+    {
+        const __m256i w = _mm256_loadu_si256((const __m256i *)&words[i]);
+        const __m256i x = _mm256_xor_si256(w, bias);
+        uint32_t f = spread[_mm256_movemask_pd(_mm256_castsi256_pd(
+                         _mm256_cmpeq_epi64(w, _mm256_setzero_si256())))] &
+            (StackScanner::ZERO * 0x01010101U);
+
+        for ( size_t r = 0; r < nr_ranges; ++r )
+        {
+            // Outside the range is below start or above end.
+            const __m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(lo[r], x),
+                                                _mm256_cmpgt_epi64(x, hi[r]));
+
+            f |= spread[~_mm256_movemask_pd(_mm256_castsi256_pd(out)) & 0xf] & fill[r];
+        }
+
+        std::memcpy(&flags[i], &f, sizeof f);
+    }
+
+    scalar_classify(&words[i], &flags[i], nr - i, start, end, flag, nr_ranges);
+}
+
+#endif /* SCAN_AVX2 */
+
+/**
+ * Choose the best classification the CPU supports.
+ * @returns Classification function.
+ */
+static classify_fn select_classify()
+{
+#ifdef SCAN_AVX2
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+        return avx2_classify;
+#endif
+    return scalar_classify;
+}
+
+/// Classification in use.
+static const classify_fn classify_impl = select_classify();
+
+const uint8_t StackScanner::ZERO;
+const uint8_t StackScanner::TEXT;
+const uint8_t StackScanner::STACK;
+const size_t StackScanner::MAX_WORDS;
+const size_t StackScanner::MAX_RANGES;
+
+StackScanner::StackScanner():
+    nr_ranges(0), view()
+{}
+
+void StackScanner::add_range(const vaddr_t & start, const vaddr_t & end, const uint8_t flag)
+{
+    if ( this->nr_ranges == MAX_RANGES )
+        throw validate(start, "Too many stack scan ranges");
+
+    this->range_start[this->nr_ranges] = start;
+    this->range_end[this->nr_ranges] = end;
+    this->range_flag[this->nr_ranges] = flag;
+    ++this->nr_ranges;
+}
+
+size_t StackScanner::read(const PageTable & pt, const vaddr_t & addr, const vaddr_t & end)
+{
+    size_t nr;
+
+    memory.view_vaddr(pt, addr, end - addr, this->view);
+    nr = std::min(this->view.length / 8, MAX_WORDS);
+
+    if ( nr )
+        std::memcpy(this->words, this->view.data, nr * 8);
+    else
+    {
+        memory.read_view(this->view, pt, addr, this->words[0], end);
+        nr = 1;
+    }
+
+    this->classify(this->words, this->flags, nr);
+    return nr;
+}
+
+void StackScanner::classify(const uint64_t * words, uint8_t * flags, const size_t nr) const
+{
+    classify_impl(words, flags, nr, this->range_start, this->range_end,
+                  this->range_flag, this->nr_ranges);
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,210 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/util/worker-pool.cpp
+ * @author agent
+ */
+
+#include "util/worker-pool.hpp"
+
+#include "util/log.hpp"
+#include "util/macros.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <new>
+
+unsigned WorkerPool::nr_threads = 1;
+bool WorkerPool::running = false;
+
+/// Work shared between the threads of one WorkerPool::run().
+class PoolState
+{
+public:
+    /**
+     * Constructor.
+     * @param job Work to perform.
+     * @param nr Number of items.
+     */
+    PoolState(WorkerPool::Job & job, const size_t nr):
+        job(job), nr(nr), next(0), lock()
+    {}
+
+    /// Work to perform.
+    WorkerPool::Job & job;
+    /// Number of items.
+    const size_t nr;
+    /// Next item to hand out.
+    size_t next;
+    /// Protects next.
+    Mutex lock;
+
+private:
+    // @cond EXCLUDE
+    PoolState(const PoolState &);
+    PoolState & operator= (const PoolState &);
+    // @endcond
+};
+
+/**
+ * Run one item of work.  Jobs must not throw, but an exception which does
+ * escape is logged and the item abandoned, rather than letting it unwind
+ * a worker thread (std::terminate()) or leave WorkerPool::run() while
+ * other threads are still using its state.
+ * @param job Work to perform.
+ * @param index Index of the item.
+ */
+static void run_item(WorkerPool::Job & job, const size_t index)
+{
+    try
+    {
+        job.run(index);
+    }
+    catch ( const std::bad_alloc & )
+    {
+        LOG_ERROR("Bad alloc for work item %zu.  Kdump environment needs more memory\n",
+                  index);
+    }
+    catch ( ... )
+    {
+        LOG_ERROR("Unexpected exception from work item %zu\n", index);
+    }
+}
+
+/**
+ * Run items of work until there are none left.
+ * @param state Shared state.
+ */
+static void run_items(PoolState & state)
+{
+    for ( ;; )
+    {
+        size_t index;
+
+        state.lock.lock();
+        index = state.next;
+        if ( index < state.nr )
+            ++state.next;
+        state.lock.unlock();
+
+        if ( index >= state.nr )
+            return;
+
+        run_item(state.job, index);
+    }
+}
+
+/**
+ * Thread entry point for run_items().
+ * @param arg PoolState.
+ * @returns NULL.
+ */
+static void * run_items_thread(void * arg)
+{
+    run_items(*static_cast<PoolState *>(arg));
+    return NULL;
+}
+
+WorkerPool::Job::~Job()
+{}
+
+void WorkerPool::set_threads(const unsigned nr)
+{
+    if ( nr )
+        nr_threads = nr;
+    else
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nr_threads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+}
+
+unsigned WorkerPool::threads()
+{
+    return nr_threads;
+}
+
+void WorkerPool::run(Job & job, const size_t nr)
+{
+    const size_t nr_workers = std::min((size_t)nr_threads, nr);
+
+    if ( nr_workers < 2 || running )
+    {
+        for ( size_t x = 0; x < nr; ++x )
+            run_item(job, x);
+        return;
+    }
+
+    PoolState state(job, nr);
+    pthread_t * threads = new (std::nothrow) pthread_t[nr_workers - 1];
+    size_t started = 0;
+
+    running = true;
+
+    // Any threads which can't be created simply leave more for the others.
+    if ( threads )
+        for ( ; started < nr_workers - 1; ++started )
+            if ( pthread_create(&threads[started], NULL, run_items_thread, &state) )
+            {
+                LOG_WARN("Failed to create worker thread.  Continuing with %zu\n",
+                         started + 1);
+                break;
+            }
+
+    run_items(state);
+
+    for ( size_t x = 0; x < started; ++x )
+        pthread_join(threads[x], NULL);
+
+    running = false;
+    SAFE_DELETE_ARRAY(threads);
+}
+
+Mutex::Mutex():
+    mutex()
+{
+    pthread_mutex_init(&this->mutex, NULL);
+}
+
+Mutex::~Mutex()
+{
+    pthread_mutex_destroy(&this->mutex);
+}
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(&this->mutex);
+}
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(&this->mutex);
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,245 @@
+/*
+ *  This file is part of the Xen Crashdump Analyser.
+ *
+ *  The Xen Crashdump Analyser is free software: you can redistribute
+ *  it and/or modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation, either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  The Xen Crashdump Analyser is distributed in the hope that it will
+ *  be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the Xen Crashdump Analyser.  If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ */
+
+/**
+ * @file src/util/writer.cpp
+ * @author agent
+ */
+
+#include "util/writer.hpp"
+#include "util/hex.hpp"
+#include "util/macros.hpp"
+#include "exceptions.hpp"
+
+#include <cstdarg>
+#include <cerrno>
+#include <algorithm>
+#include <new>
+
+/// Values formatted per call to the hex kernels.
+static const size_t HEX_CHUNK = 64;
+
+const size_t Writer::DEFAULT_SIZE;
+
+Writer::Writer(FILE * stream, const size_t size):
+    stream(stream), buffer(NULL), size(0), used(0)
+{
+    this->buffer = new (std::nothrow) char[size];
+    if ( this->buffer )
+        this->size = size;
+}
+
+Writer::~Writer()
+{
+    if ( this->used )
+        fwrite(this->buffer, 1, this->used, this->stream);
+    SAFE_DELETE_ARRAY(this->buffer);
+}
+
+void Writer::flush()
+{
+    const size_t len = this->used;
+
+    this->used = 0;
+    if ( len && fwrite(this->buffer, 1, len, this->stream) != len )
+        throw filewrite(errno);
+}
+
+FILE * Writer::file()
+{
+    this->flush();
+    return this->stream;
+}
+
+int Writer::write_slow(const char * data, const size_t len)
+{
+    this->flush();
+
+    if ( len < this->size )
+    {
+        std::memcpy(this->buffer, data, len);
+        this->used = len;
+    }
+    else if ( fwrite(data, 1, len, this->stream) != len )
+        throw filewrite(errno);
+
+    return (int)len;
+}
+
+char * Writer::reserve(const size_t len)
+{
+    if ( len > this->size - this->used )
+    {
+        this->flush();
+        if ( len > this->size )
+            return NULL;
+    }
+    return &this->buffer[this->used];
+}
+
+int Writer::hex(uint64_t val, const unsigned width)
+{
+    char tmp[16];
+    unsigned nr = val ? (67 - __builtin_clzll(val)) / 4 : 1;
+
+    if ( nr < width )
+        nr = std::min(width, 16U);
+
+    hex_64(tmp, val);
+    return this->write(&tmp[sizeof tmp - nr], nr);
+}
+
+int Writer::hex_words(const uint64_t * vals, const size_t nr)
+{
+    char tmp[HEX_CHUNK * HEX_WORD64_LEN];
+
+    for ( size_t x = 0; x < nr; x += HEX_CHUNK )
+    {
+        const size_t n = std::min(nr - x, HEX_CHUNK), len = n * HEX_WORD64_LEN;
+        char * out = this->reserve(len);
+
+        hex_words64(out ? out : tmp, &vals[x], n);
+        if ( out )
+            this->used += len;
+        else
+            this->write_slow(tmp, len);
+    }
+
+    return (int)(nr * HEX_WORD64_LEN);
+}
+
+int Writer::hex_words(const uint32_t * vals, const size_t nr)
+{
+    char tmp[HEX_CHUNK * HEX_WORD32_LEN];
+
+    for ( size_t x = 0; x < nr; x += HEX_CHUNK )
+    {
+        const size_t n = std::min(nr - x, HEX_CHUNK), len = n * HEX_WORD32_LEN;
+        char * out = this->reserve(len);
+
+        hex_words32(out ? out : tmp, &vals[x], n);
+        if ( out )
+            this->used += len;
+        else
+            this->write_slow(tmp, len);
+    }
+
+    return (int)(nr * HEX_WORD32_LEN);
+}
+
+int Writer::hex_bytes(const uint8_t * data, const size_t nr)
+{
+    char tmp[HEX_CHUNK * HEX_BYTE_LEN];
+
+    for ( size_t x = 0; x < nr; x += HEX_CHUNK )
+    {
+        const size_t n = std::min(nr - x, HEX_CHUNK), len = n * HEX_BYTE_LEN;
+        char * out = this->reserve(len);
+
+        ::hex_bytes(out ? out : tmp, &data[x], n);
+        if ( out )
+            this->used += len;
+        else
+            this->write_slow(tmp, len);
+    }
+
+    return (int)(nr * HEX_BYTE_LEN);
+}
+
+int Writer::hex_prefixed(const uint64_t val)
+{
+    if ( ! val )
+        return this->putc('0');
+    return this->write("0x", 2) + this->hex(val, 0);
+}
+
+int Writer::dec(uint64_t val)
+{
+    char tmp[20];
+    unsigned nr = 0;
+
+    do
+    {
+        tmp[sizeof tmp - ++nr] = '0' + (val % 10);
+        val /= 10;
+    } while ( val );
+
+    return this->write(&tmp[sizeof tmp - nr], nr);
+}
+
+int Writer::pad(size_t nr)
+{
+    static const char spaces[] = "                                ";
+    const size_t len = nr;
+
+    while ( nr > sizeof spaces - 1 )
+    {
+        this->write(spaces, sizeof spaces - 1);
+        nr -= sizeof spaces - 1;
+    }
+    this->write(spaces, nr);
+
+    return (int)len;
+}
+
+int Writer::printf(const char * fmt, ...)
+{
+    va_list vargs;
+    int ret;
+
+    // Format straight into the buffer if it fits...
+    va_start(vargs, fmt);
+    ret = vsnprintf(&this->buffer[this->used], this->size - this->used, fmt, vargs);
+    va_end(vargs);
+
+    if ( ret >= 0 && (size_t)ret < this->size - this->used )
+    {
+        this->used += ret;
+        return ret;
+    }
+
+    // ...otherwise make space and try again, or give up buffering.
+    this->flush();
+
+    va_start(vargs, fmt);
+    if ( ret >= 0 && (size_t)ret < this->size )
+    {
+        ret = vsnprintf(this->buffer, this->size, fmt, vargs);
+        if ( ret > 0 )
+            this->used = ret;
+    }
+    else
+        ret = vfprintf(this->stream, fmt, vargs);
+    va_end(vargs);
+
+    if ( ret < 0 )
+        throw filewrite(errno);
+    return ret;
+}
+
+/*
+ * Local variables:
+ * mode: C++
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -24,30 +24,93 @@
  */
 
 #include "util/log.hpp"
+#include "util/misc.hpp"
 #include "util/xensym-common.hpp"
 
 #include <cstring>
 
-void insert_xensym(const xensym_t * xensyms, const char * name, vaddr_t & value)
+XensymIndex::XensymIndex():
+    lists(), slots(), nr_entries(0)
+{}
+
+void XensymIndex::add(const xensym_t * xensyms)
 {
-    const xensym_t * sym;
+    const Slot empty = { 0, NULL, NULL };
+    size_t nr = 0, size = 16;
 
-    for ( sym = &xensyms[0]; sym->name; ++sym )
+    this->lists.push_back(xensyms);
+
+    for ( std::vector<const xensym_t *>::const_iterator it = this->lists.begin();
+          it != this->lists.end(); ++it )
+        for ( const xensym_t * sym = &(*it)[0]; sym->name; ++sym )
+            ++nr;
+
+    while ( size < 4 * nr )
+        size <<= 1;
+
+    // Rebuild from scratch in list order, so entries for the same name sit
+    // along their probe sequence in the order their lists were added.
+    this->slots.assign(size, empty);
+    this->nr_entries = 0;
+
+    for ( std::vector<const xensym_t *>::const_iterator it = this->lists.begin();
+          it != this->lists.end(); ++it )
+        for ( const xensym_t * sym = &(*it)[0]; sym->name; ++sym )
+            this->place(*it, sym);
+}
+
+bool XensymIndex::insert(const char * name, vaddr_t & value) const
+{
+    bool found = false;
+
+    if ( this->slots.empty() )
+        return false;
+
+    const uint64_t h = fnv1a_str(name);
+    const size_t mask = this->slots.size() - 1;
+
+    // Entries for the same name sit along the probe sequence in the order
+    // their lists were added, so keep going until an empty slot.
+    for ( size_t x = h & mask; this->slots[x].sym; x = (x + 1) & mask )
     {
-        if ( std::strcmp(name, sym->name) != 0 )
+        const xensym_t * sym = this->slots[x].sym;
+
+        if ( this->slots[x].hash != h || std::strcmp(name, sym->name) != 0 )
             continue;
 
+        found = true;
+
         if ( ! ((*sym->group) & sym->mask) )
         {
             LOG_INFO("Discarding duplicate symbol %s\n", name);
-            break;
+            continue;
         }
 
         (*sym->value) = value;
         (*sym->group) &= ~sym->mask;
+    }
 
-        break;
+    return found;
+}
+
+void XensymIndex::place(const xensym_t * list, const xensym_t * sym)
+{
+    const uint64_t h = fnv1a_str(sym->name);
+    const size_t mask = this->slots.size() - 1;
+    size_t x = h & mask;
+
+    for ( ; this->slots[x].sym; x = (x + 1) & mask )
+    {
+        // Only the first of a name repeated within one list is used.
+        if ( this->slots[x].list == list && this->slots[x].hash == h &&
+             ! std::strcmp(this->slots[x].sym->name, sym->name) )
+            return;
     }
+
+    this->slots[x].hash = h;
+    this->slots[x].list = list;
+    this->slots[x].sym = sym;
+    ++this->nr_entries;
 }
 
 bool _required_xensyms(const xensym_t * xensyms, const uint64_t * group)